@@ -33,6 +33,9 @@
 #include "system_comms.h"
 #include "nanohubhal.h"
 
+// the heap walk after a memory query is only logged; firmware may not answer it at all
+#define NANOHUB_HEAP_WALK_TIMEOUT   std::chrono::seconds(1)
+
 namespace android {
 
 namespace nanohub {
@@ -79,6 +82,31 @@ static void readNanohubMemInfo(MessageBuf &buf,  NanohubMemInfo &mi)
     }
 }
 
+static void readNanohubHeapInfo(MessageBuf &buf, NanohubHeapInfo &hi)
+{
+    size_t pos = buf.getPos();
+    hi.heapSz = buf.readU32();
+    hi.freeSz = buf.readU32();
+    hi.largestFree = buf.readU32();
+    hi.freeChunks = buf.readU32();
+    if ((buf.getPos() - pos) != sizeof(hi)) {
+        ALOGE("%s: failed to read object", __func__);
+    }
+}
+
+static void readNanohubAppHeapInfo(MessageBuf &buf, NanohubAppHeapInfo &ai)
+{
+    size_t pos = buf.getPos();
+    readAppName(buf, ai.name);
+    ai.curUse = buf.readU32();
+    ai.peakUse = buf.readU32();
+    ai.allocCnt = buf.readU32();
+    ai.failCnt = buf.readU32();
+    if ((buf.getPos() - pos) != sizeof(ai)) {
+        ALOGE("%s: failed to read object", __func__);
+    }
+}
+
 NanohubRsp::NanohubRsp(MessageBuf &buf, bool no_status)
 {
     // all responses start with command
@@ -191,7 +219,8 @@ int SystemComm::MemInfoSession::setup(const hub_message_t *)
     MessageBuf buf(data, sizeof(data));
     buf.writeU8(NANOHUB_QUERY_MEMINFO);
 
-    setState(SESSION_USER);
+    mRanges.clear();
+    setState(MEMINFO);
     return sendToSystem(buf.getData(), buf.getPos());
 }
 
@@ -200,29 +229,37 @@ int SystemComm::MemInfoSession::handleRx(MessageBuf &buf)
     std::lock_guard<std::mutex> _l(mLock);
     NanohubRsp rsp(buf, true);
 
-    if (rsp.cmd != NANOHUB_QUERY_MEMINFO)
+    switch (rsp.cmd) {
+    case NANOHUB_QUERY_MEMINFO:
+        return handleMemInfo(buf);
+    case NANOHUB_QUERY_HEAP:
+        return handleHeap(buf);
+    default:
         return 1;
+    }
+}
 
+int SystemComm::MemInfoSession::handleMemInfo(MessageBuf &buf)
+{
     size_t len = buf.getRoom();
 
     if (len != sizeof(NanohubMemInfo)) {
         ALOGE("%s: Invalid data size: %zu", __func__, len);
         return -EINVAL;
     }
-    if (getState() != SESSION_USER) {
-        ALOGE("%s: Invalid state; have %d, need %d", __func__, getState(), SESSION_USER);
+    if (getState() != MEMINFO) {
+        ALOGE("%s: Invalid state; have %d, need %d", __func__, getState(), MEMINFO);
         return -EINVAL;
     }
 
     NanohubMemInfo mi;
     readNanohubMemInfo(buf, mi);
-    std::vector<mem_range_t> ranges;
-    ranges.reserve(4);
+    mRanges.reserve(4);
 
     //if each is valid, copy to output area
     if (mi.sharedSz != NANOHUB_MEM_SZ_UNKNOWN &&
         mi.sharedUse != NANOHUB_MEM_SZ_UNKNOWN)
-        ranges.push_back({
+        mRanges.push_back({
             .type = HUB_MEM_TYPE_MAIN,
             .total_bytes = mi.sharedSz,
             .free_bytes = mi.sharedSz - mi.sharedUse,
@@ -230,7 +267,7 @@ int SystemComm::MemInfoSession::handleRx(MessageBuf &buf)
 
     if (mi.osSz != NANOHUB_MEM_SZ_UNKNOWN &&
         mi.osUse != NANOHUB_MEM_SZ_UNKNOWN)
-        ranges.push_back({
+        mRanges.push_back({
             .type = HUB_MEM_TYPE_OS,
             .total_bytes = mi.osSz,
             .free_bytes = mi.osSz - mi.osUse,
@@ -238,7 +275,7 @@ int SystemComm::MemInfoSession::handleRx(MessageBuf &buf)
 
     if (mi.eeSz != NANOHUB_MEM_SZ_UNKNOWN &&
         mi.eeUse != NANOHUB_MEM_SZ_UNKNOWN)
-        ranges.push_back({
+        mRanges.push_back({
             .type = HUB_MEM_TYPE_EEDATA,
             .total_bytes = mi.eeSz,
             .free_bytes = mi.eeSz - mi.eeUse,
@@ -246,7 +283,7 @@ int SystemComm::MemInfoSession::handleRx(MessageBuf &buf)
 
     if (mi.ramSz != NANOHUB_MEM_SZ_UNKNOWN &&
         mi.ramUse != NANOHUB_MEM_SZ_UNKNOWN)
-        ranges.push_back({
+        mRanges.push_back({
             .type = HUB_MEM_TYPE_RAM,
             .total_bytes = mi.ramSz,
             .free_bytes = mi.ramSz - mi.ramUse,
@@ -254,14 +291,70 @@ int SystemComm::MemInfoSession::handleRx(MessageBuf &buf)
 
     //send it out
     sendToApp(CONTEXT_HUB_QUERY_MEMORY,
-              static_cast<const void *>(ranges.data()),
-              ranges.size() * sizeof(ranges[0]));
+              static_cast<const void *>(mRanges.data()),
+              mRanges.size() * sizeof(mRanges[0]));
+
+    //then log per-app heap usage, for as long as the firmware keeps answering
+    mHeapIdx = 0;
+    mHeapDeadline = std::chrono::steady_clock::now() + NANOHUB_HEAP_WALK_TIMEOUT;
+    setState(HEAP);
+    if (requestHeap() < 0)
+        complete();
+
+    return 0;
+}
+
+int SystemComm::MemInfoSession::handleHeap(MessageBuf &buf)
+{
+    size_t len = buf.getRoom();
+
+    if (len != sizeof(NanohubHeapInfo) && len != sizeof(NanohubHeapInfo) + sizeof(NanohubAppHeapInfo)) {
+        ALOGE("%s: Invalid data size: %zu", __func__, len);
+        return -EINVAL;
+    }
+    if (getState() != HEAP) {
+        ALOGE("%s: Invalid state; have %d, need %d", __func__, getState(), HEAP);
+        return -EINVAL;
+    }
+
+    NanohubHeapInfo hi;
+    readNanohubHeapInfo(buf, hi);
+
+    if (len > sizeof(NanohubHeapInfo)) {
+        NanohubAppHeapInfo ai;
+        readNanohubAppHeapInfo(buf, ai);
+        ALOGI("Nanohub heap: app %016" PRIX64 " uses %" PRIu32 " bytes, peak %" PRIu32
+              ", %" PRIu32 " allocs, %" PRIu32 " failed",
+              ai.name.id, ai.curUse, ai.peakUse, ai.allocCnt, ai.failCnt);
+        mHeapIdx++;
+        return requestHeap();
+    }
+
+    // fragmentation: share of free memory that is not in the largest free chunk
+    ALOGI("Nanohub heap: %" PRIu32 " bytes, %" PRIu32 " free in %" PRIu32
+          " chunks, largest %" PRIu32 " (%" PRIu32 "%% fragmented)",
+          hi.heapSz, hi.freeSz, hi.freeChunks, hi.largestFree,
+          hi.freeSz ? 100 - (uint32_t)((uint64_t)hi.largestFree * 100 / hi.freeSz) : 0);
 
     complete();
 
     return 0;
 }
 
+bool SystemComm::MemInfoSession::expired() const
+{
+    return getState() == HEAP && std::chrono::steady_clock::now() >= mHeapDeadline;
+}
+
+int SystemComm::MemInfoSession::requestHeap()
+{
+    char data[MAX_RX_PACKET];
+    MessageBuf buf(data, sizeof(data));
+    buf.writeU8(NANOHUB_QUERY_HEAP);
+    buf.writeU32(mHeapIdx);
+    return sendToSystem(buf.getData(), buf.getPos());
+}
+
 int SystemComm::AppMgmtSession::setup(const hub_message_t *appMsg)
 {
     std::lock_guard<std::mutex> _l(mLock);
@@ -623,9 +716,11 @@ int SystemComm::SessionManager::setup_and_add(int id, Session *session, const hu
 {
     std::lock_guard<std::mutex> _l(lock);
 
-    // scan sessions to release those that are already done
+    // scan sessions to release those that are already done, or have waited too long
     for (auto pos = sessions_.begin(); pos != sessions_.end(); next(pos)) {
-        continue;
+        if (isActive(pos) && pos->second->expired()) {
+            pos->second->abort(-ETIMEDOUT);
+        }
     }
 
     if (sessions_.count(id) == 0 && !session->isRunning()) {
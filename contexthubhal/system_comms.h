@@ -19,6 +19,7 @@
 
 #include <utils/Condition.h>
 
+#include <chrono>
 #include <condition_variable>
 #include <map>
 #include <mutex>
@@ -45,6 +46,12 @@
 #define NANOHUB_CONT_UPLOAD        7 // (u32 offset, u8 data[]) -> (char success)
 #define NANOHUB_FINISH_UPLOAD      8 // () -> (char success)
 #define NANOHUB_REBOOT             9 // () -> (char success)
+#define NANOHUB_QUERY_HEAP        10 // (u32 idx) -> (heap_info, app_heap_info[idx] OR NONE IF NO MORE)
+#define NANOHUB_QUERY_EVT_DROPS   11 // () -> (u32 total, {u32 evtType, u32 count}[])
+#define NANOHUB_QUERY_TASK_PROF   12 // (u32 idx, u8 flags) -> (u64 window, task_prof[idx] OR NONE IF NO MORE)
+#define NANOHUB_TRACE             13 // (u8 enable) -> (u8 enabled)
+#define NANOHUB_QUERY_WAKEUP_STATS 14 // () -> (u32 apWakeups, u32 apWakeupsLastHour, u32 batchWindows, u32 batchFlushes)
+#define NANOHUB_QUERY_TIMER_STATS 15 // () -> (u32 wakes, u32 fired, u32 coalesced, u32 wakesPerSec)
 
 #define NANOHUB_APP_NOT_LOADED  (-1)
 #define NANOHUB_APP_LOADED      (0)
@@ -86,6 +93,15 @@ struct NanohubMemInfo {
     uint32_t ramUse;
 } __attribute__((packed));
 
+struct NanohubHeapInfo {
+    uint32_t heapSz, freeSz, largestFree, freeChunks;
+} __attribute__((packed));
+
+struct NanohubAppHeapInfo {
+    hub_app_name_t name;
+    uint32_t curUse, peakUse, allocCnt, failCnt;
+} __attribute__((packed));
+
 struct NanohubRsp {
     uint32_t cmd;
     int32_t status;
@@ -188,6 +204,10 @@ private:
             std::lock_guard<std::mutex> _l(mDoneMutex);
             return mState > SESSION_DONE;
         }
+        // true if the session waits for something it may give up on
+        virtual bool expired() const {
+            return false;
+        }
     };
 
     class AppMgmtSession : public Session {
@@ -226,9 +246,24 @@ private:
     };
 
     class MemInfoSession : public Session {
+        enum {
+            MEMINFO = SESSION_USER,
+            HEAP,
+        };
+        std::vector<mem_range_t> mRanges;
+        uint32_t mHeapIdx;
+        std::chrono::steady_clock::time_point mHeapDeadline;
+
+        int handleMemInfo(MessageBuf &buf);
+        int handleHeap(MessageBuf &buf);
+        int requestHeap();
     public:
+        MemInfoSession() {
+            mHeapIdx = 0;
+        }
         virtual int setup(const hub_message_t *app_msg) override;
         virtual int handleRx(MessageBuf &buf) override;
+        virtual bool expired() const override;
     };
 
     class KeyInfoSession  : public Session {
@@ -42,6 +42,7 @@ LOCAL_SRC_FILES := \
     os/core/slab.c \
     os/core/spi.c \
     os/core/timer.c \
+    os/core/trace.c \
     os/core/trylock.c \
     os/algos/ap_hub_sync.c \
 
@@ -17,12 +17,15 @@
 #include <platform.h>
 #include <eventQ.h>
 #include <stddef.h>
+#include <string.h>
 #include <timer.h>
+#include <trace.h>
 #include <stdio.h>
 #include <heap.h>
 #include <slab.h>
 #include <cpu.h>
 #include <util.h>
+#include <atomic.h>
 #include <plat/plat.h>
 #include <plat/taggedPtr.h>
 
@@ -40,12 +43,65 @@ struct EvtRecord {
     uint32_t evtType;
     void* evtData;
     TaggedPtr evtFreeData;
+    uint32_t seq;        /* enqueue order, for EVT_QUEUE_FL_EVICT_OLDEST */
+    uint32_t enqTime;    /* for EVT_QUEUE_FL_TIMESTAMP */
+};
+
+/*
+ * Lockless lane: bounded ring of slab record indices (Vyukov-style sequenced cells).
+ * Each cell is a single 32-bit word: low 16 bits hold the record index, high 16 bits
+ * hold the sequence tag that tells producers and the consumer whose turn it is.
+ * Producers claim a cell by CAS on tail; the only consumer is the dequeue side.
+ */
+#define EVT_RING_IDX_NONE           0xFFFF
+#define EVT_RING_IDX_MASK           0xFFFF
+#define EVT_RING_SEQ_SHIFT          16
+#define EVT_RING_MAX_SZ             32768 /* sequence tags must stay unambiguous mod 2^16 */
+#define EVT_URGENT_LANE_SZ          32
+
+struct EvtRing {
+    volatile uint32_t *cells;
+    volatile uint32_t tail;
+    uint32_t head;
+    uint32_t mask;
+};
+
+/* lane 0 is the urgent lane ("atFront" events); lane 1 + prio holds events of priority class prio */
+#define EVT_LANE_URGENT             0
+#define EVT_QUEUE_NUM_LANES         (EVT_PRIO_NUM + 1)
+
+struct EvtLane {
+    struct EvtList head; /* locking queues */
+    struct EvtRing ring; /* lockless queues */
+    uint8_t quota;       /* events served in a row while lower lanes wait; 0 means no limit */
+    uint8_t credit;
+};
+
+#define EVT_QUEUE_MAX_TYPE_QUOTAS   8
+#define EVT_QUEUE_DROP_STATS_SZ     16
+#define EVT_QUEUE_TYPE_MASK         0x7FFF /* event number, without origin or discardable bit */
+
+struct EvtTypeQuota {
+    uint32_t evtType;
+    uint32_t max;
+    volatile uint32_t count;
 };
 
 struct EvtQueue {
-    struct EvtList head;
     struct SlabAllocator *evtsSlab;
     EvtQueueForciblyDiscardEvtCbkF forceDiscardCbk;
+    uint32_t flags;
+    volatile uint32_t seq;
+    uint32_t numTypeQuotas;
+    struct EvtTypeQuota typeQuotas[EVT_QUEUE_MAX_TYPE_QUOTAS];
+    uint32_t dropsTotal;
+    struct EvtQueueDropStat drops[EVT_QUEUE_DROP_STATS_SZ];
+    struct EvtLane lanes[EVT_QUEUE_NUM_LANES];
+};
+
+// where eviction looks for a victim, in order; urgent lane goes last
+static const uint8_t mEvictOrder[EVT_QUEUE_NUM_LANES] = {
+    1 + EVT_PRIO_BACKGROUND, 1 + EVT_PRIO_SENSOR, 1 + EVT_PRIO_TIMER, 1 + EVT_PRIO_HOST_IO, EVT_LANE_URGENT,
 };
 
 static inline void __evtListDel(struct EvtList *prev, struct EvtList *next)
@@ -60,17 +116,253 @@ static inline void evtListDel(struct EvtList *entry)
     entry->next = entry->prev = NULL;
 }
 
+static uint32_t evtRingSize(uint32_t minSz)
+{
+    uint32_t sz = 1;
+
+    while (sz < minSz)
+        sz <<= 1;
+
+    return sz;
+}
+
+static void evtRingInit(struct EvtRing *r, volatile uint32_t *cells, uint32_t sz)
+{
+    uint32_t i;
+
+    for (i = 0; i < sz; i++)
+        cells[i] = i << EVT_RING_SEQ_SHIFT;
+
+    r->cells = cells;
+    r->mask = sz - 1;
+    r->head = 0;
+    r->tail = 0;
+}
+
+static inline uint32_t evtRingCellSeq(uint32_t cell)
+{
+    return cell >> EVT_RING_SEQ_SHIFT;
+}
+
+static bool evtRingPush(struct EvtRing *r, uint32_t recIdx)
+{
+    while (true) {
+        uint32_t pos = atomicRead32bits(&r->tail);
+        volatile uint32_t *cell = &r->cells[pos & r->mask];
+        int16_t diff = (int16_t)(evtRingCellSeq(atomicRead32bits(cell)) - (uint16_t)pos);
+
+        if (diff < 0) // lapped: ring is full
+            return false;
+
+        if (!diff && atomicCmpXchg32bits(&r->tail, pos, pos + 1)) {
+            mem_reorder_barrier(); // record contents must be visible before the cell is
+            atomicWrite32bits(cell, ((pos + 1) << EVT_RING_SEQ_SHIFT) | recIdx);
+            return true;
+        }
+        // someone else claimed this position; try the next one
+    }
+}
+
+// consumer only; returns false if next cell is not yet published
+static bool evtRingPop(struct EvtRing *r, uint32_t *recIdxP)
+{
+    uint32_t pos = r->head;
+    volatile uint32_t *cell = &r->cells[pos & r->mask];
+    uint32_t val;
+
+    // cell may be concurrently emptied by evtRingDiscardMatching(), hence the CAS
+    do {
+        val = atomicRead32bits(cell);
+        if ((uint16_t)evtRingCellSeq(val) != (uint16_t)(pos + 1))
+            return false;
+    } while (!atomicCmpXchg32bits(cell, val, (pos + r->mask + 1) << EVT_RING_SEQ_SHIFT));
+
+    *recIdxP = val & EVT_RING_IDX_MASK;
+    r->head = pos + 1;
+
+    return true;
+}
+
+static inline bool evtRingIsEmpty(struct EvtRing *r)
+{
+    return r->head == atomicRead32bits(&r->tail);
+}
+
+static struct EvtTypeQuota *evtQueueFindTypeQuota(struct EvtQueue *q, uint32_t evtType)
+{
+    uint32_t i;
+
+    for (i = 0; i < q->numTypeQuotas; i++)
+        if (q->typeQuotas[i].evtType == (evtType & EVT_QUEUE_TYPE_MASK))
+            return &q->typeQuotas[i];
+
+    return NULL;
+}
+
+// reserve room for one more event of this type; false if it already has its share queued.
+// only discardable events count: the rest (e.g. flush markers) must get through regardless
+static bool evtQueueTypeQuotaTake(struct EvtQueue *q, uint32_t evtType)
+{
+    struct EvtTypeQuota *quota;
+    uint32_t old;
+
+    if (!q->numTypeQuotas || !(evtType & EVENT_TYPE_BIT_DISCARDABLE) || !(quota = evtQueueFindTypeQuota(q, evtType)))
+        return true;
+
+    do {
+        old = quota->count;
+        if (old >= quota->max)
+            return false;
+    } while (!atomicCmpXchg32bits(&quota->count, old, old + 1));
+
+    return true;
+}
+
+static void evtQueueTypeQuotaPut(struct EvtQueue *q, uint32_t evtType)
+{
+    struct EvtTypeQuota *quota;
+
+    if (q->numTypeQuotas && (evtType & EVENT_TYPE_BIT_DISCARDABLE) && (quota = evtQueueFindTypeQuota(q, evtType)))
+        atomicAdd32bits(&quota->count, (uint32_t)-1);
+}
+
+static void evtQueueCountDrop(struct EvtQueue *q, uint32_t evtType)
+{
+    struct EvtQueueDropStat *stat, *freeStat = NULL;
+    uint64_t intSta = cpuIntsOff();
+    uint32_t i;
+
+    q->dropsTotal++;
+    for (i = 0; i < EVT_QUEUE_DROP_STATS_SZ; i++) {
+        stat = &q->drops[i];
+        if (stat->count && stat->evtType == evtType)
+            break;
+        if (!stat->count && !freeStat)
+            freeStat = stat;
+    }
+    if (i == EVT_QUEUE_DROP_STATS_SZ && (stat = freeStat) != NULL)
+        stat->evtType = evtType;
+    if (stat && stat->evtType == evtType)
+        stat->count++;
+
+    cpuIntsRestore(intSta);
+}
+
+// published records that match are discarded and their cells emptied; whoever wins the cell CAS owns the record
+static void evtRingDiscardMatching(struct EvtQueue *q, struct EvtRing *r,
+                                   bool (*match)(uint32_t evtType, const void *data, void *context),
+                                   void *context)
+{
+    uint32_t pos, tail = atomicRead32bits(&r->tail);
+
+    for (pos = r->head; pos != tail; pos++) {
+        volatile uint32_t *cell = &r->cells[pos & r->mask];
+        uint32_t val = atomicRead32bits(cell);
+        struct EvtRecord *rec;
+
+        if ((uint16_t)evtRingCellSeq(val) != (uint16_t)(pos + 1) || (val & EVT_RING_IDX_MASK) == EVT_RING_IDX_NONE)
+            continue;
+
+        rec = slabAllocatorGetNth(q->evtsSlab, val & EVT_RING_IDX_MASK);
+        if (!rec || !match(rec->evtType, rec->evtData, context))
+            continue;
+
+        if (!atomicCmpXchg32bits(cell, val, (val & ~EVT_RING_IDX_MASK) | EVT_RING_IDX_NONE))
+            continue;
+
+        evtQueueTypeQuotaPut(q, rec->evtType);
+        q->forceDiscardCbk(rec->evtType, rec->evtData, rec->evtFreeData);
+        slabAllocatorFree(q->evtsSlab, rec);
+    }
+}
+
+// oldest published discardable record of a ring; consumer may race us for it
+static struct EvtRecord *evtRingFindDiscardable(struct EvtQueue *q, struct EvtRing *r, volatile uint32_t **cellP, uint32_t *valP)
+{
+    uint32_t pos, tail = atomicRead32bits(&r->tail);
+
+    for (pos = r->head; pos != tail; pos++) {
+        volatile uint32_t *cell = &r->cells[pos & r->mask];
+        uint32_t val = atomicRead32bits(cell);
+        struct EvtRecord *rec;
+
+        if ((uint16_t)evtRingCellSeq(val) != (uint16_t)(pos + 1) || (val & EVT_RING_IDX_MASK) == EVT_RING_IDX_NONE)
+            continue;
+
+        rec = slabAllocatorGetNth(q->evtsSlab, val & EVT_RING_IDX_MASK);
+        if (rec && (rec->evtType & EVENT_TYPE_BIT_DISCARDABLE)) {
+            *cellP = cell;
+            *valP = val;
+            return rec;
+        }
+    }
+
+    return NULL;
+}
+
+static bool evtMatchAll(uint32_t evtType, const void *data, void *context)
+{
+    return true;
+}
+
+static inline bool evtQueueIsLockless(const struct EvtQueue *q)
+{
+    return (q->flags & EVT_QUEUE_FL_LOCKLESS) != 0;
+}
+
 struct EvtQueue* evtQueueAlloc(uint32_t size, EvtQueueForciblyDiscardEvtCbkF forceDiscardCbk)
 {
-    struct EvtQueue *q = heapAlloc(sizeof(struct EvtQueue));
-    struct SlabAllocator *slab = slabAllocatorNew(sizeof(struct EvtRecord),
-                                                  alignof(struct EvtRecord), size);
+    return evtQueueAllocEx(size, forceDiscardCbk, 0, NULL);
+}
+
+struct EvtQueue* evtQueueAllocEx(uint32_t size, EvtQueueForciblyDiscardEvtCbkF forceDiscardCbk, uint32_t flags,
+                                 const uint16_t *prioSizes)
+{
+    bool lockless = (flags & EVT_QUEUE_FL_LOCKLESS) != 0;
+    uint32_t laneSz[EVT_QUEUE_NUM_LANES];
+    uint32_t cellsSz = 0;
+    struct EvtQueue *q;
+    struct SlabAllocator *slab;
+    uint32_t i;
+
+    if (lockless && size >= EVT_RING_IDX_NONE)
+        return NULL;
+
+    // a class lane that may hold the whole slab only runs out of cells after discards
+    for (i = 0; lockless && i < EVT_QUEUE_NUM_LANES; i++) {
+        if (i == EVT_LANE_URGENT)
+            laneSz[i] = EVT_URGENT_LANE_SZ;
+        else
+            laneSz[i] = evtRingSize(prioSizes && prioSizes[i - 1] && prioSizes[i - 1] < size ? prioSizes[i - 1] : size);
+        if (laneSz[i] > EVT_RING_MAX_SZ)
+            return NULL;
+        cellsSz += laneSz[i];
+    }
+
+    q = heapAlloc(sizeof(struct EvtQueue) + sizeof(uint32_t[cellsSz]));
+    slab = slabAllocatorNew(sizeof(struct EvtRecord), alignof(struct EvtRecord), size);
 
     if (q && slab) {
+        volatile uint32_t *cells = (volatile uint32_t *)(q + 1);
+
         q->forceDiscardCbk = forceDiscardCbk;
         q->evtsSlab = slab;
-        q->head.next = &q->head;
-        q->head.prev = &q->head;
+        q->flags = flags;
+        q->seq = 0;
+        q->numTypeQuotas = 0;
+        q->dropsTotal = 0;
+        memset(q->drops, 0, sizeof(q->drops));
+        for (i = 0; i < EVT_QUEUE_NUM_LANES; i++) {
+            struct EvtLane *lane = &q->lanes[i];
+
+            lane->head.next = &lane->head;
+            lane->head.prev = &lane->head;
+            lane->quota = lane->credit = 0;
+            if (lockless) {
+                evtRingInit(&lane->ring, cells, laneSz[i]);
+                cells += laneSz[i];
+            }
+        }
         return q;
     }
 
@@ -82,117 +374,377 @@ struct EvtQueue* evtQueueAlloc(uint32_t size, EvtQueueForciblyDiscardEvtCbkF for
     return NULL;
 }
 
-void evtQueueFree(struct EvtQueue* q)
+void evtQueueSetPrioQuota(struct EvtQueue* q, uint32_t prio, uint32_t quota)
 {
-    struct EvtList *pos, *tmp;
+    struct EvtLane *lane;
 
-    for_each_item_safe (&q->head, pos, tmp) {
-        struct EvtRecord * rec = container_of(pos, struct EvtRecord, item);
+    if (!q || prio >= EVT_PRIO_NUM)
+        return;
 
-        q->forceDiscardCbk(rec->evtType, rec->evtData, rec->evtFreeData);
-        slabAllocatorFree(q->evtsSlab, rec);
+    lane = &q->lanes[1 + prio];
+    lane->quota = lane->credit = quota > UINT8_MAX ? UINT8_MAX : quota;
+}
+
+bool evtQueueSetTypeQuota(struct EvtQueue* q, uint32_t evtType, uint32_t maxQueued)
+{
+    struct EvtTypeQuota *quota;
+
+    if (!q)
+        return false;
+
+    if (!(quota = evtQueueFindTypeQuota(q, evtType))) {
+        if (q->numTypeQuotas == EVT_QUEUE_MAX_TYPE_QUOTAS)
+            return false;
+        quota = &q->typeQuotas[q->numTypeQuotas];
+        quota->evtType = evtType & EVT_QUEUE_TYPE_MASK;
+        quota->count = 0;
+        quota->max = maxQueued;
+        q->numTypeQuotas++;
+    } else {
+        quota->max = maxQueued;
+    }
+
+    return true;
+}
+
+uint32_t evtQueueGetDropStats(struct EvtQueue* q, struct EvtQueueDropStat *stats, uint32_t maxStats, uint32_t *totalP)
+{
+    uint64_t intSta = cpuIntsOff();
+    uint32_t i, n = 0;
+
+    for (i = 0; i < EVT_QUEUE_DROP_STATS_SZ && n < maxStats; i++)
+        if (q->drops[i].count)
+            stats[n++] = q->drops[i];
+    if (totalP)
+        *totalP = q->dropsTotal;
+    cpuIntsRestore(intSta);
+
+    return n;
+}
+
+static bool evtLaneIsEmpty(struct EvtQueue *q, struct EvtLane *lane)
+{
+    return evtQueueIsLockless(q) ? evtRingIsEmpty(&lane->ring) : lane->head.next == &lane->head;
+}
+
+static struct EvtRecord *evtLanePop(struct EvtQueue *q, struct EvtLane *lane)
+{
+    if (evtQueueIsLockless(q)) {
+        uint32_t recIdx;
+
+        while (evtRingPop(&lane->ring, &recIdx)) {
+            if (recIdx != EVT_RING_IDX_NONE)
+                return slabAllocatorGetNth(q->evtsSlab, recIdx);
+        }
+    } else if (lane->head.next != &lane->head) {
+        struct EvtList *pos = lane->head.next;
+
+        evtListDel(pos);
+        return container_of(pos, struct EvtRecord, item);
+    }
+
+    return NULL;
+}
+
+static bool evtQueueHasPendingBelow(struct EvtQueue *q, uint32_t laneIdx)
+{
+    uint32_t i;
+
+    for (i = laneIdx + 1; i < EVT_QUEUE_NUM_LANES; i++)
+        if (!evtLaneIsEmpty(q, &q->lanes[i]))
+            return true;
+
+    return false;
+}
+
+// only events actually served count against the lane's quota; discarded cells do not
+static struct EvtRecord *evtLaneTake(struct EvtQueue *q, struct EvtLane *lane)
+{
+    struct EvtRecord *rec = evtLanePop(q, lane);
+
+    if (!rec)
+        lane->credit = lane->quota;
+    else if (lane->quota)
+        lane->credit--;
+
+    return rec;
+}
+
+// strict priority by lane, except that a lane that used up its quota while lower lanes
+// were waiting lets the next non-empty lower lane have one turn. consumer only.
+static struct EvtRecord *evtQueuePick(struct EvtQueue *q)
+{
+    struct EvtLane *yielded = NULL;
+    struct EvtRecord *rec;
+    uint32_t i;
+
+    for (i = 0; i < EVT_QUEUE_NUM_LANES; i++) {
+        struct EvtLane *lane = &q->lanes[i];
+
+        if (evtLaneIsEmpty(q, lane)) {
+            lane->credit = lane->quota;
+            continue;
+        }
+        if (lane->quota && !lane->credit) {
+            lane->credit = lane->quota;
+            if (evtQueueHasPendingBelow(q, i)) {
+                if (!yielded)
+                    yielded = lane;
+                continue;
+            }
+        }
+        if ((rec = evtLaneTake(q, lane)) != NULL)
+            return rec;
+    }
+
+    // lanes below only held discarded cells; the turn goes back to the one that gave it up
+    return yielded ? evtLaneTake(q, yielded) : NULL;
+}
+
+static void evtQueueDiscardMatching(struct EvtQueue *q,
+                                    bool (*match)(uint32_t evtType, const void *data, void *context),
+                                    void *context, struct EvtRecord **reuseP)
+{
+    uint32_t i;
+
+    for (i = 0; i < EVT_QUEUE_NUM_LANES; i++) {
+        struct EvtLane *lane = &q->lanes[i];
+        struct EvtList *pos, *tmp;
+
+        if (evtQueueIsLockless(q)) {
+            evtRingDiscardMatching(q, &lane->ring, match, context);
+            continue;
+        }
+
+        for_each_item_safe (&lane->head, pos, tmp) {
+            struct EvtRecord * rec = container_of(pos, struct EvtRecord, item);
+
+            if (!match(rec->evtType, rec->evtData, context))
+                continue;
+            evtQueueTypeQuotaPut(q, rec->evtType);
+            q->forceDiscardCbk(rec->evtType, rec->evtData, rec->evtFreeData);
+            evtListDel(pos);
+            // caller may want to recycle one of the victims instead of going back to the slab
+            if (reuseP && !*reuseP)
+                *reuseP = rec;
+            else
+                slabAllocatorFree(q->evtsSlab, rec);
+        }
+    }
+}
+
+static struct EvtRecord *evtLaneFindDiscardable(struct EvtQueue *q, struct EvtLane *lane, volatile uint32_t **cellP, uint32_t *valP)
+{
+    struct EvtList *pos;
+
+    if (evtQueueIsLockless(q))
+        return evtRingFindDiscardable(q, &lane->ring, cellP, valP);
+
+    for (pos = lane->head.next; pos != &lane->head; pos = pos->next) {
+        struct EvtRecord *rec = container_of(pos, struct EvtRecord, item);
+
+        if (rec->evtType & EVENT_TYPE_BIT_DISCARDABLE)
+            return rec;
     }
 
+    return NULL;
+}
+
+// make room for one event by dropping one discardable event, chosen by the queue's eviction policy.
+// call with interrupts off. list queues may hand the victim's record back for reuse.
+static bool evtQueueEvictOne(struct EvtQueue *q, struct EvtRecord **reuseP)
+{
+    bool oldest = (q->flags & EVT_QUEUE_FL_EVICT_OLDEST) != 0;
+    struct EvtRecord *rec, *victim = NULL;
+    volatile uint32_t *cell = NULL, *victimCell = NULL;
+    uint32_t i, val = 0, victimVal = 0;
+
+    for (i = 0; i < EVT_QUEUE_NUM_LANES; i++) {
+        rec = evtLaneFindDiscardable(q, &q->lanes[mEvictOrder[i]], &cell, &val);
+        if (!rec || (victim && (int32_t)(rec->seq - victim->seq) >= 0))
+            continue;
+        victim = rec;
+        victimCell = cell;
+        victimVal = val;
+        if (!oldest)
+            break;
+    }
+
+    if (!victim)
+        return false;
+
+    if (evtQueueIsLockless(q)) {
+        if (!atomicCmpXchg32bits(victimCell, victimVal, (victimVal & ~EVT_RING_IDX_MASK) | EVT_RING_IDX_NONE))
+            return false;
+    } else {
+        evtListDel(&victim->item);
+    }
+
+    evtQueueTypeQuotaPut(q, victim->evtType);
+    evtQueueCountDrop(q, victim->evtType);
+    q->forceDiscardCbk(victim->evtType, victim->evtData, victim->evtFreeData);
+    if (reuseP && !evtQueueIsLockless(q))
+        *reuseP = victim;
+    else
+        slabAllocatorFree(q->evtsSlab, victim);
+
+    return true;
+}
+
+void evtQueueFree(struct EvtQueue* q)
+{
+    evtQueueDiscardMatching(q, evtMatchAll, NULL, NULL);
     slabAllocatorDestroy(q->evtsSlab);
     heapFree(q);
 }
 
-bool evtQueueEnqueue(struct EvtQueue* q, uint32_t evtType, void *evtData,
-                    TaggedPtr evtFreeData, bool atFront)
+bool evtQueueEnqueueEx(struct EvtQueue* q, uint32_t evtType, void *evtData,
+                       TaggedPtr evtFreeData, uint32_t prio, bool atFront)
 {
     struct EvtRecord *rec;
+    struct EvtLane *lane;
     uint64_t intSta;
-    struct EvtList *item = NULL, *a, *b;
 
     if (!q)
         return false;
 
+    if (prio >= EVT_PRIO_NUM)
+        prio = EVT_PRIO_DEFAULT;
+
+    trace(TRACE_EVT_ENQUEUE, evtType, prio | ((uint32_t)atFront << 31));
+
+    if (!evtQueueTypeQuotaTake(q, evtType)) {
+        evtQueueCountDrop(q, evtType);
+        return false;
+    }
+
     rec = slabAllocatorAlloc(q->evtsSlab);
     if (!rec) {
-        struct EvtList *pos;
-
         intSta = cpuIntsOff();
         //find a victim for discarding
-        for (pos = q->head.next; pos != &q->head; pos = pos->next) {
-            rec = container_of(pos, struct EvtRecord, item);
-            if (!(rec->evtType & EVENT_TYPE_BIT_DISCARDABLE))
-                continue;
-            q->forceDiscardCbk(rec->evtType, rec->evtData, rec->evtFreeData);
-            evtListDel(pos);
-            item = pos;
+        evtQueueEvictOne(q, &rec);
+        cpuIntsRestore(intSta);
+        if (!rec)
+            rec = slabAllocatorAlloc(q->evtsSlab);
+        if (!rec) {
+            evtQueueTypeQuotaPut(q, evtType);
+            evtQueueCountDrop(q, evtType);
+            return false;
         }
-        cpuIntsRestore (intSta);
-    } else {
-        item = &rec->item;
     }
 
-    if (!item)
-        return false;
-
-    item->prev = item->next = NULL;
-
     rec->evtType = evtType;
     rec->evtData = evtData;
     rec->evtFreeData = evtFreeData;
+    if (q->flags & EVT_QUEUE_FL_EVICT_OLDEST)
+        rec->seq = atomicAdd32bits(&q->seq, 1);
+    rec->enqTime = (q->flags & EVT_QUEUE_FL_TIMESTAMP) ? (uint32_t)(platGetTicks() >> 10) : 0;
 
-    intSta = cpuIntsOff();
+    if (evtQueueIsLockless(q)) {
+        uint32_t recIdx = slabAllocatorGetIndex(q->evtsSlab, rec);
 
-    if (unlikely(atFront)) {
-        b = q->head.next;
-        a = b->prev;
+        // urgent lane is small; if it is full, event still goes out, just not ahead of others
+        if (!(atFront && evtRingPush(&q->lanes[EVT_LANE_URGENT].ring, recIdx)) &&
+            !evtRingPush(&q->lanes[1 + prio].ring, recIdx)) {
+            slabAllocatorFree(q->evtsSlab, rec);
+            evtQueueTypeQuotaPut(q, evtType);
+            evtQueueCountDrop(q, evtType);
+            return false;
+        }
     } else {
-        a = q->head.prev;
-        b = a->next;
-    }
+        struct EvtList *item = &rec->item, *a, *b;
 
-    a->next = item;
-    item->prev = a;
-    b->prev = item;
-    item->next = b;
+        intSta = cpuIntsOff();
+
+        if (unlikely(atFront)) {
+            lane = &q->lanes[EVT_LANE_URGENT];
+            b = lane->head.next;
+            a = b->prev;
+        } else {
+            lane = &q->lanes[1 + prio];
+            a = lane->head.prev;
+            b = a->next;
+        }
+
+        a->next = item;
+        item->prev = a;
+        b->prev = item;
+        item->next = b;
+
+        cpuIntsRestore(intSta);
+    }
 
-    cpuIntsRestore(intSta);
     platWake();
     return true;
 }
 
+bool evtQueueEnqueue(struct EvtQueue* q, uint32_t evtType, void *evtData,
+                    TaggedPtr evtFreeData, bool atFront)
+{
+    return evtQueueEnqueueEx(q, evtType, evtData, evtFreeData, EVT_PRIO_DEFAULT, atFront);
+}
+
 void evtQueueRemoveAllMatching(struct EvtQueue* q,
                                bool (*match)(uint32_t evtType, const void *data, void *context),
                                void *context)
 {
     uint64_t intSta = cpuIntsOff();
-    struct EvtList *pos, *tmp;
 
-    for_each_item_safe (&q->head, pos, tmp) {
-        struct EvtRecord * rec = container_of(pos, struct EvtRecord, item);
+    evtQueueDiscardMatching(q, match, context, NULL);
+    cpuIntsRestore(intSta);
+}
 
-        if (match(rec->evtType, rec->evtData, context)) {
-            q->forceDiscardCbk(rec->evtType, rec->evtData, rec->evtFreeData);
-            evtListDel(pos);
-            slabAllocatorFree(q->evtsSlab, rec);
-        }
+static bool evtQueueIsEmpty(struct EvtQueue *q)
+{
+    uint32_t i;
+
+    for (i = 0; i < EVT_QUEUE_NUM_LANES; i++)
+        if (!evtLaneIsEmpty(q, &q->lanes[i]))
+            return false;
+
+    return true;
+}
+
+static uint32_t evtQueueTakeReady(struct EvtQueue *q, struct EvtQueueItem *items, uint32_t maxItems)
+{
+    struct EvtRecord *rec;
+    uint32_t n;
+
+    for (n = 0; n < maxItems && (rec = evtQueuePick(q)) != NULL; n++) {
+        items[n].evtType = rec->evtType;
+        items[n].evtData = rec->evtData;
+        items[n].evtFreeData = rec->evtFreeData;
+        items[n].enqTime = rec->enqTime;
+        evtQueueTypeQuotaPut(q, rec->evtType);
+        slabAllocatorFree(q->evtsSlab, rec);
     }
-    cpuIntsRestore(intSta);
+
+    return n;
 }
 
-bool evtQueueDequeue(struct EvtQueue* q, uint32_t *evtTypeP, void **evtDataP,
-                     TaggedPtr *evtFreeDataP, bool sleepIfNone)
+uint32_t evtQueueDequeueBatch(struct EvtQueue* q, struct EvtQueueItem *items, uint32_t maxItems, bool sleepIfNone)
 {
-    struct EvtRecord *rec = NULL;
+    bool lockless = evtQueueIsLockless(q);
+    uint32_t n = 0;
     uint64_t intSta;
 
     while(1) {
-        struct EvtList *pos;
+        // lockless queues are consumed without masking interrupts
+        if (lockless && (n = evtQueueTakeReady(q, items, maxItems)))
+            break;
+
         intSta = cpuIntsOff();
 
-        pos = q->head.next;
-        if (pos != &q->head) {
-            rec = container_of(pos, struct EvtRecord, item);
-            evtListDel(pos);
+        if (!lockless && (n = evtQueueTakeReady(q, items, maxItems))) {
+            cpuIntsRestore(intSta);
             break;
         }
-        else if (!sleepIfNone)
+        else if (!sleepIfNone) {
+            cpuIntsRestore(intSta);
             break;
-        else if (!timIntHandler()) {
+        }
+        // recheck with interrupts off, so that we do not miss a wakeup
+        else if (evtQueueIsEmpty(q) && !timIntHandler()) {
             // check for timers
             // if any fire, do not sleep (since by the time callbacks run, more might be due)
             platSleep();
@@ -202,15 +754,20 @@ bool evtQueueDequeue(struct EvtQueue* q, uint32_t *evtTypeP, void **evtDataP,
         cpuIntsRestore(intSta);
     }
 
-    cpuIntsRestore(intSta);
+    return n;
+}
 
-    if (!rec)
+bool evtQueueDequeue(struct EvtQueue* q, uint32_t *evtTypeP, void **evtDataP,
+                     TaggedPtr *evtFreeDataP, bool sleepIfNone)
+{
+    struct EvtQueueItem item;
+
+    if (!evtQueueDequeueBatch(q, &item, 1, sleepIfNone))
         return false;
 
-    *evtTypeP = rec->evtType;
-    *evtDataP = rec->evtData;
-    *evtFreeDataP = rec->evtFreeData;
-    slabAllocatorFree(q->evtsSlab, rec);
+    *evtTypeP = item.evtType;
+    *evtDataP = item.evtData;
+    *evtFreeDataP = item.evtFreeData;
 
     return true;
 }
@@ -18,8 +18,11 @@
 #include <atomic.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <heap.h>
 #include <seos.h>
+#include <cpu.h>
+#include <trace.h>
 
 #define TIDX_HEAP_EXTRA 2 // must be >= 0; best if > 0, don't make it > 7, since it unnecessarily limits max heap size we can manage
 
@@ -61,14 +64,347 @@ struct HeapNode {
 
 static struct HeapNode* gHeapHead;
 static TRYLOCK_DECL_STATIC(gHeapLock) = TRYLOCK_INIT_STATIC();
-static volatile uint8_t gNeedFreeMerge = false; /* cannot be bool since its size is ill defined */
 static struct HeapNode *gHeapTail;
 
+// per-task accounting; the extra slot is for whoever is not a task
+struct HeapTaskAcct {
+    struct HeapTaskStats stats;
+    uint32_t tidx; // owner the stats belong to; a task slot may get reused
+};
+
+static struct HeapTaskAcct gHeapAcct[MAX_TASKS + 1];
+
 static inline struct HeapNode* heapPrvGetNext(struct HeapNode* node)
 {
     return (gHeapTail == node) ? NULL : (struct HeapNode*)(node->data + node->size);
 }
 
+static struct HeapTaskAcct* heapPrvAcct(uint32_t tidx)
+{
+    uint32_t idx = tidx & TASK_TID_IDX_MASK;
+
+    return gHeapAcct + (idx < MAX_TASKS ? idx : MAX_TASKS);
+}
+
+// sz == 0 is a failed alloc
+static void heapPrvAcctAlloc(uint32_t tidx, uint32_t sz)
+{
+    struct HeapTaskAcct *acct = heapPrvAcct(tidx);
+    uint64_t intSta = cpuIntsOff();
+
+    if (acct->tidx != tidx) {
+        acct->stats = (struct HeapTaskStats){0};
+        acct->tidx = tidx;
+    }
+    if (sz) {
+        acct->stats.allocs++;
+        acct->stats.curBytes += sz;
+        if (acct->stats.curBytes > acct->stats.peakBytes)
+            acct->stats.peakBytes = acct->stats.curBytes;
+    } else {
+        acct->stats.failed++;
+    }
+    cpuIntsRestore(intSta);
+}
+
+static void heapPrvAcctFree(uint32_t tidx, uint32_t sz)
+{
+    struct HeapTaskAcct *acct = heapPrvAcct(tidx);
+    uint64_t intSta = cpuIntsOff();
+
+    if (acct->tidx == tidx)
+        acct->stats.curBytes -= sz;
+    cpuIntsRestore(intSta);
+}
+
+#ifdef HEAP_TLSF
+
+/*
+ * Two level segregated fit: free chunks are kept in lists by size class, the first level being
+ * the power of two of the size, the second one splitting that range linearly. Bitmaps of non-empty
+ * lists let us find a big enough chunk with two bit scans, so alloc and free take constant time.
+ * Chunks keep the same header as the first fit allocator, so ownership (tidx) works the same way.
+ */
+
+#define TLSF_SL_BITS    3
+#define TLSF_SL_COUNT   (1 << TLSF_SL_BITS)
+#define TLSF_FL_SHIFT   (TLSF_SL_BITS + 2)                      // sizes are multiples of 4
+#define TLSF_SMALL_SZ   (1 << TLSF_FL_SHIFT)                    // below this, second level is linear
+#define TLSF_FL_COUNT   (MAX_HEAP_ORDER - TLSF_FL_SHIFT + 1)
+
+// free chunks keep their list links where the data would be
+struct HeapFreeLinks {
+    struct HeapNode *next;
+    struct HeapNode *prev;
+};
+
+#define TLSF_MIN_SZ     ((sizeof(struct HeapFreeLinks) + 3) &~ 3)
+
+static uint32_t gFlBitmap;
+static uint32_t gSlBitmap[TLSF_FL_COUNT];
+static struct HeapNode *gFreeLists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+static struct HeapNode *gPendingFree; /* freed while the lock was taken; still marked used */
+
+static inline struct HeapFreeLinks* heapPrvLinks(struct HeapNode *node)
+{
+    return (struct HeapFreeLinks*)node->data;
+}
+
+static void heapPrvMapping(uint32_t sz, uint32_t *flP, uint32_t *slP)
+{
+    uint32_t fl;
+
+    if (sz < TLSF_SMALL_SZ) {
+        *flP = 0;
+        *slP = sz >> 2;
+    } else {
+        fl = 31 - __builtin_clz(sz);
+        *slP = (sz >> (fl - TLSF_SL_BITS)) ^ TLSF_SL_COUNT;
+        *flP = fl - TLSF_FL_SHIFT + 1;
+    }
+}
+
+static void heapPrvListAdd(struct HeapNode *node)
+{
+    struct HeapFreeLinks *links = heapPrvLinks(node);
+    uint32_t fl, sl;
+
+    heapPrvMapping(node->size, &fl, &sl);
+    links->prev = NULL;
+    links->next = gFreeLists[fl][sl];
+    if (links->next)
+        heapPrvLinks(links->next)->prev = node;
+    gFreeLists[fl][sl] = node;
+    gFlBitmap |= 1UL << fl;
+    gSlBitmap[fl] |= 1UL << sl;
+}
+
+static void heapPrvListDel(struct HeapNode *node)
+{
+    struct HeapFreeLinks *links = heapPrvLinks(node);
+    uint32_t fl, sl;
+
+    heapPrvMapping(node->size, &fl, &sl);
+    if (links->next)
+        heapPrvLinks(links->next)->prev = links->prev;
+    if (links->prev)
+        heapPrvLinks(links->prev)->next = links->next;
+    else if (!(gFreeLists[fl][sl] = links->next) && !(gSlBitmap[fl] &= ~(1UL << sl)))
+        gFlBitmap &= ~(1UL << fl);
+}
+
+// first chunk in a list whose every member fits sz
+static struct HeapNode* heapPrvFindFit(uint32_t sz)
+{
+    uint32_t fl, sl, map;
+
+    if (sz >= TLSF_SMALL_SZ)
+        sz += (1UL << (31 - __builtin_clz(sz) - TLSF_SL_BITS)) - 1;
+    if (sz >> MAX_HEAP_ORDER)
+        return NULL;
+
+    heapPrvMapping(sz, &fl, &sl);
+    map = gSlBitmap[fl] & (~0UL << sl);
+    if (!map) {
+        map = fl + 1 < TLSF_FL_COUNT ? gFlBitmap & (~0UL << (fl + 1)) : 0;
+        if (!map)
+            return NULL;
+        fl = __builtin_ctz(map);
+        map = gSlBitmap[fl];
+    }
+
+    return gFreeLists[fl][__builtin_ctz(map)];
+}
+
+// free a chunk, merging it with free neighbours. only call with lock held please
+static struct HeapNode* heapPrvFree(struct HeapNode *node)
+{
+    struct HeapNode *t;
+
+    node->used = 0;
+    node->tidx = 0;
+
+    if (node->prev && !node->prev->used) {
+        heapPrvListDel(node->prev);
+        node->prev->size += sizeof(struct HeapNode) + node->size;
+        if (gHeapTail == node)
+            gHeapTail = node->prev;
+        node = node->prev;
+    }
+
+    if ((t = heapPrvGetNext(node)) && !t->used) {
+        heapPrvListDel(t);
+        node->size += sizeof(struct HeapNode) + t->size;
+        if (gHeapTail == t)
+            gHeapTail = node;
+    }
+
+    if ((t = heapPrvGetNext(node)))
+        t->prev = node;
+
+    heapPrvListAdd(node);
+
+    return node;
+}
+
+//called to free chunks that free() was unable to free last time it tried. only call with lock held please
+static void heapPrvFreePending(void)
+{
+    struct HeapNode *node, *next;
+    uint64_t intSta;
+
+    if (!gPendingFree)
+        return;
+
+    intSta = cpuIntsOff();
+    node = gPendingFree;
+    gPendingFree = NULL;
+    cpuIntsRestore(intSta);
+
+    for (; node; node = next) {
+        next = heapPrvLinks(node)->next;
+        heapPrvFree(node);
+    }
+}
+
+bool heapInit(void)
+{
+    uint32_t size = REAL_HEAP_SIZE;
+    struct HeapNode* node;
+
+    node = gHeapHead = (struct HeapNode*)ALIGNED_HEAP_START;
+
+    if (size < sizeof(struct HeapNode) + TLSF_MIN_SZ)
+        return false;
+
+    // may be called again, to start over with an empty heap
+    gFlBitmap = 0;
+    memset(gSlBitmap, 0, sizeof(gSlBitmap));
+    memset(gFreeLists, 0, sizeof(gFreeLists));
+    gPendingFree = NULL;
+    gHeapTail = node;
+
+    node->used = 0;
+    node->tidx = 0;
+    node->prev = NULL;
+    node->size = size - sizeof(struct HeapNode);
+
+    heapPrvListAdd(node);
+
+    return true;
+}
+
+void* heapAlloc(uint32_t sz)
+{
+    struct HeapNode *best, *node;
+    void* ret = NULL;
+
+    if (!trylockTryTake(&gHeapLock)) {
+        heapPrvAcctAlloc(osGetCurrentTid() & TIDX_MASK, 0);
+        return NULL;
+    }
+
+    heapPrvFreePending();
+
+    sz = (sz + 3) &~ 3;
+    if (sz < TLSF_MIN_SZ)
+        sz = TLSF_MIN_SZ;
+
+    best = heapPrvFindFit(sz);
+    if (!best) //alloc failed
+        goto out;
+
+    heapPrvListDel(best);
+
+    if (best->size - sz >= sizeof(struct HeapNode) + TLSF_MIN_SZ) {        //there is a point to split up the chunk
+
+        node = (struct HeapNode*)(best->data + sz);
+
+        node->used = 0;
+        node->tidx = 0;
+        node->size = best->size - sz - sizeof(struct HeapNode);
+        node->prev = best;
+
+        if (best != gHeapTail)
+            heapPrvGetNext(node)->prev = node;
+        else
+            gHeapTail = node;
+
+        best->size = sz;
+        heapPrvListAdd(node);
+    }
+
+    best->used = 1;
+    best->tidx = osGetCurrentTid();
+    ret = best->data;
+
+out:
+    heapPrvAcctAlloc(osGetCurrentTid() & TIDX_MASK, ret ? best->size : 0);
+    trylockRelease(&gHeapLock);
+    trace(TRACE_HEAP_ALLOC, sz, ret);
+    return ret;
+}
+
+void heapFree(void* ptr)
+{
+    struct HeapNode *node;
+    uint64_t intSta;
+
+    if (ptr == NULL) {
+        // NULL is a valid reply from heapAlloc, and thus it is not an error for
+        // us to receive it here.  We just ignore it.
+        return;
+    }
+    trace(TRACE_HEAP_FREE, ptr, 0);
+
+    node = ((struct HeapNode*)ptr) - 1;
+    heapPrvAcctFree(node->tidx, node->size);
+
+    if (trylockTryTake(&gHeapLock)) {
+        heapPrvFree(node);
+        trylockRelease(&gHeapLock);
+    } else {
+        // stays "used" until the lock holder frees it; drop the owner so heapFreeAll() skips it
+        node->tidx = 0;
+        intSta = cpuIntsOff();
+        heapPrvLinks(node)->next = gPendingFree;
+        gPendingFree = node;
+        cpuIntsRestore(intSta);
+    }
+}
+
+int heapFreeAll(uint32_t tid)
+{
+    struct HeapNode *node;
+    int count = 0;
+
+    if (!tid)
+        return -1;
+
+    // this can only fail if called from interrupt
+    if (!trylockTryTake(&gHeapLock))
+        return -1;
+
+    heapPrvFreePending();
+
+    tid &= TIDX_MASK;
+    for (node = gHeapHead; node; node = heapPrvGetNext(node)) {
+        if (node->used && node->tidx == tid) {
+            node = heapPrvFree(node);
+            count++;
+        }
+    }
+    heapPrvAcctFree(tid, heapPrvAcct(tid)->stats.curBytes);
+    trylockRelease(&gHeapLock);
+    trace(TRACE_HEAP_FREE_ALL, tid, count);
+
+    return count;
+}
+
+#else
+
+static volatile uint8_t gNeedFreeMerge = false; /* cannot be bool since its size is ill defined */
+
 bool heapInit(void)
 {
     uint32_t size = REAL_HEAP_SIZE;
@@ -100,11 +436,10 @@ static void heapMergeFreeChunks(void)
             if (!node->used && next && !next->used) { /* merged */
                 node->size += sizeof(struct HeapNode) + next->size;
 
-                next = heapPrvGetNext(node);
-                if (next)
-                    next->prev = node;
-                else
+                if (gHeapTail == next)
                     gHeapTail = node;
+                else
+                    heapPrvGetNext(node)->prev = node;
             }
             else
                 node = next;
@@ -117,8 +452,10 @@ void* heapAlloc(uint32_t sz)
     struct HeapNode *node, *best = NULL;
     void* ret = NULL;
 
-    if (!trylockTryTake(&gHeapLock))
+    if (!trylockTryTake(&gHeapLock)) {
+        heapPrvAcctAlloc(osGetCurrentTid() & TIDX_MASK, 0);
         return NULL;
+    }
 
     /* merge free chunks to help better use space */
     heapMergeFreeChunks();
@@ -161,7 +498,9 @@ void* heapAlloc(uint32_t sz)
     ret = best->data;
 
 out:
+    heapPrvAcctAlloc(osGetCurrentTid() & TIDX_MASK, ret ? best->size : 0);
     trylockRelease(&gHeapLock);
+    trace(TRACE_HEAP_ALLOC, sz, ret);
     return ret;
 }
 
@@ -175,10 +514,12 @@ void heapFree(void* ptr)
         // us to receive it here.  We just ignore it.
         return;
     }
+    trace(TRACE_HEAP_FREE, ptr, 0);
 
     haveLock = trylockTryTake(&gHeapLock);
 
     node = ((struct HeapNode*)ptr) - 1;
+    heapPrvAcctFree(node->tidx, node->size);
     node->used = 0;
     node->tidx = 0;
 
@@ -224,8 +565,48 @@ int heapFreeAll(uint32_t tid)
             count++;
         }
     }
+    heapPrvAcctFree(tid, heapPrvAcct(tid)->stats.curBytes);
     gNeedFreeMerge = count > 0;
     trylockRelease(&gHeapLock);
+    trace(TRACE_HEAP_FREE_ALL, tid, count);
 
     return count;
 }
+
+#endif
+
+bool heapGetStats(struct HeapStats *stats)
+{
+    struct HeapNode *node;
+
+    if (!trylockTryTake(&gHeapLock))
+        return false;
+
+    *stats = (struct HeapStats){0};
+    for (node = gHeapHead; node; node = heapPrvGetNext(node)) {
+        stats->totalBytes += node->size;
+        if (node->used) {
+            stats->usedChunks++;
+        } else {
+            stats->freeChunks++;
+            stats->freeBytes += node->size;
+            if (node->size > stats->largestFree)
+                stats->largestFree = node->size;
+        }
+    }
+    trylockRelease(&gHeapLock);
+
+    return true;
+}
+
+bool heapGetTaskStats(uint32_t tid, struct HeapTaskStats *stats)
+{
+    struct HeapTaskAcct *acct = heapPrvAcct(tid & TIDX_MASK);
+    uint64_t intSta = cpuIntsOff();
+    bool ok = acct->tidx == (tid & TIDX_MASK);
+
+    *stats = ok ? acct->stats : (struct HeapTaskStats){0};
+    cpuIntsRestore(intSta);
+
+    return ok;
+}
@@ -44,6 +44,7 @@
 #include <timer.h>
 #include <heap.h>
 #include <simpleQ.h>
+#include <trace.h>
 
 #define HOSTINTF_MAX_ERR_MSG    8
 #define MAX_NUM_BLOCKS          280         /* times 256 = 71680 bytes */
@@ -52,6 +53,20 @@
 #define SENSOR_INIT_ERROR_MAX   4
 #define CHECK_LATENCY_TIME      500000000   /* ns */
 #define EVT_LATENCY_TIMER       EVT_NO_FIRST_USER_EVENT
+#define EVT_BATCH_TIMER         (EVT_NO_FIRST_USER_EVENT + 1)
+#define BATCH_FLUSH_TIMEOUT     20000000    /* ns */
+#define WAKEUP_STATS_HOUR       3600000000000ull /* ns */
+
+#ifndef HOSTINTF_QUEUE_SHARES
+/* percent of MAX_NUM_BLOCKS each output queue is sure to get when over budget, indexed by
+ * HOSTINTF_QUEUE_*; override may come from variant.h */
+#define HOSTINTF_QUEUE_SHARES   { 50, 50 }
+#endif
+
+#ifndef HOSTINTF_QUEUE_WEIGHTS
+/* blocks taken from each output queue per turn while others are waiting, indexed likewise; nonzero */
+#define HOSTINTF_QUEUE_WEIGHTS  { 3, 1 }
+#endif
 
 static const uint32_t delta_time_multiplier_order = 9;
 static const uint32_t delta_time_coarse_mask = ~1;
@@ -69,6 +84,23 @@ enum ConfigCmds
     CONFIG_CMD_SELF_TEST    = 5,
 };
 
+enum ConfigFlags
+{
+    CONFIG_FLAG_COMPRESS    = 0x0001,   /* enable: host decodes compressed three-axis samples */
+};
+
+/*
+ * Output queues. Wakeup sensors and the host messages that must not be lost have their own,
+ * so a flood of nonwakeup samples, logs or traces can never push them out; each queue only
+ * discards its own blocks. hostIntfPacketDequeue() drains them weighted round robin.
+ */
+enum HostIntfQueue
+{
+    HOSTINTF_QUEUE_WAKEUP   = 0,
+    HOSTINTF_QUEUE_NONWAKEUP,
+    HOSTINTF_QUEUE_NUM,
+};
+
 struct ConfigCmd
 {
     uint64_t latency;
@@ -86,6 +118,7 @@ struct ActiveSensor
     struct HostIntfDataBuffer buffer;
     uint32_t rate;
     uint32_t sensorHandle;
+    uint32_t dropped; // samples that did not fit in the output queue; see hostIntfGetDroppedSamples()
     float rawScale;
     uint16_t minSamples;
     uint16_t curSamples;
@@ -99,14 +132,23 @@ struct ActiveSensor
     // different rawType). Note that this is different than biasType in struct
     // SensorInfo.
     uint8_t biasReportType;
+    uint8_t batchFlushes; // flushes of ours not yet answered; see batchOpenWindow()
+    uint8_t batchGen;     // window the last of them counts for; 0 if none does
     uint8_t oneshot : 1;
     uint8_t discard : 1;
+    uint8_t batchDeaf : 1; // left a flush of ours unanswered; windows skip it until re-enabled
     uint8_t raw : 1;
-    uint8_t reserved : 5;
+    uint8_t compress : 1;
+    uint8_t reserved : 4;
 } __attribute__((packed));
 
 static uint8_t mSensorList[SENS_TYPE_LAST_USER];
-static struct SimpleQueue *mOutputQ;
+static struct SimpleQueue *mOutputQ[HOSTINTF_QUEUE_NUM];
+static uint32_t mOutputQBlocks[HOSTINTF_QUEUE_NUM];
+static uint32_t mOutputQUsed[HOSTINTF_QUEUE_NUM]; // blocks in each queue; mWakeupBlocks and co. count by interrupt
+static const uint8_t mOutputQWeights[HOSTINTF_QUEUE_NUM] = HOSTINTF_QUEUE_WEIGHTS;
+static uint8_t mOutputQCur, mOutputQCredit;
+static struct HostIntfDataBuffer mCompressBuf;
 static struct ActiveSensor *mActiveSensorTable;
 static uint8_t mNumSensors;
 static uint8_t mLastSensor;
@@ -126,9 +168,16 @@ static struct
 {
     uint8_t pad; // packet header is 10 bytes. + 2 to word align
     uint8_t prePreamble;
+#if HOSTINTF_READ_EVENTS_MAX
+    uint8_t buf[HOSTINTF_READ_EVENTS_MAX]; // also holds READ_EVENTS replies
+#else
     uint8_t buf[NANOHUB_PACKET_SIZE_MAX];
+#endif
     uint8_t postPreamble;
 } mTxBuf;
+C_STATIC_ASSERT(hostintf_read_events_max, !HOSTINTF_READ_EVENTS_MAX ||
+                                          (HOSTINTF_READ_EVENTS_MAX >= NANOHUB_PACKET_SIZE_MAX + NANOHUB_PACKET_SIZE_MIN &&
+                                           HOSTINTF_READ_EVENTS_MAX <= NANOHUB_READ_EVENTS_MAX));
 static struct
 {
     uint8_t pad; // packet header is 10 bytes. + 2 to word align
@@ -142,10 +191,17 @@ static const struct NanohubCommand *mRxCmd;
 ATOMIC_BITSET_DECL(mInterrupt, HOSTINTF_MAX_INTERRUPTS, static);
 ATOMIC_BITSET_DECL(mInterruptMask, HOSTINTF_MAX_INTERRUPTS, static);
 static uint32_t mInterruptCntWkup, mInterruptCntNonWkup;
-static uint32_t mWakeupBlocks, mNonWakeupBlocks, mTotalBlocks;
+static uint32_t mWakeupBlocks, mNonWakeupBlocks;
 static uint32_t mHostIntfTid;
 static uint32_t mLatencyTimer;
 static uint8_t mLatencyCnt;
+static uint32_t mBatchInterrupts; // to raise when the open batch window closes; 0 while none is open
+static uint32_t mBatchTimer;
+static uint8_t mBatchFlushCnt;
+static uint8_t mBatchGen; // current or last window; never 0
+static struct HostIntfWakeupStats mWakeupStats;
+static uint32_t mWakeupsThisHour;
+static uint64_t mWakeupHourEnd;
 
 static uint8_t mRxIdle;
 static uint8_t mWakeActive;
@@ -408,22 +464,11 @@ static void hostIntfTxSendAck(uint32_t resp)
     if (resp == NANOHUB_FAST_UNHANDLED_ACK) {
         hostIntfCopyInterrupts(txPayload, HOSTINTF_MAX_INTERRUPTS);
         hostIntfTxPacket(NANOHUB_REASON_ACK, 32, mTxRetrans.seq, hostIntfTxAckDone);
-    } else if (resp == NANOHUB_FAST_DONT_ACK) {
-        // do nothing. something else will do the ack
     } else {
         hostIntfTxPacket(mRxCmd->reason, resp, mTxRetrans.seq, hostIntfTxPayloadDone);
     }
 }
 
-void hostIntfTxAck(void *buffer, uint8_t len)
-{
-    void *txPayload = hostIntfGetPayload(mTxBuf.buf);
-
-    memcpy(txPayload, buffer, len);
-
-    hostIntfTxSendAck(len);
-}
-
 static void hostIntfGenerateAck(void *cookie)
 {
     uint32_t seq = 0;
@@ -501,13 +546,40 @@ static void hostIntfTxAckDone(size_t tx, int err)
     }
 }
 
+static void hostIntfGenerateBulkResponse(void)
+{
+    void *rxPayload = hostIntfGetPayload(mRxBuf);
+    uint8_t rx_len = hostIntfGetPayloadLen(mRxBuf);
+    uint32_t size = mRxCmd->handler(rxPayload, rx_len, mTxBuf.buf, mRxTimestamp);
+    struct NanohubPacket *txPacket;
+    uint32_t i;
+
+    // the handler set each packet's len and payload
+    for (i = 0; i < size; i += NANOHUB_PACKET_SIZE(txPacket->len)) {
+        txPacket = (struct NanohubPacket *)(mTxBuf.buf + i);
+        txPacket->reason = mRxCmd->reason;
+        txPacket->seq = mTxRetrans.seq;
+        txPacket->sync = NANOHUB_SYNC_BYTE;
+        hostIntfGetFooter(mTxBuf.buf + i)->crc = hostIntfComputeCrc(mTxBuf.buf + i);
+    }
+
+    // send starting with the prePremable byte
+    hostIntfTxBuf(1+size, &mTxBuf.prePreamble, hostIntfTxPayloadDone);
+}
+
 static void hostIntfGenerateResponse(void *cookie)
 {
     void *rxPayload = hostIntfGetPayload(mRxBuf);
     uint8_t rx_len = hostIntfGetPayloadLen(mRxBuf);
     void *txPayload = hostIntfGetPayload(mTxBuf.buf);
-    uint8_t respLen = mRxCmd->handler(rxPayload, rx_len, txPayload, mRxTimestamp);
+    uint8_t respLen;
+
+    if (mRxCmd->bulk) {
+        hostIntfGenerateBulkResponse();
+        return;
+    }
 
+    respLen = mRxCmd->handler(rxPayload, rx_len, txPayload, mRxTimestamp);
     hostIntfTxPacket(mRxCmd->reason, respLen, mTxRetrans.seq, hostIntfTxPayloadDone);
 }
 
@@ -554,6 +626,153 @@ static inline struct ActiveSensor *getActiveSensorByType(uint32_t sensorType)
     return sensor;
 }
 
+/*
+ * Compressed three-axis blocks, for sensors the host enabled with CONFIG_FLAG_COMPRESS.
+ * The host sees them as EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT + sensType. referenceTime and
+ * firstSample are where they always are; the samples are replaced by:
+ *   le32 period        deltaTime of every sample after the first, or 0 if they are not all equal
+ *   int8 scaleExp[3]   one per axis: each x, y or z value is q * 2^scaleExp, q a signed 17-bit
+ *                      integer; an axis that stays small keeps its resolution
+ *   per sample         varint deltaTime (only if period is 0, and not for the first sample),
+ *                      then zig-zag varints of q - previous q for x, y and z (previous q starts at 0)
+ * Varints are little-endian groups of 7 bits, top bit set on all but the last byte.
+ * Blocks that would not get smaller are sent as they are.
+ */
+#define COMPRESS_VALUE_BITS     16      /* |q| <= 2^16 for the largest value of an axis in the block */
+#define COMPRESS_EXP_MAX        64      /* larger values, infinities and NaNs: not compressed */
+#define COMPRESS_EXP_MIN        -64     /* all values smaller than this are sent as 0 */
+
+//e such that 2^(e-1) <= |val| < 2^e for normal numbers; 129 for infinities and NaNs
+static int32_t floatExponent(float val)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &val, sizeof(bits));
+    return (int32_t)((bits >> 23) & 0xFF) - 126;
+}
+
+//2^exp for -126 <= exp <= 127
+static float floatPow2(int32_t exp)
+{
+    uint32_t bits = (uint32_t)(exp + 127) << 23;
+    float val;
+
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+static uint8_t *putVarint(uint8_t *p, uint32_t val)
+{
+    while (val >= 0x80) {
+        *p++ = val | 0x80;
+        val >>= 7;
+    }
+    *p++ = val;
+
+    return p;
+}
+
+static inline int32_t floatToInt32(float val)
+{
+    return val >= 0.0f ? (int32_t)(val + 0.5f) : (int32_t)(val - 0.5f);
+}
+
+static inline uint32_t zigZag(int32_t val)
+{
+    return ((uint32_t)val << 1) ^ (uint32_t)(val >> 31);
+}
+
+//encode sensor->buffer into dst; false if it does not qualify or would not get smaller
+static bool compressSensorBuffer(const struct ActiveSensor *sensor, struct HostIntfDataBuffer *dst)
+{
+    const struct HostIntfDataBuffer *src = &sensor->buffer;
+    const struct TripleAxisDataPoint *samples = src->triple;
+    uint32_t i, j, numSamples = src->firstSample.numSamples, period;
+    int32_t exp, maxExp[3] = { COMPRESS_EXP_MIN, COMPRESS_EXP_MIN, COMPRESS_EXP_MIN }, q, prev[3] = { 0, 0, 0 };
+    float v[3], mult[3];
+    uint8_t *p;
+
+    if (!sensor->compress || sensor->raw || sensor->numAxis != NUM_AXIS_THREE ||
+        numSamples < 2 || src->firstSample.biasPresent)
+        return false;
+
+    period = samples[1].deltaTime;
+    for (i = 0; i < numSamples; i++) {
+        if (i > 0 && samples[i].deltaTime != period)
+            period = 0;
+        v[0] = samples[i].x;
+        v[1] = samples[i].y;
+        v[2] = samples[i].z;
+        for (j = 0; j < 3; j++) {
+            exp = floatExponent(v[j]);
+            if (exp > maxExp[j])
+                maxExp[j] = exp;
+        }
+    }
+    for (j = 0; j < 3; j++) {
+        if (maxExp[j] > COMPRESS_EXP_MAX)
+            return false;
+    }
+
+    dst->evtType = src->evtType;
+    dst->dataType = HOSTINTF_DATA_TYPE_COMPRESSED_SENSOR;
+    dst->referenceTime = src->referenceTime;
+    dst->firstSample = src->firstSample;
+    p = dst->buffer + sizeof(dst->referenceTime) + sizeof(dst->firstSample);
+    memcpy(p, &period, sizeof(period));
+    p += sizeof(period);
+    for (j = 0; j < 3; j++) {
+        *p++ = (int8_t)(maxExp[j] - COMPRESS_VALUE_BITS);
+        mult[j] = floatPow2(COMPRESS_VALUE_BITS - maxExp[j]);
+    }
+
+    for (i = 0; i < numSamples; i++) {
+        if (i > 0 && !period)
+            p = putVarint(p, samples[i].deltaTime);
+        v[0] = samples[i].x;
+        v[1] = samples[i].y;
+        v[2] = samples[i].z;
+        for (j = 0; j < 3; j++) {
+            q = floatToInt32(v[j] * mult[j]);
+            p = putVarint(p, zigZag(q - prev[j]));
+            prev[j] = q;
+        }
+        //a sample takes at most 5 + 3 * 3 bytes, so this stops well short of the end of dst
+        if (p - dst->buffer >= src->length)
+            return false;
+    }
+    dst->length = p - dst->buffer;
+
+    return true;
+}
+
+static inline uint32_t getOutputQueue(uint32_t interrupt, bool discardable, bool sensor)
+{
+    // logs, traces and the like may be dropped; they must not take the place of wakeup data
+    if (interrupt == NANOHUB_INT_WAKEUP && (sensor || !discardable))
+        return HOSTINTF_QUEUE_WAKEUP;
+    else
+        return HOSTINTF_QUEUE_NONWAKEUP;
+}
+
+// weighted round robin: a queue keeps its turn for up to its weight in blocks, or until it runs dry
+static bool outputQueueDequeue(struct HostIntfDataBuffer *buffer)
+{
+    uint32_t i;
+
+    for (i = 0; i <= HOSTINTF_QUEUE_NUM; i++) {
+        if (mOutputQCredit && simpleQueueDequeue(mOutputQ[mOutputQCur], buffer)) {
+            mOutputQUsed[mOutputQCur]--;
+            mOutputQCredit--;
+            return true;
+        }
+        mOutputQCur = (mOutputQCur + 1) % HOSTINTF_QUEUE_NUM;
+        mOutputQCredit = mOutputQWeights[mOutputQCur];
+    }
+
+    return false;
+}
+
 bool hostIntfPacketDequeue(void *data, uint32_t *wakeup, uint32_t *nonwakeup)
 {
     struct HostIntfDataBuffer *buffer = data;
@@ -561,7 +780,7 @@ bool hostIntfPacketDequeue(void *data, uint32_t *wakeup, uint32_t *nonwakeup)
     struct ActiveSensor *sensor;
     uint32_t i;
 
-    ret = simpleQueueDequeue(mOutputQ, buffer);
+    ret = outputQueueDequeue(buffer);
     while (ret) {
         sensor = getActiveSensorByType(buffer->sensType);
         if (sensor) {
@@ -572,7 +791,7 @@ bool hostIntfPacketDequeue(void *data, uint32_t *wakeup, uint32_t *nonwakeup)
                 else if (sensor->interrupt == NANOHUB_INT_NONWAKEUP)
                     mNonWakeupBlocks--;
                 sensor->curSamples -= buffer->firstSample.numSamples;
-                ret = simpleQueueDequeue(mOutputQ, buffer);
+                ret = outputQueueDequeue(buffer);
             } else {
                 break;
             }
@@ -592,7 +811,8 @@ bool hostIntfPacketDequeue(void *data, uint32_t *wakeup, uint32_t *nonwakeup)
             }
 
             if (sensor->buffer.length > 0) {
-                memcpy(buffer, &sensor->buffer, sizeof(struct HostIntfDataBuffer));
+                if (!compressSensorBuffer(sensor, buffer))
+                    memcpy(buffer, &sensor->buffer, sizeof(struct HostIntfDataBuffer));
                 resetBuffer(sensor);
                 ret = true;
                 mLastSensor = (mLastSensor + 1) % mNumSensors;
@@ -629,7 +849,7 @@ static void initCompleteCallback(uint32_t timerId, void *data)
     osEnqueuePrivateEvt(EVT_APP_START, NULL, NULL, mHostIntfTid);
 }
 
-static bool queueDiscard(void *data, bool onDelete)
+static bool queueDiscard(uint32_t queue, void *data, bool onDelete)
 {
     struct HostIntfDataBuffer *buffer = data;
     struct ActiveSensor *sensor = getActiveSensorByType(buffer->sensType);
@@ -641,33 +861,92 @@ static bool queueDiscard(void *data, bool onDelete)
             else if (sensor->interrupt == NANOHUB_INT_NONWAKEUP)
                 mNonWakeupBlocks--;
             sensor->curSamples -= buffer->firstSample.numSamples;
+            if (!onDelete)
+                sensor->dropped += buffer->firstSample.numSamples;
+            mOutputQUsed[queue]--;
 
             return true;
         } else {
             return false;
         }
     } else {
+        if (buffer->sensType == SENS_TYPE_INVALID && buffer->dataType == HOSTINTF_DATA_TYPE_TRACE)
+            traceDropped((const struct TraceRecord *)buffer->buffer, buffer->length / sizeof(struct TraceRecord));
         if (buffer->interrupt == NANOHUB_INT_WAKEUP)
             mWakeupBlocks--;
         else if (buffer->interrupt == NANOHUB_INT_NONWAKEUP)
             mNonWakeupBlocks--;
+        mOutputQUsed[queue]--;
         return true;
     }
 }
 
+static bool queueDiscardWakeup(void *data, bool onDelete)
+{
+    return queueDiscard(HOSTINTF_QUEUE_WAKEUP, data, onDelete);
+}
+
+static bool queueDiscardNonWakeup(void *data, bool onDelete)
+{
+    return queueDiscard(HOSTINTF_QUEUE_NONWAKEUP, data, onDelete);
+}
+
 static void latencyTimerCallback(uint32_t timerId, void* data)
 {
     osEnqueuePrivateEvt(EVT_LATENCY_TIMER, data, NULL, mHostIntfTid);
 }
 
+//data is the window generation, so a timer cancelled too late cannot close the next window
+static void batchTimerCallback(uint32_t timerId, void* data)
+{
+    osEnqueuePrivateEvt(EVT_BATCH_TIMER, data, NULL, mHostIntfTid);
+}
+
+// every queue gets what it asks for, at least MIN_NUM_BLOCKS; over MAX_NUM_BLOCKS in all, each
+// is first cut to its share and what the others leave over goes to the ones still short, in order
+static void sizeOutputQueues(uint32_t *blocks)
+{
+    static const uint8_t shares[HOSTINTF_QUEUE_NUM] = HOSTINTF_QUEUE_SHARES;
+    uint32_t need[HOSTINTF_QUEUE_NUM];
+    uint32_t i, cap, extra, total = 0, spare = MAX_NUM_BLOCKS;
+
+    for (i = 0; i < HOSTINTF_QUEUE_NUM; i++) {
+        if (blocks[i] < MIN_NUM_BLOCKS)
+            blocks[i] = MIN_NUM_BLOCKS;
+        total += blocks[i];
+    }
+
+    if (total <= MAX_NUM_BLOCKS)
+        return;
+
+    for (i = 0; i < HOSTINTF_QUEUE_NUM; i++) {
+        need[i] = blocks[i];
+        cap = MAX_NUM_BLOCKS * shares[i] / 100;
+        if (cap < MIN_NUM_BLOCKS)
+            cap = MIN_NUM_BLOCKS;
+        if (blocks[i] > cap)
+            blocks[i] = cap;
+        spare = spare > blocks[i] ? spare - blocks[i] : 0;
+    }
+
+    for (i = 0; i < HOSTINTF_QUEUE_NUM; i++) {
+        extra = need[i] - blocks[i];
+        if (extra > spare)
+            extra = spare;
+        blocks[i] += extra;
+        spare -= extra;
+    }
+}
+
 static bool initSensors()
 {
-    uint32_t i, j, blocks, maxBlocks, numAxis, packetSamples;
+    uint32_t i, j, blocks, maxBlocks, numAxis, packetSamples, queue;
     bool present, error;
     const struct SensorInfo *si;
     uint32_t handle;
     static uint8_t errorCnt = 0;
     uint32_t totalBlocks = 0;
+    uint32_t queueBlocks[HOSTINTF_QUEUE_NUM] = { 0 };
     uint8_t numSensors = 0;
     ATOMIC_BITSET_DECL(sensorPresent, SENS_TYPE_LAST_USER - SENS_TYPE_INVALID,);
 
@@ -689,6 +968,7 @@ static bool initSensors()
                 if (!present) {
                     present = 1;
                     numAxis = si->numAxis;
+                    queue = getOutputQueue(si->interrupt, true, true);
                     switch (si->numAxis) {
                     case NUM_AXIS_EMBEDDED:
                     case NUM_AXIS_ONE:
@@ -727,17 +1007,22 @@ static bool initSensors()
             atomicBitsetSetBit(sensorPresent, i - 1);
             numSensors++;
             totalBlocks += maxBlocks;
+            queueBlocks[queue] += maxBlocks;
         }
     }
 
-    if (totalBlocks > MAX_NUM_BLOCKS) {
+    if (totalBlocks > MAX_NUM_BLOCKS)
         osLog(LOG_INFO, "initSensors: totalBlocks of %ld exceeds maximum of %d\n", totalBlocks, MAX_NUM_BLOCKS);
-        totalBlocks = MAX_NUM_BLOCKS;
-    } else if (totalBlocks < MIN_NUM_BLOCKS) {
-        totalBlocks = MIN_NUM_BLOCKS;
-    }
 
-    mOutputQ = simpleQueueAlloc(totalBlocks, sizeof(struct HostIntfDataBuffer), queueDiscard);
+    sizeOutputQueues(queueBlocks);
+    mOutputQ[HOSTINTF_QUEUE_WAKEUP] = simpleQueueAlloc(queueBlocks[HOSTINTF_QUEUE_WAKEUP],
+                                                       sizeof(struct HostIntfDataBuffer), queueDiscardWakeup);
+    mOutputQ[HOSTINTF_QUEUE_NONWAKEUP] = simpleQueueAlloc(queueBlocks[HOSTINTF_QUEUE_NONWAKEUP],
+                                                          sizeof(struct HostIntfDataBuffer), queueDiscardNonWakeup);
+    for (i = 0; i < HOSTINTF_QUEUE_NUM; i++)
+        mOutputQBlocks[i] = queueBlocks[i];
+    mOutputQCur = HOSTINTF_QUEUE_WAKEUP;
+    mOutputQCredit = mOutputQWeights[HOSTINTF_QUEUE_WAKEUP];
     mActiveSensorTable = heapAlloc(numSensors * sizeof(struct ActiveSensor));
     memset(mActiveSensorTable, 0x00, numSensors * sizeof(struct ActiveSensor));
 
@@ -793,7 +1078,6 @@ static bool initSensors()
         }
     }
 
-    mTotalBlocks = totalBlocks;
     mNumSensors = numSensors;
 
     return true;
@@ -825,16 +1109,24 @@ static uint32_t encodeDeltaTime(uint64_t time)
 
 static bool enqueueSensorBuffer(struct ActiveSensor *sensor)
 {
-    bool queued = simpleQueueEnqueue(mOutputQ, &sensor->buffer,
-                                     sizeof(uint32_t) + sensor->buffer.length, sensor->discard);
+    const struct HostIntfDataBuffer *buffer = &sensor->buffer;
+    uint32_t queue = getOutputQueue(sensor->interrupt, sensor->discard, true);
+    bool queued;
+
+    if (compressSensorBuffer(sensor, &mCompressBuf))
+        buffer = &mCompressBuf;
+    queued = simpleQueueEnqueue(mOutputQ[queue], buffer, sizeof(uint32_t) + buffer->length, sensor->discard);
 
-    if (!queued) {
+    if (queued) {
+        mOutputQUsed[queue]++;
+    } else {
         // undo counters if failed to add buffer
         if (sensor->interrupt == NANOHUB_INT_WAKEUP)
             mWakeupBlocks--;
         else if (sensor->interrupt == NANOHUB_INT_NONWAKEUP)
             mNonWakeupBlocks--;
         sensor->curSamples -= sensor->buffer.firstSample.numSamples;
+        sensor->dropped += sensor->buffer.firstSample.numSamples;
     }
     resetBuffer(sensor);
     return queued;
@@ -1085,8 +1377,11 @@ static void copyTripleSamplesRaw(struct ActiveSensor *sensor, const struct Tripl
 
 static void hostIntfAddBlock(struct HostIntfDataBuffer *data, bool discardable, bool interrupt)
 {
-    if (!simpleQueueEnqueue(mOutputQ, data, sizeof(uint32_t) + data->length, discardable))
+    uint32_t queue = getOutputQueue(data->interrupt, discardable, data->sensType != SENS_TYPE_INVALID);
+
+    if (!simpleQueueEnqueue(mOutputQ[queue], data, sizeof(uint32_t) + data->length, discardable))
         return;
+    mOutputQUsed[queue]++;
 
     if (data->interrupt == NANOHUB_INT_WAKEUP)
         mWakeupBlocks++;
@@ -1140,7 +1435,9 @@ static void fakeFlush(struct ConfigCmd *cmd)
     buffer->interrupt = NANOHUB_INT_WAKEUP;
     mWakeupBlocks++;
     buffer->firstSample.numFlushes = 1;
-    if (!simpleQueueEnqueue(mOutputQ, buffer, size, false))
+    if (simpleQueueEnqueue(mOutputQ[HOSTINTF_QUEUE_WAKEUP], buffer, size, false))
+        mOutputQUsed[HOSTINTF_QUEUE_WAKEUP]++;
+    else
         mWakeupBlocks--;
 }
 
@@ -1157,6 +1454,9 @@ static void onEvtAppStart(const void *evtData)
 #ifdef DEBUG_LOG_EVT
         osEventSubscribe(mHostIntfTid, EVT_DEBUG_LOG);
         platEarlyLogFlush();
+#endif
+#if OS_TRACE
+        osEventSubscribe(mHostIntfTid, EVT_TRACE);
 #endif
         reason = pwrResetReason();
         data = alloca(sizeof(uint32_t) + sizeof(reason));
@@ -1204,6 +1504,140 @@ static void onEvtDebugLog(const void *evtData)
 }
 #endif
 
+#if OS_TRACE
+static void onEvtTrace(const void *evtData)
+{
+    struct HostIntfDataBuffer *data = (struct HostIntfDataBuffer *)evtData;
+
+    if (data->sensType == SENS_TYPE_INVALID && data->dataType == HOSTINTF_DATA_TYPE_TRACE)
+        hostIntfAddBlock(data, true, true);
+}
+#endif
+
+/*
+ * Batch windows. Each batched sensor has its own deadline, and left alone each would wake
+ * the AP by itself, one shortly after the other. Instead, the first deadline to come due
+ * flushes every batched sensor, so what sits in their fifos reaches our buffers too, and the
+ * interrupt only goes up once they have all answered (or BATCH_FLUSH_TIMEOUT passed). The AP
+ * drains everything in one go, and the deadlines all start over together.
+ * A flush goes to every subscriber of the sensor, so only sensors no other task has requested
+ * get one: anyone else's batching would be cut short too. And only one of ours may be
+ * outstanding per sensor; see onEvtBatchTimer() for the ones that never come back.
+ */
+static void batchCloseWindow(void)
+{
+    uint64_t sensorTime = sensorGetTime();
+    uint32_t interrupts = mBatchInterrupts;
+    struct ActiveSensor *sensor;
+    uint32_t i;
+
+    if (mBatchTimer) {
+        timTimerCancel(mBatchTimer);
+        mBatchTimer = 0;
+    }
+    mBatchInterrupts = 0;
+    mBatchFlushCnt = 0;
+
+    // whoever came due while we waited goes along
+    for (i = 0; i < mNumSensors; i++) {
+        sensor = mActiveSensorTable + i;
+        if (sensor->latency && sensor->firstTime && sensorTime >= sensor->firstTime + sensor->latency)
+            interrupts |= 1ul << sensor->interrupt;
+    }
+
+    for (i = 0; interrupts; i++, interrupts >>= 1) {
+        if (interrupts & 1)
+            nanohubPrefetchTx(i, mWakeupBlocks, mNonWakeupBlocks);
+    }
+}
+
+static void batchOpenWindow(uint32_t interrupt)
+{
+    struct ActiveSensor *sensor;
+    uint32_t i;
+
+    if (mBatchInterrupts) {
+        mBatchInterrupts |= 1ul << interrupt;
+        return;
+    }
+
+    mBatchInterrupts = 1ul << interrupt;
+    if (!++mBatchGen)
+        mBatchGen = 1;
+    mWakeupStats.batchWindows++;
+
+    for (i = 0; i < mNumSensors; i++) {
+        sensor = mActiveSensorTable + i;
+        if (sensor->sensorHandle && sensor->latency && !sensor->batchFlushes && !sensor->batchDeaf &&
+            sensorIsSoleClient(mHostIntfTid, sensor->sensorHandle) && sensorFlush(sensor->sensorHandle)) {
+            sensor->batchFlushes++;
+            sensor->batchGen = mBatchGen;
+            mBatchFlushCnt++;
+            mWakeupStats.batchFlushes++;
+        }
+    }
+
+    if (mBatchFlushCnt)
+        mBatchTimer = timTimerSet(BATCH_FLUSH_TIMEOUT, 100, 100, batchTimerCallback, (void *)(uintptr_t)mBatchGen, true);
+    if (!mBatchTimer)
+        batchCloseWindow();
+}
+
+/*
+ * A flush marker we asked for; the host did not, so it never sees it. Markers of one sensor
+ * come in order, so the first one to arrive is ours. It counts for the open window unless
+ * that closed without it (no timer, or the sensor went away), and is swallowed either way.
+ */
+static bool batchFlushDone(struct ActiveSensor *sensor)
+{
+    if (!sensor->batchFlushes)
+        return false;
+
+    if (--sensor->batchFlushes == 0 && sensor->batchGen == mBatchGen && mBatchFlushCnt) {
+        sensor->batchGen = 0;
+        if (--mBatchFlushCnt == 0)
+            batchCloseWindow();
+    }
+
+    return true;
+}
+
+//the sensor goes away; the open window stops waiting for it, its markers are still ours
+static void batchForgetSensor(struct ActiveSensor *sensor)
+{
+    if (sensor->batchFlushes && sensor->batchGen == mBatchGen && mBatchFlushCnt) {
+        sensor->batchGen = 0;
+        if (--mBatchFlushCnt == 0)
+            batchCloseWindow();
+    }
+}
+
+/*
+ * The window timed out. A driver that says yes to a flush but drops the marker would leave
+ * batchFlushes up for good, and the host's next marker would be swallowed in its place: so
+ * what is still outstanding now is written off, and that sensor gets no more of our flushes.
+ * Should its marker turn up after all, the host gets one flush more than it asked for.
+ */
+static void onEvtBatchTimer(const void *evtData)
+{
+    struct ActiveSensor *sensor;
+    uint32_t i;
+
+    //a late one, from a window that closed already, has nothing to do
+    if (mBatchTimer && (uint8_t)(uintptr_t)evtData == mBatchGen) {
+        mBatchTimer = 0;
+        for (i = 0; i < mNumSensors; i++) {
+            sensor = mActiveSensorTable + i;
+            if (sensor->batchFlushes) {
+                sensor->batchFlushes = 0;
+                sensor->batchGen = 0;
+                sensor->batchDeaf = true;
+            }
+        }
+        batchCloseWindow();
+    }
+}
+
 static void onEvtLatencyTimer(const void *evtData)
 {
     uint64_t sensorTime = sensorGetTime();
@@ -1213,8 +1647,9 @@ static void onEvtLatencyTimer(const void *evtData)
         if (mActiveSensorTable[i].latency > 0) {
             cnt++;
             if (mActiveSensorTable[i].firstTime &&
-                sensorTime >= mActiveSensorTable[i].firstTime + mActiveSensorTable[i].latency) {
-                hostIntfSetInterrupt(mActiveSensorTable[i].interrupt);
+                sensorTime >= mActiveSensorTable[i].firstTime + mActiveSensorTable[i].latency &&
+                !hostIntfGetInterrupt(mActiveSensorTable[i].interrupt)) {
+                batchOpenWindow(mActiveSensorTable[i].interrupt);
             }
         }
     }
@@ -1229,6 +1664,7 @@ static void onConfigCmdEnableOne(struct ActiveSensor *sensor, struct ConfigCmd *
 {
     if (sensorRequestRateChange(mHostIntfTid, sensor->sensorHandle, cmd->rate, cmd->latency)) {
         sensor->rate = cmd->rate;
+        sensor->compress = (cmd->flags & CONFIG_FLAG_COMPRESS) != 0;
         if (sensor->latency != cmd->latency) {
             if (!sensor->latency) {
                 if (mLatencyCnt++ == 0)
@@ -1261,6 +1697,8 @@ static void onConfigCmdEnableAll(struct ActiveSensor *sensor, struct ConfigCmd *
             }
             sensor->rate = cmd->rate;
             sensor->latency = cmd->latency;
+            sensor->compress = (cmd->flags & CONFIG_FLAG_COMPRESS) != 0;
+            sensor->batchDeaf = false;
             osEventSubscribe(mHostIntfTid, sensorGetMyEventType(cmd->sensType));
             break;
         } else {
@@ -1283,6 +1721,7 @@ static void onConfigCmdDisableOne(struct ActiveSensor *sensor, struct ConfigCmd
     sensor->latency = 0;
     sensor->oneshot = false;
     sensor->sensorHandle = 0;
+    batchForgetSensor(sensor);
     if (sensor->buffer.length) {
         enqueueSensorBuffer(sensor);
         hostIntfSetInterrupt(sensor->interrupt);
@@ -1398,14 +1837,19 @@ static void copyEmbeddedSamples(struct ActiveSensor *sensor, const void* evtData
 static uint32_t getSensorInterrupt(struct ActiveSensor *sensor)
 {
     uint32_t interrupt = HOSTINTF_MAX_INTERRUPTS;
+    uint32_t queue = getOutputQueue(sensor->interrupt, true, true);
     uint64_t sensorTime = sensorGetTime();
 
     if (sensor->firstTime &&
         ((sensorTime >= sensor->firstTime + sensor->latency) ||
          ((sensor->latency > sensorGetCurLatency(sensor->sensorHandle)) &&
           (sensorTime + sensorGetCurLatency(sensor->sensorHandle) > sensor->firstTime + sensor->latency)))) {
-        interrupt = sensor->interrupt;
-    } else if (mWakeupBlocks + mNonWakeupBlocks >= mTotalBlocks) {
+        // batched data waits for its window; the interrupt goes up when that closes
+        if (sensor->latency && !hostIntfGetInterrupt(sensor->interrupt))
+            batchOpenWindow(sensor->interrupt);
+        else
+            interrupt = sensor->interrupt;
+    } else if (mOutputQUsed[queue] >= mOutputQBlocks[queue]) {
         interrupt = sensor->interrupt;
     }
 
@@ -1415,7 +1859,8 @@ static uint32_t getSensorInterrupt(struct ActiveSensor *sensor)
 static void onEvtSensorDataActive(struct ActiveSensor *sensor, uint32_t evtType, const void* evtData)
 {
     if (evtData == SENSOR_DATA_EVENT_FLUSH) {
-        queueFlush(sensor);
+        if (!batchFlushDone(sensor))
+            queueFlush(sensor);
     } else {
         bool haveFlush = sensor->buffer.firstSample.numFlushes > 0;
         if (sensor->buffer.length > 0 &&
@@ -1456,7 +1901,9 @@ static void onEvtSensorDataActive(struct ActiveSensor *sensor, uint32_t evtType,
 
 static void onEvtSensorDataInactive(struct ActiveSensor *sensor, uint32_t evtType, const void* evtData)
 {
-    if (evtData != SENSOR_DATA_EVENT_FLUSH) {
+    if (evtData == SENSOR_DATA_EVENT_FLUSH) {
+        batchFlushDone(sensor);
+    } else {
         // handle bias data which can be generated for sensors that are
         // not currently requested by the AP
         switch (sensor->numAxis) {
@@ -1499,10 +1946,18 @@ static void hostIntfHandleEvent(uint32_t evtType, const void* evtData)
     case EVT_DEBUG_LOG:
         onEvtDebugLog(evtData);
         break;
+#endif
+#if OS_TRACE
+    case EVT_TRACE:
+        onEvtTrace(evtData);
+        break;
 #endif
     case EVT_LATENCY_TIMER:
         onEvtLatencyTimer(evtData);
         break;
+    case EVT_BATCH_TIMER:
+        onEvtBatchTimer(evtData);
+        break;
     case EVT_NO_SENSOR_CONFIG_EVENT:
         onEvtNoSensorConfigEvent(evtData);
         break;
@@ -1533,6 +1988,40 @@ void hostIntfClearInterrupts()
     }
 }
 
+//with interrupts off
+static void hostIntfRollWakeupHour(uint64_t now)
+{
+    if (now >= mWakeupHourEnd) {
+        mWakeupStats.apWakeupsLastHour = now < mWakeupHourEnd + WAKEUP_STATS_HOUR ? mWakeupsThisHour : 0;
+        mWakeupsThisHour = 0;
+        mWakeupHourEnd = now < mWakeupHourEnd + WAKEUP_STATS_HOUR ? mWakeupHourEnd + WAKEUP_STATS_HOUR : now + WAKEUP_STATS_HOUR;
+    }
+}
+
+//with interrupts off
+static void hostIntfCountApWakeup(void)
+{
+    hostIntfRollWakeupHour(sensorGetTime());
+    mWakeupsThisHour++;
+    mWakeupStats.apWakeups++;
+}
+
+void hostIntfGetWakeupStats(struct HostIntfWakeupStats *stats)
+{
+    uint64_t state = cpuIntsOff();
+
+    hostIntfRollWakeupHour(sensorGetTime());
+    *stats = mWakeupStats;
+    cpuIntsRestore(state);
+}
+
+uint32_t hostIntfGetDroppedSamples(uint32_t sensorType)
+{
+    struct ActiveSensor *sensor = getActiveSensorByType(sensorType);
+
+    return sensor ? sensor->dropped : 0;
+}
+
 void hostIntfSetInterrupt(uint32_t bit)
 {
     uint64_t state = cpuIntsOff();
@@ -1540,8 +2029,10 @@ void hostIntfSetInterrupt(uint32_t bit)
         if (!atomicBitsetGetBit(mInterrupt, bit)) {
             atomicBitsetSetBit(mInterrupt, bit);
             if (!atomicBitsetGetBit(mInterruptMask, bit)) {
-                if (mInterruptCntWkup++ == 0)
+                if (mInterruptCntWkup++ == 0) {
+                    hostIntfCountApWakeup();
                     apIntSet(true);
+                }
             } else {
                 if (mInterruptCntNonWkup++ == 0)
                     apIntSet(false);
@@ -1603,8 +2094,10 @@ void hostIntfClearInterruptMask(uint32_t bit)
         if (atomicBitsetGetBit(mInterruptMask, bit)) {
             atomicBitsetClearBit(mInterruptMask, bit);
             if (atomicBitsetGetBit(mInterrupt, bit)) {
-                if (mInterruptCntWkup++ == 0)
+                if (mInterruptCntWkup++ == 0) {
+                    hostIntfCountApWakeup();
                     apIntSet(true);
+                }
                 if (--mInterruptCntNonWkup == 0)
                     apIntClear(false);
             }
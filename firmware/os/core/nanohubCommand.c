@@ -45,6 +45,7 @@
 #include <slab.h>
 #include <sensType.h>
 #include <timer.h>
+#include <trace.h>
 #include <appSec.h>
 #include <cpu.h>
 #include <cpu/cpuMath.h>
@@ -54,6 +55,10 @@
         { .reason = _reason, .fastHandler = _fastHandler, .handler = _handler, \
           .minDataLen = sizeof(_minReqType), .maxDataLen = sizeof(_maxReqType) }
 
+#define NANOHUB_BULK_COMMAND(_reason, _handler, _minReqType, _maxReqType) \
+        { .reason = _reason, .handler = _handler, .bulk = true, \
+          .minDataLen = sizeof(_minReqType), .maxDataLen = sizeof(_maxReqType) }
+
 #define NANOHUB_HAL_COMMAND(_msg, _handler) \
         { .msg = _msg, .handler = _handler }
 
@@ -63,6 +68,9 @@
 // numbers don't buy us that much
 #define MAX_APP_SEC_RX_DATA_LEN 64
 
+// packets built ahead for READ_EVENT; must divide 256
+#define TX_RING_SIZE 4
+
 #define REQUIRE_SIGNED_IMAGE    true
 #define DEBUG_APHUB_TIME_SYNC   false
 
@@ -87,28 +95,48 @@ struct DownloadState
     bool     eraseScheduled;
 };
 
+/*
+ * nanohubPrefetchTx() fills slots at mTxRingHead from the deferred context; readEventFast()
+ * takes them at mTxRingTail straight from the rx interrupt (readEventData() when it does
+ * not). A slot is not touched again once published, so the fast path never has to wait
+ * for a prefetch in progress.
+ */
+struct TxRingSlot
+{
+    struct HostIntfDataBuffer packet;
+    uint32_t wakeup;    // blocks pending, this slot's included, while it is next to go
+    uint32_t nonwakeup;
+    uint8_t  length;
+};
+
 static struct DownloadState *mDownloadState;
 static AppSecErr mAppSecStatus;
-static struct SlabAllocator *mEventSlab;
-static struct HostIntfDataBuffer mTxCurr, mTxNext;
-static uint8_t mTxCurrLength, mTxNextLength;
-static uint8_t mPrefetchActive, mPrefetchTx;
+static struct SlabCache *mEventCache;
+static struct TxRingSlot mTxRing[TX_RING_SIZE];
+static uint8_t mTxRingHead, mTxRingTail;
+static struct HostIntfDataBuffer mTxNext;
+static uint8_t mTxNextLength;
 static uint32_t mTxWakeCnt[2];
 static struct ApHubSync mTimeSync;
 
 static inline bool isSensorEvent(uint32_t evtType)
 {
-    return evtType > EVT_NO_FIRST_SENSOR_EVENT && evtType <= EVT_NO_FIRST_SENSOR_EVENT + SENS_TYPE_LAST_USER;
+    return (evtType > EVT_NO_FIRST_SENSOR_EVENT && evtType <= EVT_NO_FIRST_SENSOR_EVENT + SENS_TYPE_LAST_USER) ||
+           (evtType > EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT && evtType <= EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT + SENS_TYPE_LAST_USER);
 }
 
-static void slabFree(void *ptr)
+static void eventCacheFree(void *ptr)
 {
-    slabAllocatorFree(mEventSlab, ptr);
+    slabCacheFree(mEventCache, ptr);
 }
 
 void nanohubInitCommand(void)
 {
-    mEventSlab = slabAllocatorNew(NANOHUB_PACKET_PAYLOAD_MAX-sizeof(__le32), 4, 2);
+    // most events from the host are sensor configs, well under the small size
+    static const uint32_t itemSzs[] = { 32, NANOHUB_PACKET_PAYLOAD_MAX-sizeof(__le32) };
+    static const uint32_t numItems[] = { 4, 2 };
+
+    mEventCache = slabCacheNew(itemSzs, numItems, ARRAY_SIZE(itemSzs), 4);
 }
 
 static inline uint64_t unaligned_u64(uint64_t *val) {
@@ -701,6 +729,9 @@ static int fillBuffer(void *tx, uint32_t totLength, uint32_t *wakeup, uint32_t *
             case HOSTINTF_DATA_TYPE_APP_TO_SENSOR_HAL:
                 packet->evtType = htole32(EVT_APP_TO_SENSOR_HAL_DATA);
                 break;
+            case HOSTINTF_DATA_TYPE_TRACE:
+                packet->evtType = htole32(HOST_EVT_TRACE);
+                break;
 #ifdef DEBUG_LOG_EVT
             case HOSTINTF_DATA_TYPE_LOG:
                 packet->evtType = htole32(HOST_EVT_DEBUG_LOG);
@@ -711,7 +742,10 @@ static int fillBuffer(void *tx, uint32_t totLength, uint32_t *wakeup, uint32_t *
                 break;
             }
         } else {
-            packet->evtType = htole32(EVT_NO_FIRST_SENSOR_EVENT + packet->sensType);
+            if (packet->dataType == HOSTINTF_DATA_TYPE_COMPRESSED_SENSOR)
+                packet->evtType = htole32(EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT + packet->sensType);
+            else
+                packet->evtType = htole32(EVT_NO_FIRST_SENSOR_EVENT + packet->sensType);
             if (packet->referenceTime)
                 packet->referenceTime += getAvgDelta(&mTimeSync);
 
@@ -743,9 +777,19 @@ static void updateInterrupts(void)
 {
     uint32_t wakeup = atomicRead32bits(&mTxWakeCnt[0]);
     uint32_t nonwakeup = atomicRead32bits(&mTxWakeCnt[1]);
+    uint8_t tail = atomicReadByte(&mTxRingTail);
+    struct TxRingSlot *slot = &mTxRing[tail % TX_RING_SIZE];
     bool wakeupStatus = hostIntfGetInterrupt(NANOHUB_INT_WAKEUP);
     bool nonwakeupStatus = hostIntfGetInterrupt(NANOHUB_INT_NONWAKEUP);
 
+    // packets still in the ring hold blocks the counters no longer see
+    if (tail != atomicReadByte(&mTxRingHead)) {
+        if (wakeup < slot->wakeup)
+            wakeup = slot->wakeup;
+        if (nonwakeup < slot->nonwakeup)
+            nonwakeup = slot->nonwakeup;
+    }
+
     if (!wakeup && wakeupStatus)
         hostIntfClearInterrupt(NANOHUB_INT_WAKEUP);
     else if (wakeup && !wakeupStatus)
@@ -757,9 +801,26 @@ static void updateInterrupts(void)
         hostIntfSetInterrupt(NANOHUB_INT_NONWAKEUP);
 }
 
+static uint32_t txRingGet(void *tx)
+{
+    uint8_t tail = atomicReadByte(&mTxRingTail);
+    struct TxRingSlot *slot = &mTxRing[tail % TX_RING_SIZE];
+    uint32_t length;
+
+    if (tail == atomicReadByte(&mTxRingHead))
+        return 0;
+
+    length = slot->length;
+    memcpy(tx, &slot->packet, length);
+    atomicWriteByte(&mTxRingTail, tail + 1);
+
+    return length;
+}
+
 void nanohubPrefetchTx(uint32_t interrupt, uint32_t wakeup, uint32_t nonwakeup)
 {
-    uint64_t state;
+    struct TxRingSlot *slot;
+    uint8_t head = mTxRingHead;
 
     if (wakeup < atomicRead32bits(&mTxWakeCnt[0]))
         wakeup = atomicRead32bits(&mTxWakeCnt[0]);
@@ -770,42 +831,32 @@ void nanohubPrefetchTx(uint32_t interrupt, uint32_t wakeup, uint32_t nonwakeup)
     if (interrupt == HOSTINTF_MAX_INTERRUPTS && !hostIntfGetInterrupt(NANOHUB_INT_WAKEUP) && !hostIntfGetInterrupt(NANOHUB_INT_NONWAKEUP))
         return;
 
-    atomicWriteByte(&mPrefetchActive, 1);
-
     if (interrupt < HOSTINTF_MAX_INTERRUPTS)
         hostIntfSetInterrupt(interrupt);
 
-    do {
-        if (atomicReadByte(&mTxCurrLength) == 0 && mTxNextLength > 0) {
-            memcpy(&mTxCurr, &mTxNext, mTxNextLength);
-            atomicWriteByte(&mTxCurrLength, mTxNextLength);
-            mTxNextLength = 0;
-        }
+    while ((uint8_t)(head - atomicReadByte(&mTxRingTail)) < TX_RING_SIZE) {
+        slot = &mTxRing[head % TX_RING_SIZE];
+        slot->wakeup = wakeup;
+        slot->nonwakeup = nonwakeup;
+        slot->length = 0;
 
-        if (mTxNextLength == 0) {
-            atomicWriteByte(&mTxCurrLength, fillBuffer(&mTxCurr, atomicReadByte(&mTxCurrLength), &wakeup, &nonwakeup));
-            atomicWrite32bits(&mTxWakeCnt[0], wakeup);
-            atomicWrite32bits(&mTxWakeCnt[1], nonwakeup);
+        if (mTxNextLength > 0) {
+            memcpy(&slot->packet, &mTxNext, mTxNextLength);
+            slot->length = mTxNextLength;
+            mTxNextLength = 0;
         }
 
-        atomicWriteByte(&mPrefetchActive, 0);
+        slot->length = fillBuffer(&slot->packet, slot->length, &wakeup, &nonwakeup);
+        if (slot->length)
+            atomicWriteByte(&mTxRingHead, ++head);
 
-        if (atomicReadByte(&mPrefetchTx)) {
-            state = cpuIntsOff();
-
-            // interrupt occured during this call
-            // take care of it
-            hostIntfTxAck(&mTxCurr, atomicReadByte(&mTxCurrLength));
-            atomicWriteByte(&mPrefetchTx, 0);
-            atomicWriteByte(&mTxCurrLength, 0);
-
-            cpuIntsRestore(state);
-
-            updateInterrupts();
-        } else {
+        if (mTxNextLength == 0)
             break;
-        }
-    } while (mTxNextLength > 0);
+    }
+
+    // only now that the packets are published may the counters drop
+    atomicWrite32bits(&mTxWakeCnt[0], wakeup);
+    atomicWrite32bits(&mTxWakeCnt[1], nonwakeup);
 }
 
 static void nanohubPrefetchTxDefer(void *cookie)
@@ -816,40 +867,27 @@ static void nanohubPrefetchTxDefer(void *cookie)
 static uint32_t readEventFast(void *rx, uint8_t rx_len, void *tx, uint64_t timestamp)
 {
     struct NanohubReadEventRequest *req = rx;
-    uint8_t ret = 0;
+    uint32_t ret;
 
-    if (atomicReadByte(&mPrefetchActive)) {
-        atomicWriteByte(&mPrefetchTx, 1);
-        return NANOHUB_FAST_DONT_ACK;
-    } else {
-        if ((ret = atomicReadByte(&mTxCurrLength))) {
-            addDelta(&mTimeSync, req->apBootTime, timestamp);
+    if ((ret = txRingGet(tx))) {
+        addDelta(&mTimeSync, req->apBootTime, timestamp);
 
-            memcpy(tx, &mTxCurr, ret);
-            atomicWriteByte(&mTxCurrLength, 0);
-
-            updateInterrupts();
-            osDefer(nanohubPrefetchTxDefer, NULL, true);
-        } else {
-            return NANOHUB_FAST_UNHANDLED_ACK;
-        }
+        updateInterrupts();
+        osDefer(nanohubPrefetchTxDefer, NULL, true);
+    } else {
+        return NANOHUB_FAST_UNHANDLED_ACK;
     }
 
     return ret;
 }
 
-static uint32_t readEvent(void *rx, uint8_t rx_len, void *tx, uint64_t timestamp)
+static uint32_t readEventData(void *tx)
 {
-    struct NanohubReadEventRequest *req = rx;
     uint8_t *buf = tx;
     uint32_t length, wakeup, nonwakeup;
     uint32_t totLength = 0;
 
-    addDelta(&mTimeSync, req->apBootTime, timestamp);
-
-    if ((totLength = atomicReadByte(&mTxCurrLength))) {
-        memcpy(tx, &mTxCurr, totLength);
-        atomicWriteByte(&mTxCurrLength, 0);
+    if ((totLength = txRingGet(tx))) {
         updateInterrupts();
         return totLength;
     }
@@ -878,13 +916,50 @@ static uint32_t readEvent(void *rx, uint8_t rx_len, void *tx, uint64_t timestamp
     return totLength;
 }
 
+static uint32_t readEvent(void *rx, uint8_t rx_len, void *tx, uint64_t timestamp)
+{
+    struct NanohubReadEventRequest *req = rx;
+
+    addDelta(&mTimeSync, req->apBootTime, timestamp);
+
+    return readEventData(tx);
+}
+
+#if HOSTINTF_READ_EVENTS_MAX
+static uint32_t readEvents(void *rx, uint8_t rx_len, void *tx, uint64_t timestamp)
+{
+    struct NanohubReadEventsRequest *req = rx;
+    struct NanohubPacket *packet = tx;
+    uint32_t maxLength = le16toh(req->maxLength);
+    uint32_t totLength = 0, length;
+
+    addDelta(&mTimeSync, req->apBootTime, timestamp);
+
+    if (maxLength > HOSTINTF_READ_EVENTS_MAX)
+        maxLength = HOSTINTF_READ_EVENTS_MAX;
+
+    // hostIntf fills in the rest of each packet; the empty one ends the run
+    do {
+        if (!totLength || totLength + NANOHUB_PACKET_SIZE_MAX + NANOHUB_PACKET_SIZE_MIN <= maxLength)
+            length = readEventData(packet->data);
+        else
+            length = 0;
+        packet->len = length;
+        totLength += NANOHUB_PACKET_SIZE(length);
+        packet = (struct NanohubPacket *)((uint8_t *)packet + NANOHUB_PACKET_SIZE(length));
+    } while (length);
+
+    return totLength;
+}
+#endif
+
 static bool forwardPacket(uint32_t event, void *data, size_t data_size,
                           void *hdr, size_t hdr_size, uint32_t tid)
 {
     bool res;
     uint8_t *hostPacket = data;
-    uint8_t *packet = slabAllocatorAlloc(mEventSlab);
-    EventFreeF free = slabFree;
+    uint8_t *packet = slabCacheAlloc(mEventCache, data_size + hdr_size);
+    EventFreeF free = eventCacheFree;
 
     if (!packet) {
         packet = heapAlloc(data_size + hdr_size);
@@ -1015,6 +1090,12 @@ const static struct NanohubCommand mBuiltinCommands[] = {
                     writeEvent,
                     __le32,
                     struct NanohubWriteEventRequest),
+#if HOSTINTF_READ_EVENTS_MAX
+    NANOHUB_BULK_COMMAND(NANOHUB_REASON_READ_EVENTS,
+                         readEvents,
+                         struct NanohubReadEventsRequest,
+                         struct NanohubReadEventsRequest),
+#endif
 };
 
 const struct NanohubCommand *nanohubFindCommand(uint32_t packetReason)
@@ -1068,6 +1149,24 @@ static void halExtAppDelete(void *rx, uint8_t rx_len)
 
 static void halQueryMemInfo(void *rx, uint8_t rx_len)
 {
+    struct NanohubHalQueryMemInfoTx *resp;
+    struct HeapStats stats;
+    bool haveStats;
+
+    if (!(resp = heapAlloc(sizeof(*resp))))
+        return;
+
+    haveStats = heapGetStats(&stats);
+
+    resp->hdr.appId = APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 0);
+    resp->hdr.len = sizeof(*resp) - sizeof(struct NanohubHalHdr) + 1;
+    resp->hdr.msg = NANOHUB_HAL_QUERY_MEMINFO;
+    resp->flashSz = resp->blSz = resp->osSz = resp->sharedSz = resp->eeSz = htole32(NANOHUB_HAL_MEM_SZ_UNKNOWN);
+    resp->blUse = resp->osUse = resp->sharedUse = resp->eeUse = htole32(NANOHUB_HAL_MEM_SZ_UNKNOWN);
+    resp->ramSz = htole32(haveStats ? stats.totalBytes : NANOHUB_HAL_MEM_SZ_UNKNOWN);
+    resp->ramUse = htole32(haveStats ? stats.totalBytes - stats.freeBytes : NANOHUB_HAL_MEM_SZ_UNKNOWN);
+
+    osEnqueueEvtOrFree(EVT_APP_TO_HOST, resp, heapFree);
 }
 
 static void halQueryApps(void *rx, uint8_t rx_len)
@@ -1075,8 +1174,9 @@ static void halQueryApps(void *rx, uint8_t rx_len)
     struct NanohubHalQueryAppsRx *req = rx;
     struct NanohubHalQueryAppsTx *resp;
     struct NanohubHalHdr *hdr;
+    struct HeapTaskStats heapUse;
     uint64_t appId;
-    uint32_t appVer, appSize;
+    uint32_t appVer, appSize, tid;
 
     if (osAppInfoByIndex(le32toh(req->idx), &appId, &appVer, &appSize)) {
         resp = heapAlloc(sizeof(*resp));
@@ -1087,7 +1187,7 @@ static void halQueryApps(void *rx, uint8_t rx_len)
             resp->appId = appId;
             resp->version = appVer;
             resp->flashUse = appSize;
-            resp->ramUse = 0;
+            resp->ramUse = osTidById(&appId, &tid) && heapGetTaskStats(tid, &heapUse) ? heapUse.curBytes : 0;
             osEnqueueEvtOrFree(EVT_APP_TO_HOST, resp, heapFree);
         }
     } else {
@@ -1198,6 +1298,168 @@ static void halFinishUpload(void *rx, uint8_t rx_len)
     osEnqueueEvtOrFree(EVT_APP_TO_HOST, resp, heapFree);
 }
 
+static void halQueryHeap(void *rx, uint8_t rx_len)
+{
+    struct NanohubHalQueryHeapRx *req = rx;
+    struct NanohubHalQueryHeapTx *resp;
+    struct HeapStats stats;
+    struct HeapTaskStats taskStats;
+    uint64_t appId;
+    uint32_t appVer, appSize, tid;
+
+    if (!(resp = heapAlloc(sizeof(*resp))))
+        return;
+
+    if (!heapGetStats(&stats))
+        stats = (struct HeapStats){0};
+
+    resp->hdr.appId = APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 0);
+    resp->hdr.msg = NANOHUB_HAL_QUERY_HEAP;
+    resp->heapSz = htole32(stats.totalBytes);
+    resp->freeSz = htole32(stats.freeBytes);
+    resp->largestFree = htole32(stats.largestFree);
+    resp->freeChunks = htole32(stats.freeChunks);
+
+    if (osAppInfoByIndex(le32toh(req->idx), &appId, &appVer, &appSize)) {
+        if (!osTidById(&appId, &tid) || !heapGetTaskStats(tid, &taskStats))
+            taskStats = (struct HeapTaskStats){0};
+        resp->hdr.len = sizeof(*resp) - sizeof(struct NanohubHalHdr) + 1;
+        resp->appId = htole64(appId);
+        resp->curUse = htole32(taskStats.curBytes);
+        resp->peakUse = htole32(taskStats.peakBytes);
+        resp->allocCnt = htole32(taskStats.allocs);
+        resp->failCnt = htole32(taskStats.failed);
+    } else {
+        resp->hdr.len = offsetof(struct NanohubHalQueryHeapTx, appId) - sizeof(struct NanohubHalHdr) + 1;
+    }
+
+    osEnqueueEvtOrFree(EVT_APP_TO_HOST, resp, heapFree);
+}
+
+static void halQueryEvtDrops(void *rx, uint8_t rx_len)
+{
+    struct NanohubHalQueryEvtDropsTx *resp;
+    struct EvtQueueDropStat stats[NANOHUB_HAL_EVT_DROPS_MAX];
+    uint32_t i, num, total;
+
+    num = osGetEvtDropStats(stats, NANOHUB_HAL_EVT_DROPS_MAX, &total);
+    if (!(resp = heapAlloc(sizeof(*resp) + sizeof(resp->drops[0]) * num)))
+        return;
+
+    resp->hdr.appId = APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 0);
+    resp->hdr.len = sizeof(*resp) - sizeof(struct NanohubHalHdr) + 1 + sizeof(resp->drops[0]) * num;
+    resp->hdr.msg = NANOHUB_HAL_QUERY_EVT_DROPS;
+    resp->total = htole32(total);
+    for (i = 0; i < num; i++) {
+        resp->drops[i].evtType = htole32(stats[i].evtType);
+        resp->drops[i].count = htole32(stats[i].count);
+    }
+
+    osEnqueueEvtOrFree(EVT_APP_TO_HOST, resp, heapFree);
+}
+
+static void halQueryTaskProf(void *rx, uint8_t rx_len)
+{
+    struct NanohubHalQueryTaskProfRx *req = rx;
+    struct NanohubHalQueryTaskProfTx *resp;
+    struct TaskProfile prof;
+    uint32_t idx = 0;
+    uint8_t flags = 0;
+
+    if (rx_len >= sizeof(req->idx))
+        idx = le32toh(req->idx);
+    if (rx_len >= sizeof(*req))
+        flags = req->flags;
+
+    if (!(resp = heapAlloc(sizeof(*resp))))
+        return;
+
+    resp->hdr.appId = APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 0);
+    resp->hdr.msg = NANOHUB_HAL_QUERY_TASK_PROF;
+
+    if (osGetTaskProfile(idx, &prof)) {
+        resp->hdr.len = sizeof(*resp) - sizeof(struct NanohubHalHdr) + 1;
+        resp->window = htole64(prof.window);
+        resp->appId = htole64(prof.appId);
+        resp->tid = htole32(prof.tid);
+        resp->evtCnt = htole32(prof.evtCnt);
+        resp->runTime = htole64(prof.runTime);
+        resp->maxRunTime = htole32(prof.maxRunTime);
+        resp->waitCnt = htole32(prof.waitCnt);
+        resp->waitTime = htole64(prof.waitTime);
+        resp->maxWaitTime = htole32(prof.maxWaitTime);
+    } else {
+        resp->hdr.len = offsetof(struct NanohubHalQueryTaskProfTx, appId) - sizeof(struct NanohubHalHdr) + 1;
+        resp->window = htole64(osGetTaskProfile(0, &prof) ? prof.window : 0);
+    }
+
+    if (flags & NANOHUB_HAL_TASK_PROF_RESET)
+        osResetTaskProfiles();
+
+    osEnqueueEvtOrFree(EVT_APP_TO_HOST, resp, heapFree);
+}
+
+static void halTrace(void *rx, uint8_t rx_len)
+{
+    struct NanohubHalTraceRx *req = rx;
+    struct NanohubHalTraceTx *resp;
+
+    if (rx_len >= sizeof(*req))
+        traceEnable(req->enable != 0);
+
+    if (!(resp = heapAlloc(sizeof(*resp))))
+        return;
+
+    resp->hdr.appId = APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 0);
+    resp->hdr.len = sizeof(*resp) - sizeof(struct NanohubHalHdr) + 1;
+    resp->hdr.msg = NANOHUB_HAL_TRACE;
+    resp->enabled = traceIsEnabled();
+
+    osEnqueueEvtOrFree(EVT_APP_TO_HOST, resp, heapFree);
+}
+
+static void halQueryWakeupStats(void *rx, uint8_t rx_len)
+{
+    struct NanohubHalQueryWakeupStatsTx *resp;
+    struct HostIntfWakeupStats stats;
+
+    if (!(resp = heapAlloc(sizeof(*resp))))
+        return;
+
+    hostIntfGetWakeupStats(&stats);
+
+    resp->hdr.appId = APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 0);
+    resp->hdr.len = sizeof(*resp) - sizeof(struct NanohubHalHdr) + 1;
+    resp->hdr.msg = NANOHUB_HAL_QUERY_WAKEUP_STATS;
+    resp->apWakeups = htole32(stats.apWakeups);
+    resp->apWakeupsLastHour = htole32(stats.apWakeupsLastHour);
+    resp->batchWindows = htole32(stats.batchWindows);
+    resp->batchFlushes = htole32(stats.batchFlushes);
+
+    osEnqueueEvtOrFree(EVT_APP_TO_HOST, resp, heapFree);
+}
+
+static void halQueryTimerStats(void *rx, uint8_t rx_len)
+{
+    struct NanohubHalQueryTimerStatsTx *resp;
+    struct TimerStats stats;
+
+    if (!(resp = heapAlloc(sizeof(*resp))))
+        return;
+
+    timGetStats(&stats);
+
+    resp->hdr.appId = APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 0);
+    resp->hdr.len = sizeof(*resp) - sizeof(struct NanohubHalHdr) + 1;
+    resp->hdr.msg = NANOHUB_HAL_QUERY_TIMER_STATS;
+    resp->wakes = htole32(stats.wakes);
+    resp->fired = htole32(stats.fired);
+    resp->coalesced = htole32(stats.coalesced);
+    resp->wakesPerSec = htole32(stats.wakesPerSec);
+
+    osEnqueueEvtOrFree(EVT_APP_TO_HOST, resp, heapFree);
+}
+
 static void halReboot(void *rx, uint8_t rx_len)
 {
     BL.blReboot();
@@ -1224,6 +1486,18 @@ const static struct NanohubHalCommand mBuiltinHalCommands[] = {
                         halFinishUpload),
     NANOHUB_HAL_COMMAND(NANOHUB_HAL_REBOOT,
                         halReboot),
+    NANOHUB_HAL_COMMAND(NANOHUB_HAL_QUERY_HEAP,
+                        halQueryHeap),
+    NANOHUB_HAL_COMMAND(NANOHUB_HAL_QUERY_EVT_DROPS,
+                        halQueryEvtDrops),
+    NANOHUB_HAL_COMMAND(NANOHUB_HAL_QUERY_TASK_PROF,
+                        halQueryTaskProf),
+    NANOHUB_HAL_COMMAND(NANOHUB_HAL_TRACE,
+                        halTrace),
+    NANOHUB_HAL_COMMAND(NANOHUB_HAL_QUERY_WAKEUP_STATS,
+                        halQueryWakeupStats),
+    NANOHUB_HAL_COMMAND(NANOHUB_HAL_QUERY_TIMER_STATS,
+                        halQueryTimerStats),
 };
 
 const struct NanohubHalCommand *nanohubHalFindCommand(uint8_t msg)
@@ -193,6 +193,26 @@ static void osChreApiSendEvent(uintptr_t *retValP, va_list args)
     *retValP = osChreSendEvent(evtType, evtData, freeCallback, toTid);
 }
 
+/*
+ * register-passed variants of the hottest calls; see syscallAddFastFunc()
+ */
+static void osChreFastGetTime(uintptr_t *retValP, const uintptr_t *params)
+{
+    uint64_t *timeNanos = (uint64_t *)params[0];
+    if (timeNanos)
+        *timeNanos = timGetTime();
+}
+
+static void osChreFastHeapAlloc(uintptr_t *retValP, const uintptr_t *params)
+{
+    *retValP = (uintptr_t)heapAlloc(params[0]);
+}
+
+static void osChreFastSendEvent(uintptr_t *retValP, const uintptr_t *params)
+{
+    *retValP = osChreSendEvent(params[0], (void *)params[1], (chreEventCompleteFunction *)params[2], params[3]);
+}
+
 static bool osChreSendMessageToHost(void *message, uint32_t messageSize,
                            uint32_t reservedMessageType,
                            chreMessageFreeFunction *freeCallback)
@@ -460,8 +480,15 @@ static const struct SyscallTable chreTable = {
     },
 };
 
+#define SYSCALL_CHRE_API(name) \
+    SYSCALL_NO(SYSCALL_DOMAIN_CHRE, SYSCALL_CHRE_MAIN, SYSCALL_CHRE_MAIN_API, SYSCALL_CHRE_MAIN_API_ ## name)
+
 void osChreApiExport()
 {
     if (!syscallAddTable(SYSCALL_NO(SYSCALL_DOMAIN_CHRE,0,0,0), 1, (struct SyscallTable*)&chreTable))
             osLog(LOG_ERROR, "Failed to export CHRE OS API");
+    else if (!syscallAddFastFunc(SYSCALL_CHRE_API(GET_TIME), osChreFastGetTime) ||
+             !syscallAddFastFunc(SYSCALL_CHRE_API(HEAP_ALLOC), osChreFastHeapAlloc) ||
+             !syscallAddFastFunc(SYSCALL_CHRE_API(SEND_EVENT), osChreFastSendEvent))
+            osLog(LOG_WARN, "Failed to add CHRE fast syscalls\n");
 }
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <stddef.h>
 #include <stdio.h>
 #include <printf.h>
 #include <cpu/cpuMath.h>
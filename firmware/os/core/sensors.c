@@ -22,6 +22,7 @@
 #include <sensors.h>
 #include <atomic.h>
 #include <stdio.h>
+#include <string.h>
 #include <slab.h>
 #include <seos.h>
 #include <util.h>
@@ -29,8 +30,16 @@
 #include <sensors_priv.h>
 
 
+#if MAX_REGISTERED_SENSORS >= SENSOR_IDX_NONE || MAX_CLI_SENS_MATRIX_SZ > 255
+#error "sensor slot indices and per-sensor request counts must fit in a uint8_t"
+#endif
+
+#define SENSOR_HASH_SZ MAX_REGISTERED_SENSORS
+
 static struct Sensor mSensors[MAX_REGISTERED_SENSORS];
 ATOMIC_BITSET_DECL(mSensorsUsed, MAX_REGISTERED_SENSORS, static);
+static uint8_t mSensorsByHandle[SENSOR_HASH_SZ]; /* heads of nextByHandle chains */
+static uint8_t mSensorsByType[SENSOR_HASH_SZ];   /* heads of nextByType chains */
 static struct SlabAllocator *mInternalEvents;
 static struct SlabAllocator *mCliSensMatrix;
 static uint32_t mNextSensorHandle;
@@ -47,6 +56,8 @@ static inline uint32_t newSensorHandle()
 bool sensorsInit(void)
 {
     atomicBitsetInit(mSensorsUsed, MAX_REGISTERED_SENSORS);
+    memset(mSensorsByHandle, SENSOR_IDX_NONE, sizeof(mSensorsByHandle));
+    memset(mSensorsByType, SENSOR_IDX_NONE, sizeof(mSensorsByType));
 
     mInternalEvents = slabAllocatorNew(sizeof(struct SensorsInternalEvent), alignof(struct SensorsInternalEvent), MAX_INTERNAL_EVENTS);
     if (!mInternalEvents)
@@ -61,31 +72,100 @@ bool sensorsInit(void)
     return false;
 }
 
+static inline uint32_t sensorHandleHash(uint32_t handle)
+{
+    // low bits are a counter, high bits the owner's tid
+    return (handle ^ (handle >> 16)) % SENSOR_HASH_SZ;
+}
+
+static inline uint32_t sensorTypeHash(uint32_t sensorType)
+{
+    return sensorType % SENSOR_HASH_SZ;
+}
+
+static void sensorIndexAdd(uint32_t idx)
+{
+    struct Sensor *s = mSensors + idx;
+    uint8_t *link = &mSensorsByHandle[sensorHandleHash(s->handle)];
+
+    s->nextByHandle = *link;
+    mem_reorder_barrier();
+    *link = idx;
+
+    /* type chains stay in slot order, so that sensorFind()'s idx means what it always did */
+    for (link = &mSensorsByType[sensorTypeHash(s->si->sensorType)]; *link < idx; link = &mSensors[*link].nextByType)
+        ;
+    s->nextByType = *link;
+    mem_reorder_barrier();
+    *link = idx;
+}
+
+static void sensorIndexRemove(uint32_t idx)
+{
+    struct Sensor *s = mSensors + idx;
+    uint8_t *link;
+
+    for (link = &mSensorsByHandle[sensorHandleHash(s->handle)]; *link != idx; link = &mSensors[*link].nextByHandle)
+        ;
+    *link = s->nextByHandle;
+
+    for (link = &mSensorsByType[sensorTypeHash(s->si->sensorType)]; *link != idx; link = &mSensors[*link].nextByType)
+        ;
+    *link = s->nextByType;
+}
+
 struct Sensor* sensorFindByHandle(uint32_t handle)
 {
     uint32_t i;
 
-    for (i = 0; i < MAX_REGISTERED_SENSORS; i++)
+    for (i = mSensorsByHandle[sensorHandleHash(handle)]; i != SENSOR_IDX_NONE; i = mSensors[i].nextByHandle)
         if (mSensors[i].handle == handle)
             return mSensors + i;
 
     return NULL;
 }
 
-static struct SensorsClientRequest* sensorClientRequestFind(uint32_t sensorHandle, uint32_t clientTid)
+static struct SensorsClientRequest* sensorClientRequestFind(struct Sensor *s, uint32_t clientTid)
 {
-    uint32_t i;
-
-    for (i = 0; i < MAX_CLI_SENS_MATRIX_SZ; i++) {
-        struct SensorsClientRequest *req = slabAllocatorGetNth(mCliSensMatrix, i);
+    struct SensorsClientRequest *req;
 
-        if (req && req->handle == sensorHandle && req->clientTid == clientTid)
+    for (req = s->reqs; req; req = req->next)
+        if (req->clientTid == clientTid)
             return req;
-    }
 
     return NULL;
 }
 
+static void sensorReqAggregateAdd(struct Sensor *s, uint32_t rate, uint64_t latency)
+{
+    s->numReqs++;
+    if (rate == SENSOR_RATE_ONCHANGE)
+        s->numOnchangeReqs++;
+    else if (rate != SENSOR_RATE_ONDEMAND && s->reqRate < rate)
+        s->reqRate = rate;
+
+    if (s->reqLatency > latency)
+        s->reqLatency = latency;
+}
+
+static void sensorReqAggregateReset(struct Sensor *s)
+{
+    s->reqLatency = SENSOR_LATENCY_INVALID;
+    s->reqRate = 0;
+    s->numReqs = 0;
+    s->numOnchangeReqs = 0;
+}
+
+/* a request went away or got weaker; only this sensor's requests are looked at */
+static void sensorReqAggregateRecalc(struct Sensor *s)
+{
+    struct SensorsClientRequest *req;
+
+    sensorReqAggregateReset(s);
+    for (req = s->reqs; req; req = req->next)
+        sensorReqAggregateAdd(s, req->rate, req->latency);
+}
+
 static uint32_t sensorRegisterEx(const struct SensorInfo *si, TaggedPtr callInfo, void *callData, bool initComplete)
 {
     int32_t idx = atomicBitsetFindClearAndSet(mSensorsUsed);
@@ -113,6 +193,8 @@ static uint32_t sensorRegisterEx(const struct SensorInfo *si, TaggedPtr callInfo
     // TODO: is internal app, callinfo is OPS struct; shall we validate it here?
     s->callData = callData;
     s->initComplete = initComplete ? 1 : 0;
+    s->reqs = NULL;
+    sensorReqAggregateReset(s);
     mem_reorder_barrier();
     s->handle = handle;
     s->hasOnchange = 0;
@@ -127,6 +209,8 @@ static uint32_t sensorRegisterEx(const struct SensorInfo *si, TaggedPtr callInfo
         }
     }
 
+    sensorIndexAdd(idx);
+
     return handle;
 }
 
@@ -157,10 +241,20 @@ bool sensorRegisterInitComplete(uint32_t handle)
 bool sensorUnregister(uint32_t handle)
 {
     struct Sensor *s = sensorFindByHandle(handle);
+    struct SensorsClientRequest *req;
 
     if (!s)
         return false;
 
+    sensorIndexRemove(s - mSensors);
+
+    /* requests against it can no longer be named by anyone */
+    while ((req = s->reqs)) {
+        s->reqs = req->next;
+        slabAllocatorFree(mCliSensMatrix, req);
+    }
+    sensorReqAggregateReset(s);
+
     /* mark as invalid */
     s->handle = 0;
     mem_reorder_barrier();
@@ -382,27 +476,33 @@ static void sensorReconfig(struct Sensor* s, uint32_t newHwRate, uint64_t newHwL
 
 static uint64_t sensorCalcHwLatency(struct Sensor* s)
 {
-    uint64_t smallestLatency = SENSOR_LATENCY_INVALID;
-    uint32_t i;
+    return s->reqLatency;
+}
 
-    for (i = 0; i < MAX_CLI_SENS_MATRIX_SZ; i++) {
-        struct SensorsClientRequest *req = slabAllocatorGetNth(mCliSensMatrix, i);
+/* highest numeric rate among this sensor's requests, not counting one request at removedRate */
+static uint32_t sensorReqHighestRateWithout(struct Sensor* s, uint32_t removedRate)
+{
+    struct SensorsClientRequest *req;
+    uint32_t highestReq = 0;
 
-        /* we only care about this sensor's stuff */
-        if (!req || req->handle != s->handle)
+    for (req = s->reqs; req; req = req->next) {
+        if (req->rate == removedRate) {
+            removedRate = SENSOR_RATE_OFF;
             continue;
+        }
 
-        if (smallestLatency > req->latency)
-            smallestLatency = req->latency;
+        if (req->rate != SENSOR_RATE_ONDEMAND && req->rate != SENSOR_RATE_ONCHANGE && highestReq < req->rate)
+            highestReq = req->rate;
     }
 
-    return smallestLatency;
+    return highestReq;
 }
 
+/* removedRate, if given, is the rate of one of this sensor's current requests */
 static uint32_t sensorCalcHwRate(struct Sensor* s, uint32_t extraReqedRate, uint32_t removedRate)
 {
-    bool haveUsers = false, haveOnChange = extraReqedRate == SENSOR_RATE_ONCHANGE;
-    uint32_t highestReq = 0;
+    uint32_t numReqs = s->numReqs, numOnchange = s->numOnchangeReqs;
+    uint32_t highestReq = s->reqRate;
     uint32_t i;
 
     if (s->si->supportedRates &&
@@ -412,42 +512,28 @@ static uint32_t sensorCalcHwRate(struct Sensor* s, uint32_t extraReqedRate, uint
         return SENSOR_RATE_IMPOSSIBLE;
     }
 
-    if (extraReqedRate) {
-        haveUsers = true;
-        highestReq = (extraReqedRate == SENSOR_RATE_ONDEMAND || extraReqedRate == SENSOR_RATE_ONCHANGE) ? 0 : extraReqedRate;
+    /* take one instance of a removed rate out if one was given; only losing the top rate needs a walk */
+    if (removedRate != SENSOR_RATE_OFF && numReqs) {
+        numReqs--;
+        if (removedRate == SENSOR_RATE_ONCHANGE)
+            numOnchange--;
+        else if (removedRate == highestReq)
+            highestReq = sensorReqHighestRateWithout(s, removedRate);
     }
 
-    for (i = 0; i < MAX_CLI_SENS_MATRIX_SZ; i++) {
-        struct SensorsClientRequest *req = slabAllocatorGetNth(mCliSensMatrix, i);
-
-        /* we only care about this sensor's stuff */
-        if (!req || req->handle != s->handle)
-            continue;
-
-        /* skip an instance of a removed rate if one was given */
-        if (req->rate == removedRate) {
-            removedRate = SENSOR_RATE_OFF;
-            continue;
-        }
-
-        haveUsers = true;
-
-        /* we can always do ondemand and if we see an on-change then we already checked and do allow it */
-        if (req->rate == SENSOR_RATE_ONDEMAND)
-            continue;
-        if (req->rate == SENSOR_RATE_ONCHANGE) {
-            haveOnChange = true;
-            continue;
-        }
-
-        if (highestReq < req->rate)
-            highestReq = req->rate;
+    /* we can always do ondemand and if we see an on-change then we already checked and do allow it */
+    if (extraReqedRate) {
+        numReqs++;
+        if (extraReqedRate == SENSOR_RATE_ONCHANGE)
+            numOnchange++;
+        else if (extraReqedRate != SENSOR_RATE_ONDEMAND && highestReq < extraReqedRate)
+            highestReq = extraReqedRate;
     }
 
     if (!highestReq) {   /* no requests -> we can definitely do that */
-        if (!haveUsers)
+        if (!numReqs)
             return SENSOR_RATE_OFF;
-        else if (haveOnChange)
+        else if (numOnchange)
             return SENSOR_RATE_ONCHANGE;
         else
             return SENSOR_RATE_ONDEMAND;
@@ -559,8 +645,8 @@ const struct SensorInfo* sensorFind(uint32_t sensorType, uint32_t idx, uint32_t
 {
     uint32_t i;
 
-    for (i = 0; i < MAX_REGISTERED_SENSORS; i++) {
-        if (mSensors[i].handle && mSensors[i].si->sensorType == sensorType && !idx--) {
+    for (i = mSensorsByType[sensorTypeHash(sensorType)]; i != SENSOR_IDX_NONE; i = mSensors[i].nextByType) {
+        if (mSensors[i].si->sensorType == sensorType && !idx--) {
             if (handleP)
                 *handleP = mSensors[i].handle;
             return mSensors[i].si;
@@ -570,25 +656,32 @@ const struct SensorInfo* sensorFind(uint32_t sensorType, uint32_t idx, uint32_t
     return NULL;
 }
 
-static bool sensorAddRequestor(uint32_t sensorHandle, uint32_t clientTid, uint32_t rate, uint64_t latency)
+static bool sensorAddRequestor(struct Sensor *s, uint32_t clientTid, uint32_t rate, uint64_t latency)
 {
-    struct SensorsClientRequest *req = slabAllocatorAlloc(mCliSensMatrix);
+    struct SensorsClientRequest **link, *req = slabAllocatorAlloc(mCliSensMatrix);
 
     if (!req)
         return false;
 
-    req->handle = sensorHandle;
+    req->handle = s->handle;
     req->clientTid = clientTid;
-    mem_reorder_barrier();
     req->rate = rate;
     req->latency = latency;
+    req->next = NULL;
+    mem_reorder_barrier();
+
+    /* keep them in request order */
+    for (link = &s->reqs; *link; link = &(*link)->next)
+        ;
+    *link = req;
+    sensorReqAggregateAdd(s, rate, latency);
 
     return true;
 }
 
-static bool sensorGetCurRequestorRate(uint32_t sensorHandle, uint32_t clientTid, uint32_t *rateP, uint64_t *latencyP)
+static bool sensorGetCurRequestorRate(struct Sensor *s, uint32_t clientTid, uint32_t *rateP, uint64_t *latencyP)
 {
-    struct SensorsClientRequest *req = sensorClientRequestFind(sensorHandle, clientTid);
+    struct SensorsClientRequest *req = sensorClientRequestFind(s, clientTid);
 
     if (req) {
         if (rateP)
@@ -601,34 +694,35 @@ static bool sensorGetCurRequestorRate(uint32_t sensorHandle, uint32_t clientTid,
     }
 }
 
-static bool sensorAmendRequestor(uint32_t sensorHandle, uint32_t clientTid, uint32_t newRate, uint64_t newLatency)
+static bool sensorAmendRequestor(struct Sensor *s, uint32_t clientTid, uint32_t newRate, uint64_t newLatency)
 {
-    struct SensorsClientRequest *req = sensorClientRequestFind(sensorHandle, clientTid);
+    struct SensorsClientRequest *req = sensorClientRequestFind(s, clientTid);
 
     if (req) {
         req->rate = newRate;
         req->latency = newLatency;
+        sensorReqAggregateRecalc(s);
         return true;
     } else {
         return false;
     }
 }
 
-static bool sensorDeleteRequestor(uint32_t sensorHandle, uint32_t clientTid)
+static bool sensorDeleteRequestor(struct Sensor *s, uint32_t clientTid)
 {
-    struct SensorsClientRequest *req = sensorClientRequestFind(sensorHandle, clientTid);
+    struct SensorsClientRequest **link, *req;
 
-    if (req) {
-        req->rate = SENSOR_RATE_OFF;
-        req->latency = SENSOR_LATENCY_INVALID;
-        req->clientTid = 0;
-        req->handle = 0;
-        mem_reorder_barrier();
-        slabAllocatorFree(mCliSensMatrix, req);
-        return true;
-    } else {
-        return false;
+    for (link = &s->reqs; (req = *link); link = &req->next) {
+        if (req->clientTid == clientTid) {
+            *link = req->next;
+            mem_reorder_barrier();
+            slabAllocatorFree(mCliSensMatrix, req);
+            sensorReqAggregateRecalc(s);
+            return true;
+        }
     }
+
+    return false;
 }
 
 bool sensorRequest(uint32_t unusedTid, uint32_t sensorHandle, uint32_t rate, uint64_t latency)
@@ -655,7 +749,7 @@ bool sensorRequest(uint32_t unusedTid, uint32_t sensorHandle, uint32_t rate, uin
     latency = latency > samplingPeriod ? latency : samplingPeriod;
 
     /* record the request */
-    if (!sensorAddRequestor(sensorHandle, clientTid, rate, latency))
+    if (!sensorAddRequestor(s, clientTid, rate, latency))
         return false;
 
     /* update actual sensor if needed */
@@ -682,7 +776,7 @@ bool sensorRequestRateChange(uint32_t unusedTid, uint32_t sensorHandle, uint32_t
 
     clientTid = osGetCurrentTid();
     /* get current rate */
-    if (!sensorGetCurRequestorRate(sensorHandle, clientTid, &oldRate, &oldLatency))
+    if (!sensorGetCurRequestorRate(s, clientTid, &oldRate, &oldLatency))
         return false;
 
     /* verify the new rate is possible given all other ongoing requests */
@@ -695,7 +789,7 @@ bool sensorRequestRateChange(uint32_t unusedTid, uint32_t sensorHandle, uint32_t
     newLatency = newLatency > samplingPeriod ? newLatency : samplingPeriod;
 
     /* record the request */
-    if (!sensorAmendRequestor(sensorHandle, clientTid, newRate, newLatency))
+    if (!sensorAmendRequestor(s, clientTid, newRate, newLatency))
         return false;
 
     /* update actual sensor if needed */
@@ -713,7 +807,7 @@ bool sensorRelease(uint32_t unusedTid, uint32_t sensorHandle)
         return false;
 
     /* record the request */
-    if (!sensorDeleteRequestor(sensorHandle, osGetCurrentTid()))
+    if (!sensorDeleteRequestor(s, osGetCurrentTid()))
         return false;
 
     /* update actual sensor if needed */
@@ -730,7 +824,7 @@ uint32_t sensorFreeAll(uint32_t clientTid)
     for (i = 0; i < MAX_REGISTERED_SENSORS; i++) {
         if (mSensors[i].handle) {
             s = mSensors + i;
-            if (sensorDeleteRequestor(s->handle, clientTid)) {
+            if (sensorDeleteRequestor(s, clientTid)) {
                 sensorReconfig(s, sensorCalcHwRate(s, 0, 0), sensorCalcHwLatency(s));
                 count1 ++;
             }
@@ -753,7 +847,7 @@ bool sensorTriggerOndemand(uint32_t unusedTid, uint32_t sensorHandle)
     if (!s || !s->hasOndemand)
         return false;
 
-    struct SensorsClientRequest *req = sensorClientRequestFind(sensorHandle, osGetCurrentTid());
+    struct SensorsClientRequest *req = sensorClientRequestFind(s, osGetCurrentTid());
 
     if (req)
         return sensorCallFuncTrigger(s);
@@ -772,6 +866,16 @@ bool sensorFlush(uint32_t sensorHandle)
     return sensorCallFuncFlush(s);
 }
 
+bool sensorIsSoleClient(uint32_t clientTid, uint32_t sensorHandle)
+{
+    struct Sensor* s = sensorFindByHandle(sensorHandle);
+
+    if (!s)
+        return false;
+
+    return s->numReqs == 1 && s->reqs->clientTid == clientTid;
+}
+
 bool sensorCalibrate(uint32_t sensorHandle)
 {
     struct Sensor* s = sensorFindByHandle(sensorHandle);
@@ -818,14 +922,16 @@ uint64_t sensorGetCurLatency(uint32_t sensorHandle)
 
 uint32_t sensorGetReqRate(uint32_t sensorHandle)
 {
-    struct SensorsClientRequest *req = sensorClientRequestFind(sensorHandle, osGetCurrentTid());
+    struct Sensor* s = sensorFindByHandle(sensorHandle);
+    struct SensorsClientRequest *req = s ? sensorClientRequestFind(s, osGetCurrentTid()) : NULL;
 
     return req ? req->rate : SENSOR_RATE_OFF;
 }
 
 uint64_t sensorGetReqLatency(uint32_t sensorHandle)
 {
-    struct SensorsClientRequest *req = sensorClientRequestFind(sensorHandle, osGetCurrentTid());
+    struct Sensor* s = sensorFindByHandle(sensorHandle);
+    struct SensorsClientRequest *req = s ? sensorClientRequestFind(s, osGetCurrentTid()) : NULL;
 
     return req ? req->latency : SENSOR_LATENCY_INVALID;
 }
@@ -42,24 +42,110 @@
 #include <slab.h>
 #include <syscall.h>
 #include <timer.h>
+#include <trace.h>
 #include <util.h>
 
 #include <nanohub/nanohub.h>
 
 #include <chreApi.h>
 
+#ifndef MAX_EVT_SUB_INDEX_SZ
+/* distinct user events with at least one subscriber; override may come from variant.h */
+#define MAX_EVT_SUB_INDEX_SZ             64
+#endif
+
+#ifndef OS_EVT_QUEUE_FLAGS
+#define OS_EVT_QUEUE_FLAGS               EVT_QUEUE_FL_LOCKLESS
+#endif
+
+#ifndef OS_EVT_PRIO_QUOTAS
+/* per-class dequeue quotas, indexed by EVT_PRIO_*; override may come from variant.h */
+#define OS_EVT_PRIO_QUOTAS               { 4, 8, 16, 0 }
+#endif
+
+#ifndef OS_EVT_PRIO_SIZES
+/* per-class lockless lane sizes, indexed by EVT_PRIO_*; 0 means the whole queue. a full lane
+ * refuses events, so only classes with few events in flight get less; override may come from variant.h */
+#define OS_EVT_PRIO_SIZES                { 64, 64, 0, 64 }
+#endif
+
+#ifndef OS_EVT_TYPE_QUOTAS
+/* {event number, max queued} for the chattiest discardable producers, so that none of them can fill
+ * the OS queue on its own; at most 8 entries; override may come from variant.h */
+#define OS_EVT_TYPE_QUOTAS               { \
+    { sensorGetMyEventType(SENS_TYPE_ACCEL), 128 }, \
+    { sensorGetMyEventType(SENS_TYPE_GYRO),  128 }, \
+    { sensorGetMyEventType(SENS_TYPE_MAG),   64 },  \
+}
+#endif
+
+#ifndef OS_EVT_BATCH_SZ
+/* events taken off the queue at once; bounds how long a newly queued high priority event may wait */
+#define OS_EVT_BATCH_SZ                  8
+#endif
+
+#define OS_EVT_PRIO_AUTO                 EVT_PRIO_NUM /* let osEvtDefaultPrio() pick */
+
+#define TASK_BITMAP_WORDS                ((MAX_TASKS + 31) / 32)
+
+/* app ID -> task index hash for running tasks; at least twice MAX_TASKS slots so probe chains stay short */
+#if MAX_TASKS <= 8
+#define APP_ID_HASH_BITS                 4
+#elif MAX_TASKS <= 16
+#define APP_ID_HASH_BITS                 5
+#elif MAX_TASKS <= 32
+#define APP_ID_HASH_BITS                 6
+#elif MAX_TASKS <= 64
+#define APP_ID_HASH_BITS                 7
+#else
+#define APP_ID_HASH_BITS                 8
+#endif
+#define APP_ID_HASH_SZ                   (1 << APP_ID_HASH_BITS)
+
 struct TaskPool {
     struct Task data[MAX_TASKS];
 };
 
+/* subscription index: event type -> bitmap of subscribed task indices; sorted by evt */
+struct EvtSubIndexEntry {
+    uint32_t tasks[TASK_BITMAP_WORDS];
+    uint32_t evt; // as subscribed, so it matches just what a scan of subbedEvents would
+};
+
+struct EvtSubIndex {
+    struct EvtSubIndexEntry entries[MAX_EVT_SUB_INDEX_SZ];
+    uint32_t count;
+    bool overflow; /* some subscription did not fit; until a rebuild fits them all, dispatch scans */
+};
+
+/* lives right before the payload of every buffer from osEvtBufAlloc() and osEvtBufSlabAlloc() */
+struct EvtBufHdr {
+    volatile uint32_t refs;
+    struct SlabAllocator *slab; /* NULL for heap buffers; also keeps payload 8-byte aligned on 32-bit */
+};
+
 static struct TaskPool mTaskPool;
+static struct EvtSubIndex mEvtSubIndex;
 static struct EvtQueue *mEvtsInternal;
+static struct EvtQueueItem mEvtBatch[OS_EVT_BATCH_SZ];
+static uint32_t mEvtBatchPos, mEvtBatchCnt;
 static struct SlabAllocator* mMiscInternalThingsSlab;
 static struct TaskList mFreeTasks;
 static struct TaskList mTasks;
+static TaskIndex mAppIdHash[APP_ID_HASH_SZ]; /* NO_NODE: free slot */
 static struct Task *mCurrentTask;
 static struct Task *mSystemTask;
 static TaggedPtr *mCurEvtEventFreeingInfo = NULL; //used as flag for retaining. NULL when none or already retained
+static void *mCurEvtSharedBuf; //payload of current event if it came from osEvtBufAlloc(); see osRetainCurrentEvent()
+static struct Task *mCurEvtSrcTask; //task that will free mCurEvtSharedBuf
+#if OS_TASK_PROFILE
+static uint32_t mCurEvtEnqTime; //EvtQueueItem.enqTime of event being dispatched
+static bool mCurEvtStamped; //mCurEvtEnqTime is valid; false outside of osDispatchEvt()
+static uint64_t mTaskProfStart;
+#define OS_EVT_QUEUE_PROF_FLAGS          EVT_QUEUE_FL_TIMESTAMP
+#else
+#define OS_EVT_QUEUE_PROF_FLAGS          0
+#endif
 
 static inline void list_init(struct TaskList *l)
 {
@@ -259,25 +345,169 @@ static void osFreeTask(struct Task *task)
     if (task) {
         task->flags = 0;
         task->ioCount = 0;
+        task->subbedEvents = NULL;
+        task->subbedEvtCount = 0;
         osTaskListAddTail(&mFreeTasks, task);
     }
 }
 
+static struct EvtSubIndexEntry *osEvtSubIndexFind(uint32_t evt, uint32_t *posP)
+{
+    uint32_t lo = 0, hi = mEvtSubIndex.count;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        uint32_t cur = mEvtSubIndex.entries[mid].evt;
+
+        if (cur == evt)
+            return &mEvtSubIndex.entries[mid];
+        else if (cur < evt)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (posP)
+        *posP = lo;
+
+    return NULL;
+}
+
+static bool osEvtSubIndexIsEmpty(const struct EvtSubIndexEntry *entry)
+{
+    uint32_t i;
+
+    for (i = 0; i < TASK_BITMAP_WORDS; i++)
+        if (entry->tasks[i])
+            return false;
+
+    return true;
+}
+
+// drop entries nobody is subscribed to anymore; must not run while an event is being dispatched
+static void osEvtSubIndexCompact(void)
+{
+    uint32_t i, j;
+
+    for (i = 0, j = 0; i < mEvtSubIndex.count; i++) {
+        if (osEvtSubIndexIsEmpty(&mEvtSubIndex.entries[i]))
+            continue;
+        if (i != j)
+            mEvtSubIndex.entries[j] = mEvtSubIndex.entries[i];
+        j++;
+    }
+    mEvtSubIndex.count = j;
+}
+
+static bool osEvtSubIndexAdd(uint32_t evt, struct Task *task)
+{
+    uint32_t idx = osTaskIndex(task);
+    uint32_t pos;
+    struct EvtSubIndexEntry *entry = osEvtSubIndexFind(evt, &pos);
+
+    if (!entry) {
+        if (mEvtSubIndex.count == MAX_EVT_SUB_INDEX_SZ) {
+            osEvtSubIndexCompact();
+            osEvtSubIndexFind(evt, &pos);
+        }
+        if (mEvtSubIndex.count == MAX_EVT_SUB_INDEX_SZ) {
+            mEvtSubIndex.overflow = true;
+            return false;
+        }
+        entry = &mEvtSubIndex.entries[pos];
+        memmove(entry + 1, entry, sizeof(*entry) * (mEvtSubIndex.count - pos));
+        memset(entry, 0, sizeof(*entry));
+        entry->evt = evt;
+        mEvtSubIndex.count++;
+    }
+    entry->tasks[idx / 32] |= 1UL << (idx % 32);
+
+    return true;
+}
+
+// start over from the subscription lists; same restrictions as osEvtSubIndexCompact()
+static void osEvtSubIndexRebuild(void)
+{
+    struct Task *task;
+    uint32_t i;
+
+    mEvtSubIndex.count = 0;
+    mEvtSubIndex.overflow = false;
+    for_each_task(&mTasks, task) {
+        for (i = 0; i < task->subbedEvtCount; i++)
+            osEvtSubIndexAdd(task->subbedEvents[i], task);
+    }
+}
+
+static void osEvtSubIndexDel(uint32_t evt, struct Task *task)
+{
+    uint32_t idx = osTaskIndex(task);
+    struct EvtSubIndexEntry *entry = osEvtSubIndexFind(evt, NULL);
+
+    if (entry)
+        entry->tasks[idx / 32] &= ~(1UL << (idx % 32));
+}
+
+// task is leaving; this may happen in the middle of event dispatch, so we only clear bits here
+static void osEvtSubIndexDelTask(struct Task *task)
+{
+    uint32_t idx = osTaskIndex(task);
+    uint32_t i;
+
+    if (idx >= MAX_TASKS)
+        return;
+
+    for (i = 0; i < mEvtSubIndex.count; i++)
+        mEvtSubIndex.entries[i].tasks[idx / 32] &= ~(1UL << (idx % 32));
+}
+
+static inline uint32_t osAppIdHash(uint64_t appId)
+{
+    return ((uint32_t)(appId ^ (appId >> 32)) * 2654435761U) >> (32 - APP_ID_HASH_BITS);
+}
+
+static void osAppIdHashAdd(struct Task *task)
+{
+    uint32_t i;
+
+    // never full: there are more slots than tasks
+    for (i = osAppIdHash(task->app->hdr.appId); mAppIdHash[i] != NO_NODE; i = (i + 1) % APP_ID_HASH_SZ)
+        ;
+    mAppIdHash[i] = osTaskIndex(task);
+}
+
+// tasks stop rarely, so instead of deleting from the probe chains we rebuild them
+static void osAppIdHashRebuild(void)
+{
+    struct Task *task;
+
+    memset(mAppIdHash, NO_NODE, sizeof(mAppIdHash));
+    for_each_task(&mTasks, task) {
+        if (task->app)
+            osAppIdHashAdd(task);
+    }
+}
+
 static void osRemoveTask(struct Task *task)
 {
     osTaskListRemoveTask(&mTasks, task);
+    osEvtSubIndexDelTask(task);
+    osAppIdHashRebuild();
 }
 
 static void osAddTask(struct Task *task)
 {
     osTaskListAddTail(&mTasks, task);
+    if (task->app)
+        osAppIdHashAdd(task);
 }
 
 struct Task* osTaskFindByTid(uint32_t tid)
 {
-    TaskIndex idx = TID_TO_TASK_IDX(tid);
+    struct Task *task = osTaskByIdx(TID_TO_TASK_IDX(tid));
 
-    return idx < MAX_TASKS ? &mTaskPool.data[idx] : NULL;
+    // the slot may have been reused since this TID was handed out
+    return task && task->tid == tid ? task : NULL;
 }
 
 static inline bool osTaskInit(struct Task *task)
@@ -313,12 +543,44 @@ static inline void osTaskEnd(struct Task *task)
     osSetCurrentTask(preempted);
 }
 
+#if OS_TASK_PROFILE
+static void osTaskProfWait(struct Task *task, uint64_t now)
+{
+    // enqueue time is platGetTicks() >> 10, so is the difference
+    uint64_t wait = (uint64_t)((uint32_t)(now >> 10) - mCurEvtEnqTime) << 10;
+
+    task->prof.waitCnt++;
+    task->prof.waitTime += wait;
+    if (wait > task->prof.maxWaitTime)
+        task->prof.maxWaitTime = wait > UINT32_MAX ? UINT32_MAX : wait;
+}
+
+static void osTaskProfRun(struct Task *task, uint64_t run)
+{
+    task->prof.evtCnt++;
+    task->prof.runTime += run;
+    if (run > task->prof.maxRunTime)
+        task->prof.maxRunTime = run > UINT32_MAX ? UINT32_MAX : run;
+}
+#endif
+
 static inline void osTaskHandle(struct Task *task, uint16_t evtType, uint16_t fromTid, const void* evtData)
 {
     struct Task *preempted = osSetCurrentTask(task);
+#if OS_TASK_PROFILE
+    uint64_t start = platGetTicks();
+
+    if (mCurEvtStamped)
+        osTaskProfWait(task, start);
+#endif
+    trace(TRACE_TASK_BEGIN, evtType, fromTid);
     cpuAppHandle(task->app, &task->platInfo,
                  EVENT_WITH_ORIGIN(evtType, osTaskIsChre(task) ? fromTid : 0),
                  evtData);
+    trace(TRACE_TASK_END, evtType, 0);
+#if OS_TASK_PROFILE
+    osTaskProfRun(task, platGetTicks() - start);
+#endif
     osSetCurrentTask(preempted);
 }
 
@@ -406,6 +668,11 @@ static void handleEventFreeing(uint32_t evtType, void *evtData, TaggedPtr evtFre
 
 static void osInit(void)
 {
+    static const uint8_t quotas[EVT_PRIO_NUM] = OS_EVT_PRIO_QUOTAS;
+    static const uint16_t sizes[EVT_PRIO_NUM] = OS_EVT_PRIO_SIZES;
+    static const struct { uint32_t evtType; uint32_t maxQueued; } typeQuotas[] = OS_EVT_TYPE_QUOTAS;
+    uint32_t i;
+
     heapInit();
     platInitialize();
 
@@ -413,10 +680,14 @@ static void osInit(void)
     cpuInitLate();
 
     /* create the queues */
-    if (!(mEvtsInternal = evtQueueAlloc(512, handleEventFreeing))) {
+    if (!(mEvtsInternal = evtQueueAllocEx(512, handleEventFreeing, OS_EVT_QUEUE_FLAGS | OS_EVT_QUEUE_PROF_FLAGS, sizes))) {
         osLog(LOG_INFO, "events failed to init\n");
         return;
     }
+    for (i = 0; i < EVT_PRIO_NUM; i++)
+        evtQueueSetPrioQuota(mEvtsInternal, i, quotas[i]);
+    for (i = 0; i < ARRAY_SIZE(typeQuotas); i++)
+        evtQueueSetTypeQuota(mEvtsInternal, typeQuotas[i].evtType, typeQuotas[i].maxQueued);
 
     mMiscInternalThingsSlab = slabAllocatorNew(sizeof(union SeosInternalSlabData), alignof(union SeosInternalSlabData), 64 /* for now? */);
     if (!mMiscInternalThingsSlab) {
@@ -428,9 +699,11 @@ static void osInit(void)
 static struct Task* osTaskFindByAppID(uint64_t appID)
 {
     struct Task *task;
+    uint32_t i;
 
-    for_each_task(&mTasks, task) {
-        if (task->app && task->app->hdr.appId == appID)
+    for (i = osAppIdHash(appID); mAppIdHash[i] != NO_NODE; i = (i + 1) % APP_ID_HASH_SZ) {
+        task = &mTaskPool.data[mAppIdHash[i]];
+        if (task->app->hdr.appId == appID)
             return task;
     }
 
@@ -919,6 +1192,7 @@ static void osStartTasks(void)
     osLog(LOG_DEBUG, "Initializing task pool...\n");
     list_init(&mTasks);
     list_init(&mFreeTasks);
+    osAppIdHashRebuild();
     for (i = 0; i < MAX_TASKS; ++i) {
         task = &mTaskPool.data[i];
         list_init(&task->list);
@@ -977,7 +1251,7 @@ static void osInternalEvtHandle(uint32_t evtType, void *evtData)
     case EVT_UNSUBSCRIBE_TO_EVT:
         /* get task */
         task = osTaskFindByTid(da->evtSub.tid);
-        if (!task)
+        if (!task || !task->subbedEvents || osTaskTestFlags(task, FL_TASK_STOPPED))
             break;
 
         for (j = 0; j < da->evtSub.numEvts; j++) {
@@ -985,8 +1259,10 @@ static void osInternalEvtHandle(uint32_t evtType, void *evtData)
             for (i = 0; i < task->subbedEvtCount && task->subbedEvents[i] != da->evtSub.evts[j]; i++);
 
             /* if unsub & found -> unsub */
-            if (evt == EVT_UNSUBSCRIBE_TO_EVT && i != task->subbedEvtCount)
+            if (evt == EVT_UNSUBSCRIBE_TO_EVT && i != task->subbedEvtCount) {
                 task->subbedEvents[i] = task->subbedEvents[--task->subbedEvtCount];
+                osEvtSubIndexDel(da->evtSub.evts[j], task);
+            }
             /* if sub & not found -> sub */
             else if (evt == EVT_SUBSCRIBE_TO_EVT && i == task->subbedEvtCount) {
                 if (task->subbedEvtListSz == task->subbedEvtCount) { /* enlarge the list */
@@ -1002,15 +1278,24 @@ static void osInternalEvtHandle(uint32_t evtType, void *evtData)
                 }
                 if (task->subbedEvtListSz > task->subbedEvtCount) { /* have space ? */
                     task->subbedEvents[task->subbedEvtCount++] = da->evtSub.evts[j];
+                    osEvtSubIndexAdd(da->evtSub.evts[j], task);
                 }
             }
         }
+        if (evt == EVT_UNSUBSCRIBE_TO_EVT) {
+            if (mEvtSubIndex.overflow)
+                osEvtSubIndexRebuild();
+            else
+                osEvtSubIndexCompact();
+        }
         break;
 
     case EVT_APP_END:
         task = evtData;
         osTaskEnd(task);
         osUnloadApp(task);
+        if (mEvtSubIndex.overflow)
+            osEvtSubIndexRebuild();
         break;
 
     case EVT_DEFERRED_CALLBACK:
@@ -1040,13 +1325,78 @@ void abort(void)
     while(1);
 }
 
+static inline struct EvtBufHdr *osEvtBufHdr(void *evtData)
+{
+    return ((struct EvtBufHdr *)evtData) - 1;
+}
+
+void *osEvtBufAlloc(uint32_t size)
+{
+    struct EvtBufHdr *hdr = heapAlloc(sizeof(struct EvtBufHdr) + size);
+
+    if (!hdr)
+        return NULL;
+
+    hdr->refs = 1;
+    hdr->slab = NULL;
+    return hdr + 1;
+}
+
+struct SlabAllocator *osEvtBufSlabNew(uint32_t size, uint32_t num)
+{
+    return slabAllocatorNew(sizeof(struct EvtBufHdr) + size, alignof(uint64_t), num);
+}
+
+void *osEvtBufSlabAlloc(struct SlabAllocator *slab)
+{
+    struct EvtBufHdr *hdr = slabAllocatorAlloc(slab);
+
+    if (!hdr)
+        return NULL;
+
+    hdr->refs = 1;
+    hdr->slab = slab;
+    return hdr + 1;
+}
+
+void osEvtBufRetain(void *evtData)
+{
+    atomicAdd32bits(&osEvtBufHdr(evtData)->refs, 1);
+}
+
+void osEvtBufRelease(void *evtData)
+{
+    struct EvtBufHdr *hdr = osEvtBufHdr(evtData);
+
+    // old value is returned, so 1 means we dropped the last reference
+    if (atomicAdd32bits(&hdr->refs, -1) != 1)
+        return;
+
+    if (hdr->slab)
+        slabAllocatorFree(hdr->slab, hdr);
+    else
+        heapFree(hdr);
+}
+
+static bool osEvtIsSharedBuf(TaggedPtr evtFreeingInfo)
+{
+    return taggedPtrIsPtr(evtFreeingInfo) && taggedPtrToPtr(evtFreeingInfo) == (void*)osEvtBufRelease;
+}
+
 bool osRetainCurrentEvent(TaggedPtr *evtFreeingInfoP)
 {
     if (!mCurEvtEventFreeingInfo)
         return false;
 
     *evtFreeingInfoP = *mCurEvtEventFreeingInfo;
-    mCurEvtEventFreeingInfo = NULL;
+
+    if (osEvtIsSharedBuf(*evtFreeingInfoP) && mCurEvtSharedBuf) {
+        // shared buffer: every subscriber may keep its own reference; the dispatcher keeps the original one
+        osEvtBufRetain(mCurEvtSharedBuf);
+        osTaskAddIoCount(mCurEvtSrcTask, 1);
+    } else {
+        mCurEvtEventFreeingInfo = NULL;
+    }
     return true;
 }
 
@@ -1075,28 +1425,33 @@ void osMainInit(void)
     (void)osEnqueueEvt(EVT_APP_START, NULL, NULL);
 }
 
-void osMainDequeueLoop(void)
+static void osDispatchEvt(uint32_t evtType, void *evtData, TaggedPtr evtFreeingInfo, uint32_t enqTime)
 {
-    TaggedPtr evtFreeingInfo;
-    uint32_t evtType, j;
-    void *evtData;
+    uint32_t j, w;
     struct Task *task;
+    struct EvtSubIndexEntry *entry;
     uint16_t tid, evt;
 
-    /* get an event */
-    if (!evtQueueDequeue(mEvtsInternal, &evtType, &evtData, &evtFreeingInfo, true))
-        return;
-
     /* by default we free them when we're done with them */
     mCurEvtEventFreeingInfo = &evtFreeingInfo;
     tid = EVENT_GET_ORIGIN(evtType);
     evt = EVENT_GET_EVENT(evtType);
 
+    /* shared buffers may be retained by any number of subscribers; each retain holds a ref on the source task */
+    mCurEvtSrcTask = NULL;
+    mCurEvtSharedBuf = NULL;
+    if (evtData && osEvtIsSharedBuf(evtFreeingInfo) && (mCurEvtSrcTask = osTaskFindByTid(tid)) != NULL)
+        mCurEvtSharedBuf = evtData;
+#if OS_TASK_PROFILE
+    mCurEvtEnqTime = enqTime;
+    mCurEvtStamped = true;
+#endif
+
     if (evt < EVT_NO_FIRST_USER_EVENT) {
         /* handle deferred actions and other reserved events here */
         osInternalEvtHandle(evtType, evtData);
-    } else {
-        /* send this event to all tasks who want it */
+    } else if (mEvtSubIndex.overflow) {
+        /* index is missing subscriptions, maybe for this very event; scan subscription lists */
         for_each_task(&mTasks, task) {
             for (j = 0; j < task->subbedEvtCount; j++) {
                 if (task->subbedEvents[j] == evt) {
@@ -1105,14 +1460,56 @@ void osMainDequeueLoop(void)
                 }
             }
         }
+    } else if ((entry = osEvtSubIndexFind(evt, NULL)) != NULL) {
+        /* send this event to all tasks who want it; subscribers may leave while we are at it */
+        for (w = 0; w < TASK_BITMAP_WORDS; w++) {
+            uint32_t done = 0, bits;
+
+            while ((bits = entry->tasks[w] & ~done) != 0) {
+                j = __builtin_ctz(bits);
+                done |= 1UL << j;
+                osTaskHandle(osTaskByIdx(w * 32 + j), evt, tid, evtData);
+            }
+        }
     }
 
+#if OS_TASK_PROFILE
+    mCurEvtStamped = false;
+#endif
+
     /* free it */
     if (mCurEvtEventFreeingInfo)
         handleEventFreeing(evtType, evtData, evtFreeingInfo);
 
     /* avoid some possible errors */
     mCurEvtEventFreeingInfo = NULL;
+    mCurEvtSharedBuf = NULL;
+    mCurEvtSrcTask = NULL;
+}
+
+// next event of the current batch; batch may shrink under us (see osRemovePendingEvents)
+static bool osEvtBatchNext(struct EvtQueueItem *item)
+{
+    uint64_t intSta = cpuIntsOff();
+    bool have = mEvtBatchPos < mEvtBatchCnt;
+
+    if (have)
+        *item = mEvtBatch[mEvtBatchPos++];
+    cpuIntsRestore(intSta);
+
+    return have;
+}
+
+void osMainDequeueLoop(void)
+{
+    struct EvtQueueItem item;
+
+    /* get a batch of events; everyone in it is handled before we look at timers or the platform again */
+    mEvtBatchCnt = evtQueueDequeueBatch(mEvtsInternal, mEvtBatch, OS_EVT_BATCH_SZ, true);
+    mEvtBatchPos = 0;
+
+    while (osEvtBatchNext(&item))
+        osDispatchEvt(item.evtType, item.evtData, item.evtFreeData, item.enqTime);
 }
 
 void __attribute__((noreturn)) osMain(void)
@@ -1195,7 +1592,27 @@ bool osEventsUnsubscribe(uint32_t numEvts, ...)
     return ret;
 }
 
-static bool osEnqueueEvtCommon(uint32_t evt, void *evtData, TaggedPtr evtFreeInfo, bool urgent)
+// priority class for events whose sender did not pick one
+static uint32_t osEvtDefaultPrio(uint32_t evt, const void *evtData)
+{
+    const union SeosInternalSlabData *da = evtData;
+
+    switch (evt & EVT_MASK & ~EVENT_TYPE_BIT_DISCARDABLE) {
+    case EVT_APP_TO_HOST:
+    case EVT_APP_FROM_HOST:
+    case EVT_APP_FROM_HOST_CHRE:
+        return EVT_PRIO_HOST_IO;
+    case EVT_PRIVATE_EVT:
+        return (da->privateEvt.evtType & EVT_MASK) == EVT_APP_TIMER ? EVT_PRIO_TIMER : EVT_PRIO_DEFAULT;
+    case EVT_DEBUG_LOG:
+    case EVT_TRACE:
+        return EVT_PRIO_BACKGROUND;
+    default:
+        return EVT_PRIO_DEFAULT;
+    }
+}
+
+static bool osEnqueueEvtCommon(uint32_t evt, void *evtData, TaggedPtr evtFreeInfo, uint32_t prio, bool urgent)
 {
     struct Task *task = osGetCurrentTask();
     uint32_t evtType = EVENT_WITH_ORIGIN(evt, osGetCurrentTid());
@@ -1207,7 +1624,10 @@ static bool osEnqueueEvtCommon(uint32_t evt, void *evtData, TaggedPtr evtFreeInf
         return true;
     }
 
-    if (!evtQueueEnqueue(mEvtsInternal, evtType, evtData, evtFreeInfo, urgent)) {
+    if (prio == OS_EVT_PRIO_AUTO)
+        prio = osEvtDefaultPrio(evt, evtData);
+
+    if (!evtQueueEnqueueEx(mEvtsInternal, evtType, evtData, evtFreeInfo, prio, urgent)) {
         osTaskAddIoCount(task, -1);
         return false;
     }
@@ -1215,14 +1635,40 @@ static bool osEnqueueEvtCommon(uint32_t evt, void *evtData, TaggedPtr evtFreeInf
     return true;
 }
 
+uint32_t osGetEvtDropStats(struct EvtQueueDropStat *stats, uint32_t maxStats, uint32_t *totalP)
+{
+    return evtQueueGetDropStats(mEvtsInternal, stats, maxStats, totalP);
+}
+
 void osRemovePendingEvents(bool (*match)(uint32_t evtType, const void *evtData, void *context), void *context)
 {
+    uint64_t intSta;
+    uint32_t i, j;
+
     evtQueueRemoveAllMatching(mEvtsInternal, match, context);
+
+    // events already taken off the queue, but not yet dispatched, are still pending
+    intSta = cpuIntsOff();
+    for (i = j = mEvtBatchPos; i < mEvtBatchCnt; i++) {
+        struct EvtQueueItem *item = &mEvtBatch[i];
+
+        if (match(item->evtType, item->evtData, context))
+            handleEventFreeing(item->evtType, item->evtData, item->evtFreeData);
+        else
+            mEvtBatch[j++] = *item;
+    }
+    mEvtBatchCnt = j;
+    cpuIntsRestore(intSta);
 }
 
 bool osEnqueueEvt(uint32_t evtType, void *evtData, EventFreeF evtFreeF)
 {
-    return osEnqueueEvtCommon(evtType, evtData, taggedPtrMakeFromPtr(evtFreeF), false);
+    return osEnqueueEvtCommon(evtType, evtData, taggedPtrMakeFromPtr(evtFreeF), OS_EVT_PRIO_AUTO, false);
+}
+
+bool osEnqueueEvtEx(uint32_t evtType, void *evtData, EventFreeF evtFreeF, uint32_t prio)
+{
+    return osEnqueueEvtCommon(evtType, evtData, taggedPtrMakeFromPtr(evtFreeF), prio, false);
 }
 
 bool osEnqueueEvtOrFree(uint32_t evtType, void *evtData, EventFreeF evtFreeF)
@@ -1241,7 +1687,7 @@ bool osEnqueueEvtAsApp(uint32_t evtType, void *evtData, bool freeData)
     if (evtType & EVENT_TYPE_BIT_DISCARDABLE_COMPAT)
         evtType |= EVENT_TYPE_BIT_DISCARDABLE;
 
-    return osEnqueueEvtCommon(evtType, evtData, freeData ? taggedPtrMakeFromUint(osGetCurrentTid()) : taggedPtrMakeFromPtr(NULL), false);
+    return osEnqueueEvtCommon(evtType, evtData, freeData ? taggedPtrMakeFromUint(osGetCurrentTid()) : taggedPtrMakeFromPtr(NULL), OS_EVT_PRIO_AUTO, false);
 }
 
 bool osDefer(OsDeferCbkF callback, void *cookie, bool urgent)
@@ -1253,7 +1699,7 @@ bool osDefer(OsDeferCbkF callback, void *cookie, bool urgent)
     act->deferred.callback = callback;
     act->deferred.cookie = cookie;
 
-    if (osEnqueueEvtCommon(EVT_DEFERRED_CALLBACK, act, taggedPtrMakeFromPtr(osDeferredActionFreeF), urgent))
+    if (osEnqueueEvtCommon(EVT_DEFERRED_CALLBACK, act, taggedPtrMakeFromPtr(osDeferredActionFreeF), OS_EVT_PRIO_AUTO, urgent))
         return true;
 
     slabAllocatorFree(mMiscInternalThingsSlab, act);
@@ -1310,12 +1756,12 @@ bool osEnqueuePrivateEvtAsApp(uint32_t evtType, void *evtData, uint32_t toTid)
 bool osTidById(uint64_t *appId, uint32_t *tid)
 {
     struct Task *task;
+    uint64_t id;
 
-    for_each_task(&mTasks, task) {
-        if (task->app && !memcmp(&task->app->hdr.appId, appId, sizeof(*appId))) {
-            *tid = task->tid;
-            return true;
-        }
+    memcpy(&id, appId, sizeof(id)); // may come straight from a packed host packet
+    if ((task = osTaskFindByAppID(id)) != NULL) {
+        *tid = task->tid;
+        return true;
     }
 
     return false;
@@ -1360,6 +1806,43 @@ bool osAppInfoByIndex(uint32_t appIdx, uint64_t *appId, uint32_t *appVer, uint32
     return false;
 }
 
+bool osGetTaskProfile(uint32_t taskIdx, struct TaskProfile *prof)
+{
+#if OS_TASK_PROFILE
+    struct Task *task;
+    uint32_t i = 0;
+
+    for_each_task(&mTasks, task) {
+        if (i++ != taskIdx)
+            continue;
+
+        prof->appId = task->app->hdr.appId;
+        prof->tid = task->tid;
+        prof->evtCnt = task->prof.evtCnt;
+        prof->runTime = task->prof.runTime;
+        prof->maxRunTime = task->prof.maxRunTime;
+        prof->waitCnt = task->prof.waitCnt;
+        prof->waitTime = task->prof.waitTime;
+        prof->maxWaitTime = task->prof.maxWaitTime;
+        prof->window = platGetTicks() - mTaskProfStart;
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+void osResetTaskProfiles(void)
+{
+#if OS_TASK_PROFILE
+    struct Task *task;
+
+    for_each_task(&mTasks, task)
+        memset(&task->prof, 0, sizeof(task->prof));
+    mTaskProfStart = platGetTicks();
+#endif
+}
+
 void osLogv(char clevel, uint32_t flags, const char *str, va_list vl)
 {
     void *userData = platLogAllocUserData();
@@ -1370,7 +1853,7 @@ void osLogv(char clevel, uint32_t flags, const char *str, va_list vl)
     platLogFlush(userData);
 }
 
-void osLog(enum LogLevel level, const char *str, ...)
+void (osLog)(enum LogLevel level, const char *str, ...)
 {
     va_list vl;
 
@@ -1379,6 +1862,137 @@ void osLog(enum LogLevel level, const char *str, ...)
     va_end(vl);
 }
 
+static uint32_t osLogPutVarint(uint8_t *buf, uint32_t val)
+{
+    uint32_t len = 0;
+
+    while (val >= 0x80) {
+        buf[len++] = val | 0x80;
+        val >>= 7;
+    }
+    buf[len++] = val;
+
+    return len;
+}
+
+static uint32_t osLogPutVarint64(uint8_t *buf, uint64_t val)
+{
+    uint32_t len = 0;
+
+    while (val >= 0x80) {
+        buf[len++] = (uint8_t)val | 0x80;
+        val >>= 7;
+    }
+    buf[len++] = val;
+
+    return len;
+}
+
+#ifdef PLAT_LOG_CHARS
+static void osLogText(const char *str, ...)
+{
+    va_list vl;
+
+    va_start(vl, str);
+    cvprintf(platLogPutcharF, 0, NULL, str, vl);
+    va_end(vl);
+}
+
+// the UART (and whatever else takes chars without a host log buffer) gets the token and the
+// args as text, so the line can still be looked up in os.logdict
+static void osLogTokenizedText(enum LogLevel level, uint32_t token, uint32_t argTypes, va_list vl)
+{
+    uint32_t i, numArgs = argTypes & 0x0F;
+    const char *str;
+    uint64_t bits;
+    double dval;
+
+    osLogText("%c#%08" PRIX32, (char)level, token);
+    for (i = 0; i < numArgs; i++) {
+        switch ((argTypes >> (4 + 2 * i)) & 0x03) {
+        case OS_LOG_ARG_INT:
+            osLogText(" %" PRId32, va_arg(vl, int32_t));
+            break;
+        case OS_LOG_ARG_INT64:
+            osLogText(" %" PRId64, va_arg(vl, int64_t));
+            break;
+        case OS_LOG_ARG_DOUBLE:
+            //cvprintf does not format floats; the raw bits it is
+            dval = va_arg(vl, double);
+            memcpy(&bits, &dval, sizeof(bits));
+            osLogText(" 0x%016" PRIX64, bits);
+            break;
+        default:
+            str = va_arg(vl, const char *);
+            osLogText(" \"%s\"", str ? str : "");
+            break;
+        }
+    }
+    platLogPutcharF(NULL, '\n');
+}
+#endif
+
+void osLogTokenized(enum LogLevel level, uint32_t token, uint32_t argTypes, ...)
+{
+    void *userData = platLogAllocUserData();
+    uint8_t buf[OS_LOG_MAX_STR + 5];
+    uint32_t i, len, numArgs = argTypes & 0x0F;
+    const char *str;
+    int32_t sval;
+    int64_t sval64;
+    double dval;
+    va_list vl;
+
+#ifdef PLAT_LOG_CHARS
+    va_start(vl, argTypes);
+    osLogTokenizedText(level, token, argTypes, vl);
+    va_end(vl);
+#endif
+
+    if (!userData) {
+        platLogFlush(userData);
+        return;
+    }
+
+    buf[0] = level | OS_LOG_TOKENIZED_FLAG;
+    len = 1;
+    len += osLogPutVarint(buf + len, token);
+    len += osLogPutVarint(buf + len, argTypes);
+    if (!platLogPutbytesF(userData, buf, len))
+        numArgs = 0;
+
+    va_start(vl, argTypes);
+    for (i = 0; i < numArgs; i++) {
+        switch ((argTypes >> (4 + 2 * i)) & 0x03) {
+        case OS_LOG_ARG_INT:
+            sval = va_arg(vl, int32_t);
+            len = osLogPutVarint(buf, ((uint32_t)sval << 1) ^ (uint32_t)(sval >> 31));
+            break;
+        case OS_LOG_ARG_INT64:
+            sval64 = va_arg(vl, int64_t);
+            len = osLogPutVarint64(buf, ((uint64_t)sval64 << 1) ^ (uint64_t)(sval64 >> 63));
+            break;
+        case OS_LOG_ARG_DOUBLE:
+            dval = va_arg(vl, double);
+            memcpy(buf, &dval, sizeof(dval));
+            len = sizeof(dval);
+            break;
+        default:
+            str = va_arg(vl, const char *);
+            for (len = 0; str && str[len] && len < OS_LOG_MAX_STR; len++)
+                buf[len + 1] = str[len];
+            buf[0] = len++;
+            break;
+        }
+        // a record that does not fit is cut at an arg boundary; the host shows the rest as missing
+        if (!platLogPutbytesF(userData, buf, len))
+            break;
+    }
+    va_end(vl);
+
+    platLogFlush(userData);
+}
+
 
 
 
@@ -15,21 +15,56 @@
  */
 
 #include <atomicBitset.h>
+#include <atomic.h>
 #include <stdio.h>
 #include <heap.h>
 #include <slab.h>
 
+/*
+ * Free items are kept on a lock-free stack whose links live in the free items themselves.
+ * The head holds a 16-bit item index and a 16-bit counter bumped on every change, so that
+ * a pop racing with pop+push from an interrupt fails its cmpxchg instead of corrupting the list.
+ * The bitset still says which items are in use, for validity checks and slabAllocatorGetNth().
+ */
+
+#define SLAB_IDX_NONE   0xFFFF
+#define SLAB_IDX_MASK   0xFFFF
+#define SLAB_TAG_INC    0x10000
+
 struct SlabAllocator {
 
     uint32_t itemSz;
     uint8_t *dataChunks;
+    volatile uint32_t freeHead; /* (tag << 16) | item index */
     struct AtomicBitset bitset[0];
 };
 
+struct SlabCacheClass {
+    struct SlabAllocator *slab;
+    uint32_t itemSz;
+};
+
+struct SlabCache {
+    uint32_t numClasses;
+    struct SlabCacheClass classes[];
+};
+
+static inline uint32_t *slabItemLink(struct SlabAllocator *allocator, uint32_t idx)
+{
+    return (uint32_t*)(allocator->dataChunks + allocator->itemSz * idx);
+}
+
 struct SlabAllocator* slabAllocatorNew(uint32_t itemSz, uint32_t itemAlign, uint32_t numItems)
 {
     struct SlabAllocator *allocator;
-    uint32_t bitsetSz, dataSz;
+    uint32_t bitsetSz, dataSz, i;
+
+    if (numItems >= SLAB_IDX_NONE)
+        return NULL;
+
+    /* free items hold a link */
+    if (itemAlign < sizeof(uint32_t))
+        itemAlign = sizeof(uint32_t);
 
     /* calcualte size */
     bitsetSz = ATOMIC_BITSET_SZ(numItems);
@@ -44,6 +79,9 @@ struct SlabAllocator* slabAllocatorNew(uint32_t itemSz, uint32_t itemAlign, uint
         allocator->itemSz = itemSz;
         allocator->dataChunks = ((uint8_t*)allocator->bitset) + bitsetSz;
         atomicBitsetInit(allocator->bitset, numItems);
+        for (i = 0; i < numItems; i++)
+            *slabItemLink(allocator, i) = i + 1 < numItems ? i + 1 : SLAB_IDX_NONE;
+        allocator->freeHead = numItems ? 0 : SLAB_IDX_NONE;
     }
 
     return allocator;
@@ -56,10 +94,18 @@ void slabAllocatorDestroy(struct SlabAllocator *allocator)
 
 void* slabAllocatorAlloc(struct SlabAllocator *allocator)
 {
-    int32_t itemIdx = atomicBitsetFindClearAndSet(allocator->bitset);
+    uint32_t old, new, itemIdx;
 
-    if (itemIdx < 0)
-        return NULL;
+    do {
+        old = allocator->freeHead;
+        itemIdx = old & SLAB_IDX_MASK;
+        if (itemIdx == SLAB_IDX_NONE)
+            return NULL;
+        /* if someone took this item meanwhile, the link may be junk, but then the tag changed too */
+        new = ((old + SLAB_TAG_INC) &~ SLAB_IDX_MASK) | (*slabItemLink(allocator, itemIdx) & SLAB_IDX_MASK);
+    } while (!atomicCmpXchg32bits(&allocator->freeHead, old, new));
+
+    atomicBitsetSetBit(allocator->bitset, itemIdx);
 
     return allocator->dataChunks + allocator->itemSz * itemIdx;
 }
@@ -69,12 +115,19 @@ void slabAllocatorFree(struct SlabAllocator *allocator, void* ptrP)
     uint8_t *ptr = (uint8_t*)ptrP;
     uint32_t itemOffset = ptr - allocator->dataChunks;
     uint32_t itemIdx = itemOffset / allocator->itemSz;
+    uint32_t old, new;
 
     //check for invalid inputs
     if ((itemOffset % allocator->itemSz) || (itemIdx >= atomicBitsetGetNumBits(allocator->bitset)) || !atomicBitsetGetBit(allocator->bitset, itemIdx))
         return;
 
     atomicBitsetClearBit(allocator->bitset, itemIdx);
+
+    do {
+        old = allocator->freeHead;
+        *slabItemLink(allocator, itemIdx) = old & SLAB_IDX_MASK;
+        new = ((old + SLAB_TAG_INC) &~ SLAB_IDX_MASK) | itemIdx;
+    } while (!atomicCmpXchg32bits(&allocator->freeHead, old, new));
 }
 
 void* slabAllocatorGetNth(struct SlabAllocator *allocator, uint32_t idx)
@@ -102,4 +155,63 @@ uint32_t slabAllocatorGetNumItems(struct SlabAllocator *allocator)
     return atomicBitsetGetNumBits(allocator->bitset);
 }
 
+struct SlabCache* slabCacheNew(const uint32_t *itemSzs, const uint32_t *numItems, uint32_t numClasses, uint32_t itemAlign)
+{
+    struct SlabCache *cache;
+    uint32_t i;
+
+    cache = (struct SlabCache*)heapAlloc(sizeof(struct SlabCache) + sizeof(struct SlabCacheClass) * numClasses);
+    if (!cache)
+        return NULL;
 
+    cache->numClasses = numClasses;
+    for (i = 0; i < numClasses; i++) {
+        cache->classes[i].itemSz = itemSzs[i];
+        cache->classes[i].slab = slabAllocatorNew(itemSzs[i], itemAlign, numItems[i]);
+        if (!cache->classes[i].slab) {
+            cache->numClasses = i;
+            slabCacheDestroy(cache);
+            return NULL;
+        }
+    }
+
+    return cache;
+}
+
+void slabCacheDestroy(struct SlabCache *cache)
+{
+    uint32_t i;
+
+    if (!cache)
+        return;
+
+    for (i = 0; i < cache->numClasses; i++)
+        slabAllocatorDestroy(cache->classes[i].slab);
+    heapFree(cache);
+}
+
+void* slabCacheAlloc(struct SlabCache *cache, uint32_t sz)
+{
+    uint32_t i;
+    void *ret;
+
+    // smallest class that fits; bigger ones if that one ran out
+    for (i = 0; i < cache->numClasses; i++) {
+        if (cache->classes[i].itemSz >= sz && (ret = slabAllocatorAlloc(cache->classes[i].slab)))
+            return ret;
+    }
+
+    return NULL;
+}
+
+void slabCacheFree(struct SlabCache *cache, void *ptr)
+{
+    uint32_t i;
+
+    for (i = 0; i < cache->numClasses; i++) {
+        if (slabAllocatorGetIndex(cache->classes[i].slab, ptr) != (uint32_t)-1) {
+            slabAllocatorFree(cache->classes[i].slab, ptr);
+            return;
+        }
+    }
+}
@@ -22,6 +22,7 @@
 #include <spi.h>
 #include <spi_priv.h>
 #include <timer.h>
+#include <trace.h>
 
 #define INFO_PRINT(fmt, ...) do { \
         osLog(LOG_INFO, "%s " fmt, "[spi]", ##__VA_ARGS__); \
@@ -157,6 +158,7 @@ static void spiMasterDone(struct SpiDeviceState *state, int err)
     void *cookie = state->rxTxCookie;
 
     uint16_t oldTid = osSetCurrentTid(state->tid);
+    trace(TRACE_SPI_DONE, &state->dev, err);
     callback(cookie, err);
     osSetCurrentTid(oldTid);
 }
@@ -324,6 +326,8 @@ int spiMasterRxTx(struct SpiDevice *dev, spi_cs_t cs,
     if (!n)
         return -EINVAL;
 
+    trace(TRACE_SPI_START, dev, n);
+
     ret = spiSetupRxTx(state, packets, n, callback, cookie);
     if (ret < 0)
         return ret;
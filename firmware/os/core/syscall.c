@@ -16,8 +16,26 @@
 
 #include <syscall.h>
 #include <stdio.h>
+#include <cpu.h>
+#include <cpu/barrier.h>
 
+/*
+ * Resolved handler cache: open-addressed, keyed by full syscall path. Slots are filled
+ * once (with interrupts off) and never reused, so a reader that sees "used" set also
+ * sees the final path. Handlers in filled slots are refreshed whenever tables change.
+ */
+#define SYSCALL_CACHE_BITS        6
+#define SYSCALL_CACHE_SZ          (1 << SYSCALL_CACHE_BITS)
+#define SYSCALL_CACHE_PROBES      4
+
+struct SyscallCacheEntry {
+    uint32_t path;
+    SyscallFunc func;
+    SyscallFastFunc fastFunc;
+    volatile bool used;
+};
 
+static struct SyscallCacheEntry mCache[SYSCALL_CACHE_SZ];
 
 static uint32_t mTableStore[(sizeof(struct SyscallTable) + sizeof(union SyscallTableEntry[1 << SYSCALL_BITS_LEVEL_0]) + sizeof(uint32_t) - 1) / sizeof(uint32_t)];
 static const uint8_t mLevelBits[] = {SYSCALL_BITS_LEVEL_0, SYSCALL_BITS_LEVEL_1, SYSCALL_BITS_LEVEL_2, SYSCALL_BITS_LEVEL_3, 0};
@@ -25,6 +43,79 @@ static struct SyscallTable *mTable = (struct SyscallTable*)mTableStore;
 
 
 
+static SyscallFunc* syscallFindHandlerLoc(uint32_t path);
+
+static inline uint32_t syscallCacheHash(uint32_t path)
+{
+    return (uint32_t)(path * 2654435761U) >> (32 - SYSCALL_CACHE_BITS);
+}
+
+static struct SyscallCacheEntry *syscallCacheFind(uint32_t path)
+{
+    uint32_t i, idx = syscallCacheHash(path);
+    struct SyscallCacheEntry *e;
+
+    for (i = 0; i < SYSCALL_CACHE_PROBES; i++, idx = (idx + 1) & (SYSCALL_CACHE_SZ - 1)) {
+        e = mCache + idx;
+        if (!e->used)
+            break; //slots are never freed, so nothing past an empty one
+        mem_reorder_barrier();
+        if (e->path == path)
+            return e;
+    }
+
+    return NULL;
+}
+
+static struct SyscallCacheEntry *syscallCacheAdd(uint32_t path, SyscallFunc func)
+{
+    uint32_t i, idx = syscallCacheHash(path);
+    struct SyscallCacheEntry *e = NULL;
+    uint64_t intSta = cpuIntsOff();
+
+    for (i = 0; i < SYSCALL_CACHE_PROBES; i++, idx = (idx + 1) & (SYSCALL_CACHE_SZ - 1)) {
+        e = mCache + idx;
+        if (!e->used) {
+            e->path = path;
+            e->func = func;
+            e->fastFunc = NULL;
+            mem_reorder_barrier();
+            e->used = true;
+            break;
+        }
+        if (e->path == path)
+            break;
+        e = NULL;
+    }
+    cpuIntsRestore(intSta);
+
+    return e;
+}
+
+//a fast handler stands in for the func it was added with; once that is replaced, calls take the slow path
+static void syscallCacheSetFunc(struct SyscallCacheEntry *e, SyscallFunc func)
+{
+    if (e->func == func)
+        return;
+
+    e->fastFunc = NULL;
+    mem_reorder_barrier();
+    e->func = func;
+}
+
+static void syscallCacheRefresh(void)
+{
+    SyscallFunc *f;
+    uint32_t i;
+
+    for (i = 0; i < SYSCALL_CACHE_SZ; i++) {
+        if (mCache[i].used) {
+            f = syscallFindHandlerLoc(mCache[i].path);
+            syscallCacheSetFunc(mCache + i, f ? *f : NULL);
+        }
+    }
+}
+
 void syscallInit(void)
 {
     mTable->numEntries = 1 << SYSCALL_BITS_LEVEL_0;
@@ -51,6 +142,7 @@ bool syscallAddTable(uint32_t path, uint32_t level, struct SyscallTable *table)
     }
 
     *tabP = table;
+    syscallCacheRefresh();
     return true;
 }
 
@@ -79,19 +171,61 @@ static SyscallFunc* syscallFindHandlerLoc(uint32_t path)
 bool syscallAddFunc(uint32_t path, SyscallFunc func)
 {
     SyscallFunc *f = syscallFindHandlerLoc(path);
+    struct SyscallCacheEntry *e;
 
     if (!f)
         return false;
 
     *f = func;
+    if ((e = syscallCacheFind(path)) != NULL)
+        syscallCacheSetFunc(e, func);
+    return true;
+}
+
+bool syscallAddFastFunc(uint32_t path, SyscallFastFunc func)
+{
+    SyscallFunc *f = syscallFindHandlerLoc(path);
+    struct SyscallCacheEntry *e;
+
+    if (!f || !*f)
+        return false;
+
+    if (!(e = syscallCacheAdd(path, *f)))
+        return false;
+
+    e->fastFunc = func;
     return true;
 }
 
 SyscallFunc syscallGetHandler(uint32_t path)
+{
+    struct SyscallCacheEntry *e = syscallCacheFind(path);
+    SyscallFunc *f;
+
+    if (e)
+        return e->func;
+
+    f = syscallFindHandlerLoc(path);
+    if (!f || !*f)
+        return NULL;
+
+    //only cache what resolves, so bogus calls cannot fill the cache
+    (void)syscallCacheAdd(path, *f);
+    return *f;
+}
+
+SyscallFunc syscallGetHandlerUncached(uint32_t path)
 {
     SyscallFunc *f = syscallFindHandlerLoc(path);
 
     return f ? *f : NULL;
 }
 
+SyscallFastFunc syscallGetFastHandler(uint32_t path)
+{
+    struct SyscallCacheEntry *e = syscallCacheFind(path);
+
+    return e ? e->fastFunc : NULL;
+}
+
 
@@ -18,10 +18,10 @@
 #include <plat/rtc.h>
 #include <atomicBitset.h>
 #include <platform.h>
-#include <atomic.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <timer.h>
+#include <trace.h>
 #include <seos.h>
 #include <cpu.h>
 #include <slab.h>
@@ -31,6 +31,24 @@
 
 #define MAX_INTERNAL_EVENTS       32 //also used for external app timer() calls
 
+#define TIMER_HEAP_NONE           0xFF
+
+#ifndef TIMER_COALESCE
+// delay timers within their jitter/drift tolerance, so that nearby ones share a wakeup
+#define TIMER_COALESCE            1
+#endif
+
+#define TIMER_STATS_WINDOW        1000000000ULL //ns
+
+#if MAX_TIMERS >= TIMER_HEAP_NONE
+#error MAX_TIMERS does not fit in the timer heap index
+#endif
+
+// timer ids are gen * MAX_TIMERS + slot, gen counting the uses of that slot from 1; ids stay
+// clear of 0 and of 0xFFFFFFFF (CHRE_TIMER_INVALID). Past this a slot's gen starts over, so
+// a stale id can only alias a new timer if it was kept across that many uses of its slot
+#define TIMER_GEN_MAX             (UINT32_MAX / MAX_TIMERS - 1)
+
 #define INFO_PRINT(fmt, ...) do { \
         osLog(LOG_INFO, "%s " fmt, "[timer]", ##__VA_ARGS__); \
     } while (0);
@@ -40,10 +58,11 @@
 struct Timer {
     uint64_t      expires; /* time of next expiration */
     uint64_t      period;  /* 0 for oneshot */
-    uint16_t      id;      /* 0 for disabled */
+    uint32_t      id;      /* 0 for disabled */
     uint16_t      tid;     /* we need TID always, for system management */
     uint32_t      jitterPpm;
     uint32_t      driftPpm;
+    uint64_t      slack;   /* how late it may fire, from jitterPpm and driftPpm */
     TaggedPtr     callInfo;
     void         *callData;
 };
@@ -52,7 +71,20 @@ struct Timer {
 ATOMIC_BITSET_DECL(mTimersValid, MAX_TIMERS, static);
 static struct SlabAllocator *mInternalEvents;
 static struct Timer mTimers[MAX_TIMERS];
-static volatile uint32_t mNextTimerId = 0;
+static uint32_t mTimerGen[MAX_TIMERS]; /* slot -> gen of its latest id; see TIMER_GEN_MAX */
+
+// armed timers as a binary min-heap of slot numbers, keyed on expiration time
+static uint8_t mTimerHeap[MAX_TIMERS];
+static uint8_t mTimerHeapPos[MAX_TIMERS]; /* slot -> heap position, or TIMER_HEAP_NONE */
+static uint32_t mTimerHeapCnt;
+
+// error budget of the armed timers, as passed to platSleepClockRequest()
+static uint32_t mMaxJitter, mMaxDrift, mMaxErrTotal;
+static bool mTimerErrDirty; /* a timer left the heap, maxima may be too high */
+
+static struct TimerStats mTimerStats;
+static uint64_t mStatsWindowStart;
+static uint32_t mStatsWindowWakes, mStatsPrevWindowWakes; /* current window, and the one right before it */
 
 uint64_t timGetTime(void)
 {
@@ -61,13 +93,99 @@ uint64_t timGetTime(void)
 
 static struct Timer *timFindTimerById(uint32_t timId) /* no locks taken. be careful what you do with this */
 {
-    uint32_t i;
+    /* timer ids encode their slot, see TIMER_GEN_MAX */
+    struct Timer *tim = mTimers + timId % MAX_TIMERS;
 
-    for (i = 0; i < MAX_TIMERS; i++)
-        if (mTimers[i].id == timId)
-            return mTimers + i;
+    return timId && tim->id == timId ? tim : NULL;
+}
+
+static void timHeapSet(uint32_t pos, uint32_t slot)
+{
+    mTimerHeap[pos] = slot;
+    mTimerHeapPos[slot] = pos;
+}
+
+static void timHeapSiftUp(uint32_t pos)
+{
+    uint32_t slot = mTimerHeap[pos], parent;
+
+    while (pos) {
+        parent = (pos - 1) / 2;
+        if (mTimers[mTimerHeap[parent]].expires <= mTimers[slot].expires)
+            break;
+        timHeapSet(pos, mTimerHeap[parent]);
+        pos = parent;
+    }
+    timHeapSet(pos, slot);
+}
 
-    return NULL;
+static void timHeapSiftDown(uint32_t pos)
+{
+    uint32_t slot = mTimerHeap[pos], child;
+
+    while ((child = 2 * pos + 1) < mTimerHeapCnt) {
+        if (child + 1 < mTimerHeapCnt && mTimers[mTimerHeap[child + 1]].expires < mTimers[mTimerHeap[child]].expires)
+            child++;
+        if (mTimers[slot].expires <= mTimers[mTimerHeap[child]].expires)
+            break;
+        timHeapSet(pos, mTimerHeap[child]);
+        pos = child;
+    }
+    timHeapSet(pos, slot);
+}
+
+static void timHeapInsert(uint32_t slot) /* call with interrupts off */
+{
+    struct Timer *tim = mTimers + slot;
+
+    timHeapSet(mTimerHeapCnt++, slot);
+    timHeapSiftUp(mTimerHeapPos[slot]);
+
+    if (tim->jitterPpm > mMaxJitter)
+        mMaxJitter = tim->jitterPpm;
+    if (tim->driftPpm > mMaxDrift)
+        mMaxDrift = tim->driftPpm;
+    if (tim->driftPpm + tim->jitterPpm > mMaxErrTotal)
+        mMaxErrTotal = tim->driftPpm + tim->jitterPpm;
+}
+
+static void timHeapRemove(uint32_t slot) /* call with interrupts off */
+{
+    uint32_t pos = mTimerHeapPos[slot], last;
+
+    if (pos == TIMER_HEAP_NONE)
+        return;
+
+    mTimerHeapPos[slot] = TIMER_HEAP_NONE;
+    last = mTimerHeap[--mTimerHeapCnt];
+    if (pos != mTimerHeapCnt) {
+        timHeapSet(pos, last);
+        timHeapSiftDown(pos);
+        timHeapSiftUp(mTimerHeapPos[last]);
+    }
+
+    mTimerErrDirty = true;
+}
+
+static void timUpdateErrBudget(void) /* call with interrupts off */
+{
+    struct Timer *tim;
+    uint32_t i;
+
+    if (!mTimerErrDirty)
+        return;
+
+    mMaxJitter = mMaxDrift = mMaxErrTotal = 0;
+    for (i = 0; i < mTimerHeapCnt; i++) {
+        tim = mTimers + mTimerHeap[i];
+        if (tim->jitterPpm > mMaxJitter)
+            mMaxJitter = tim->jitterPpm;
+        if (tim->driftPpm > mMaxDrift)
+            mMaxDrift = tim->driftPpm;
+        if (tim->driftPpm + tim->jitterPpm > mMaxErrTotal)
+            mMaxErrTotal = tim->driftPpm + tim->jitterPpm;
+    }
+    mTimerErrDirty = false;
 }
 
 static void timerCallFuncFreeF(void* event)
@@ -79,10 +197,13 @@ static void timCallFunc(struct Timer *tim)
 {
     struct TimerEvent *evt;
     TaggedPtr callInfo = tim->callInfo;
+    uint32_t id = tim->id;
 
     if (taggedPtrIsPtr(callInfo)) {
         osSetCurrentTid(tim->tid);
-        ((TimTimerCbkF)taggedPtrToPtr(callInfo))(tim->id, tim->callData);
+        trace(TRACE_TIMER_BEGIN, id, tim->callData);
+        ((TimTimerCbkF)taggedPtrToPtr(callInfo))(id, tim->callData);
+        trace(TRACE_TIMER_END, id, 0);
     } else {
         osSetCurrentTid(OS_SYSTEM_TID);
         if ((evt = slabAllocatorAlloc(mInternalEvents)) != 0) {
@@ -98,12 +219,69 @@ static void timCallFunc(struct Timer *tim)
     }
 }
 
+#if TIMER_COALESCE
+// earliest time by which some timer must fire; no timer deeper than one expiring after "best" can do better
+static uint64_t timHeapMinDeadline(uint32_t pos, uint64_t best)
+{
+    struct Timer *tim;
+
+    if (pos >= mTimerHeapCnt)
+        return best;
+
+    tim = mTimers + mTimerHeap[pos];
+    if (tim->expires >= best)
+        return best;
+    if (tim->expires + tim->slack < best)
+        best = tim->expires + tim->slack;
+
+    best = timHeapMinDeadline(2 * pos + 1, best);
+    return timHeapMinDeadline(2 * pos + 2, best);
+}
+#endif
+
+static uint64_t timNextWakeup(void) /* call with interrupts off */
+{
+    struct Timer *tim;
+
+    if (!mTimerHeapCnt)
+        return 0;
+
+    tim = mTimers + mTimerHeap[0];
+#if TIMER_COALESCE
+    // sleep until the first deadline; everything whose window has opened by then fires in the same wakeup
+    return timHeapMinDeadline(1, timHeapMinDeadline(2, tim->expires + tim->slack));
+#else
+    return tim->expires;
+#endif
+}
+
+static void timStatsUpdate(uint32_t fired) /* call with interrupts off */
+{
+    uint64_t now = timGetTime();
+
+    mTimerStats.wakes++;
+    mTimerStats.fired += fired;
+    mTimerStats.coalesced += fired - 1;
+
+    if (now - mStatsWindowStart >= 2 * TIMER_STATS_WINDOW) {
+        // idle for a whole window or more
+        mStatsPrevWindowWakes = 0;
+        mStatsWindowWakes = 0;
+        mStatsWindowStart = now;
+    } else if (now - mStatsWindowStart >= TIMER_STATS_WINDOW) {
+        mStatsPrevWindowWakes = mStatsWindowWakes;
+        mStatsWindowWakes = 0;
+        mStatsWindowStart += TIMER_STATS_WINDOW;
+    }
+    mStatsWindowWakes++;
+}
+
 static bool timFireAsNeededAndUpdateAlarms(void)
 {
-    uint32_t maxDrift = 0, maxJitter = 0, maxErrTotal = 0;
     bool somethingDone, totalSomethingDone = false;
     uint64_t nextTimer;
-    uint32_t i;
+    uint32_t slot, fired = 0;
+    uint32_t timId;
     struct Timer *tim;
 
     // protect from concurrent execution [timIntHandler() and timTimerSetEx()]
@@ -112,43 +290,41 @@ static bool timFireAsNeededAndUpdateAlarms(void)
 
     do {
         somethingDone = false;
-        nextTimer = 0;
-
-        for (i = 0, tim = &mTimers[0]; i < MAX_TIMERS; i++, tim++) {
-            if (!tim->id)
-                continue;
-
-            if (tim->expires <= timGetTime()) {
-                somethingDone = true;
-                if (tim->period) {
-                    tim->expires += tim->period;
-                    timCallFunc(tim);
-                } else {
-                    timCallFunc(tim);
+
+        // callbacks may set or cancel timers, so always look at the heap top afresh
+        while (mTimerHeapCnt && mTimers[mTimerHeap[0]].expires <= timGetTime()) {
+            slot = mTimerHeap[0];
+            tim = mTimers + slot;
+            somethingDone = true;
+            fired++;
+            if (tim->period) {
+                tim->expires += tim->period;
+                timHeapSiftDown(0);
+                timCallFunc(tim);
+            } else {
+                timId = tim->id;
+                timHeapRemove(slot);
+                timCallFunc(tim);
+                if (tim->id == timId) {
                     tim->id = 0;
-                    atomicBitsetClearBit(mTimersValid, i);
+                    atomicBitsetClearBit(mTimersValid, slot);
                 }
             }
-            else {
-                if (tim->jitterPpm > maxJitter)
-                    maxJitter = tim->jitterPpm;
-                if (tim->driftPpm > maxDrift)
-                    maxDrift = tim->driftPpm;
-                if (tim->driftPpm + tim->jitterPpm > maxErrTotal)
-                    maxErrTotal = tim->driftPpm + tim->jitterPpm;
-                if (!nextTimer || nextTimer > tim->expires)
-                    nextTimer = tim->expires;
-            }
         }
 
+        nextTimer = timNextWakeup();
+        timUpdateErrBudget();
         totalSomethingDone = totalSomethingDone || somethingDone;
 
     //we loop while loop does something, or while (if next timer exists), it is due by the time loop ends, or platform code fails to set an alarm to wake us for it
-    } while (somethingDone || (nextTimer && (timGetTime() >= nextTimer || !platSleepClockRequest(nextTimer, maxJitter, maxDrift, maxErrTotal))));
+    } while (somethingDone || (nextTimer && (timGetTime() >= nextTimer || !platSleepClockRequest(nextTimer, mMaxJitter, mMaxDrift, mMaxErrTotal))));
 
     if (!nextTimer)
         platSleepClockRequest(0, 0, 0, 0);
 
+    if (fired)
+        timStatsUpdate(fired);
+
     osSetCurrentTid(oldTid);
     cpuIntsRestore(intSta);
 
@@ -160,17 +336,18 @@ static uint32_t timTimerSetEx(uint64_t length, uint32_t jitterPpm, uint32_t drif
     uint64_t curTime = timGetTime();
     int32_t idx = atomicBitsetFindClearAndSet(mTimersValid);
     struct Timer *t;
-    uint16_t timId;
+    uint32_t gen, timId;
+    uint64_t intSta;
 
     if (idx < 0) /* no free timers */{
         ERROR_PRINT("no free timers\n");
         return 0;
     }
 
-    /* generate next timer ID */
-    do {
-        timId = atomicAdd32bits(&mNextTimerId, 1);
-    } while (!timId || timFindTimerById(timId));
+    /* next timer ID for this slot, ours alone now; it carries the slot number, so it can not collide with a live one */
+    gen = mTimerGen[idx] < TIMER_GEN_MAX ? mTimerGen[idx] + 1 : 1;
+    mTimerGen[idx] = gen;
+    timId = gen * MAX_TIMERS + idx;
 
     /* grab our struct & fill it in */
     t = mTimers + idx;
@@ -178,12 +355,16 @@ static uint32_t timTimerSetEx(uint64_t length, uint32_t jitterPpm, uint32_t drif
     t->period = oneShot ? 0 : length;
     t->jitterPpm = jitterPpm;
     t->driftPpm = driftPpm;
+    t->slack = (length >> 20) * (jitterPpm + driftPpm); /* 2^20 instead of 10^6: cheap and errs on the safe side */
     t->callInfo = info;
     t->callData = data;
 
-    /* as soon as we write timer Id, it becomes valid and might fire */
+    /* as soon as it is in the heap, it becomes valid and might fire */
+    intSta = cpuIntsOff();
     t->id = timId;
     t->tid = osGetCurrentTid();
+    timHeapInsert(idx);
+    cpuIntsRestore(intSta);
 
     /* fire as needed & recalc alarms*/
     timFireAsNeededAndUpdateAlarms();
@@ -229,6 +410,7 @@ bool timTimerCancelEx(uint32_t timerId, bool cancelPending)
     if (t && t->tid == osGetCurrentTid()) {
         if (cancelPending)
             osRemovePendingEvents(timerEventMatch, t);
+        timHeapRemove(t - mTimers);
         t->id = 0; /* this disables it */
     } else {
         t = NULL;
@@ -263,6 +445,7 @@ int timTimerCancelAll(uint32_t tid)
             continue;
         count++;
         osRemovePendingEvents(timerEventMatch, tim);
+        timHeapRemove(i);
         tim->id = 0; /* this disables it */
         /* this frees struct */
         atomicBitsetClearBit(mTimersValid, tim - mTimers);
@@ -271,6 +454,22 @@ int timTimerCancelAll(uint32_t tid)
     return count;
 }
 
+void timGetStats(struct TimerStats *stats)
+{
+    uint64_t intSta = cpuIntsOff();
+    uint64_t elapsed = timGetTime() - mStatsWindowStart;
+
+    *stats = mTimerStats;
+    // windows only roll over on wakeups; without any, the last full one may be long gone
+    if (elapsed < TIMER_STATS_WINDOW)
+        stats->wakesPerSec = mStatsPrevWindowWakes;
+    else if (elapsed < 2 * TIMER_STATS_WINDOW)
+        stats->wakesPerSec = mStatsWindowWakes;
+    else
+        stats->wakesPerSec = 0;
+    cpuIntsRestore(intSta);
+}
+
 bool timIntHandler(void)
 {
     return timFireAsNeededAndUpdateAlarms();
@@ -278,7 +477,11 @@ bool timIntHandler(void)
 
 void timInit(void)
 {
+    uint32_t i;
+
     atomicBitsetInit(mTimersValid, MAX_TIMERS);
+    for (i = 0; i < MAX_TIMERS; i++)
+        mTimerHeapPos[i] = TIMER_HEAP_NONE;
 
     mInternalEvents = slabAllocatorNew(sizeof(struct TimerEvent), alignof(struct TimerEvent), MAX_INTERNAL_EVENTS);
 }
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <cpu.h>
+#include <eventnums.h>
+#include <heap.h>
+#include <hostIntf.h>
+#include <nanohubPacket.h>
+#include <platform.h>
+#include <sensType.h>
+#include <seos.h>
+#include <trace.h>
+
+#if OS_TRACE
+
+#if TRACE_RING_SZ & (TRACE_RING_SZ - 1)
+#error TRACE_RING_SZ must be a power of 2
+#endif
+
+#define TRACE_RECORDS_PER_BLOCK  (sizeof(((struct HostIntfDataBuffer *)0)->buffer) / sizeof(struct TraceRecord))
+
+static struct TraceRecord mTraceRing[TRACE_RING_SZ];
+static uint32_t mTraceHead; /* next record to write */
+static uint32_t mTraceTail; /* next record to drain; head - tail > TRACE_RING_SZ means we lost some */
+static volatile uint32_t mTraceDropped; /* records in blocks dropped after we drained them */
+static volatile bool mTraceOn;
+static volatile bool mTraceFlushPending;
+
+// send what is in the ring now; records made while we do it wait for the next flush
+static void traceFlush(void)
+{
+    struct HostIntfDataBuffer *data;
+    struct TraceRecord *out;
+    uint32_t n, lost, end;
+    uint64_t intSta;
+
+    intSta = cpuIntsOff();
+    end = mTraceHead;
+    cpuIntsRestore(intSta);
+
+    while ((int32_t)(end - mTraceTail) > 0) {
+        if (!(data = heapAlloc(sizeof(*data))))
+            return;
+
+        out = (struct TraceRecord *)data->buffer;
+        n = 0;
+
+        intSta = cpuIntsOff();
+        lost = mTraceHead - mTraceTail > TRACE_RING_SZ ? mTraceHead - mTraceTail - TRACE_RING_SZ : 0;
+        mTraceTail += lost;
+        lost += mTraceDropped;
+        mTraceDropped = 0;
+        if (lost) {
+            out[n].time = platGetTicks() >> 10;
+            out[n].tid = 0;
+            out[n].id = TRACE_LOST;
+            out[n].arg0 = lost;
+            out[n++].arg1 = 0;
+        }
+        while (n < TRACE_RECORDS_PER_BLOCK && (int32_t)(end - mTraceTail) > 0)
+            out[n++] = mTraceRing[mTraceTail++ % TRACE_RING_SZ];
+        cpuIntsRestore(intSta);
+
+        data->sensType = SENS_TYPE_INVALID;
+        data->length = n * sizeof(struct TraceRecord);
+        data->dataType = HOSTINTF_DATA_TYPE_TRACE;
+        data->interrupt = NANOHUB_INT_NONWAKEUP;
+
+        if (!osEnqueueEvtOrFree(EVENT_TYPE_BIT_DISCARDABLE | EVT_TRACE, data, heapFree))
+            return;
+    }
+}
+
+static void traceFlushDeferred(void *cookie)
+{
+    mTraceFlushPending = false;
+    traceFlush();
+}
+
+void traceRecord(uint16_t id, uint32_t arg0, uint32_t arg1)
+{
+    struct TraceRecord *rec;
+    uint64_t intSta;
+    bool flush;
+
+    if (!mTraceOn)
+        return;
+
+    intSta = cpuIntsOff();
+    rec = &mTraceRing[mTraceHead++ % TRACE_RING_SZ];
+    rec->time = platGetTicks() >> 10;
+    rec->tid = osGetCurrentTid();
+    rec->id = id;
+    rec->arg0 = arg0;
+    rec->arg1 = arg1;
+    flush = !mTraceFlushPending && mTraceHead - mTraceTail >= TRACE_RECORDS_PER_BLOCK;
+    if (flush)
+        mTraceFlushPending = true;
+    cpuIntsRestore(intSta);
+
+    // this enqueues an event, which is traced too; the pending flag stops us from recursing
+    if (flush && !osDefer(traceFlushDeferred, NULL, false))
+        mTraceFlushPending = false;
+}
+
+bool traceEnable(bool on)
+{
+    uint64_t intSta;
+
+    if (on && !mTraceOn) {
+        // start a fresh timeline
+        intSta = cpuIntsOff();
+        mTraceTail = mTraceHead;
+        cpuIntsRestore(intSta);
+    }
+
+    mTraceOn = on;
+
+    if (!on)
+        traceFlush();
+
+    return true;
+}
+
+bool traceIsEnabled(void)
+{
+    return mTraceOn;
+}
+
+void traceDropped(const struct TraceRecord *recs, uint32_t num)
+{
+    uint32_t i, lost = 0;
+    uint64_t intSta;
+
+    // a lost marker stands for the records it counts, not for itself
+    for (i = 0; i < num; i++)
+        lost += recs[i].id == TRACE_LOST ? recs[i].arg0 : 1;
+
+    intSta = cpuIntsOff();
+    mTraceDropped += lost;
+    cpuIntsRestore(intSta);
+}
+
+#else
+
+void traceRecord(uint16_t id, uint32_t arg0, uint32_t arg1)
+{
+}
+
+bool traceEnable(bool on)
+{
+    return false;
+}
+
+bool traceIsEnabled(void)
+{
+    return false;
+}
+
+void traceDropped(const struct TraceRecord *recs, uint32_t num)
+{
+}
+
+#endif
@@ -242,12 +242,15 @@ static void __attribute__((used)) syscallHandler(uintptr_t *excRegs)
     uint32_t svcNo = (*svcPC) & 0xFF;
     uint32_t syscallNr = excRegs[0];
     SyscallFunc handler;
+    SyscallFastFunc fastHandler;
     va_list args_long = *(va_list*)(excRegs + 1);
     uintptr_t *fastParams = excRegs + 1;
     va_list args_fast = *(va_list*)(&fastParams);
 
     if (svcNo > 1)
         osLog(LOG_WARN, "Unknown SVC 0x%02lX called at 0x%08lX\n", svcNo, (unsigned long)svcPC);
+    else if (svcNo && (fastHandler = syscallGetFastHandler(syscallNr)))
+        fastHandler(excRegs, fastParams);
     else if (!(handler = syscallGetHandler(syscallNr)))
         osLog(LOG_WARN, "Unknown syscall 0x%08lX called at 0x%08lX\n", (unsigned long)syscallNr, (unsigned long)svcPC);
     else
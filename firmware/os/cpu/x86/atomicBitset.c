@@ -58,6 +58,22 @@ void atomicBitsetClearBit(struct AtomicBitset *set, uint32_t num)
     } while (!atomicCmpXchg32bits(wordPtr, old, new));
 }
 
+void atomicBitsetSetBit(struct AtomicBitset *set, uint32_t num)
+{
+    uint32_t idx = num / 32, mask = 1UL << (num & 31);
+    uint32_t *wordPtr = set->words + idx;
+    uint32_t old, new;
+
+    if (num >= set->numBits)
+        return;
+
+
+    do {
+        old = *wordPtr;
+        new = old | mask;
+    } while (!atomicCmpXchg32bits(wordPtr, old, new));
+}
+
 int32_t atomicBitsetFindClearAndSet(struct AtomicBitset *set)
 {
     uint32_t pos, i, numWords = (set->numBits + 31) / 32;
@@ -79,7 +95,20 @@ int32_t atomicBitsetFindClearAndSet(struct AtomicBitset *set)
         }
     }
 
-    return false;
+    return -1;
+}
+
+bool atomicBitsetBulkRead(struct AtomicBitset *set, uint32_t *dest, uint32_t numBits)
+{
+    uint32_t idx, numWords = ATOMIC_BITSET_NUM_WORDS(set->numBits);
+
+    if (set->numBits != numBits)
+        return false;
+
+    for (idx = 0; idx < numWords; idx++)
+        dest[idx] = atomicRead32bits(&set->words[idx]);
+
+    return true;
 }
 
 
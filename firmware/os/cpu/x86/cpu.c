@@ -14,31 +14,127 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
+#include <pthread.h>
+#include <cpu/irq.h>
 #include <cpu.h>
 
+#define APP_FUNC(_app, _name, _type) ((_type)(uintptr_t)(_app)->vec._name)
+
+static pthread_mutex_t mIntLock = PTHREAD_MUTEX_INITIALIZER; /* held while interrupts are off */
+static pthread_cond_t mIrqCond = PTHREAD_COND_INITIALIZER;
+static bool mIrqPending;
+static __thread uint32_t mIntsOffDepth; /* per thread, so handler threads nest on their own */
+static uint64_t mPersistentBits;
 
 void cpuInit(void)
 {
     /* nothing to do for x86 */
 }
 
+void cpuInitLate(void)
+{
+    /* no dropbox to report; nothing survives a host process */
+}
+
+bool cpuRamPersistentBitGet(uint32_t which)
+{
+    return (which < CPU_NUM_PERSISTENT_RAM_BITS) && ((mPersistentBits >> which) & 1);
+}
+
+void cpuRamPersistentBitSet(uint32_t which, bool on)
+{
+    if (which < CPU_NUM_PERSISTENT_RAM_BITS) {
+        if (on)
+            mPersistentBits |= (1ULL << which);
+        else
+            mPersistentBits &=~ (1ULL << which);
+    }
+}
+
+/* the state is how deep into cpuIntsOff() this thread was; 0 means interrupts were on */
 uint64_t cpuIntsOff(void)
 {
-    /* no such luck */
+    uint32_t depth = mIntsOffDepth;
+
+    if (!mIntsOffDepth++)
+        pthread_mutex_lock(&mIntLock);
 
-    return 0;
+    return depth;
 }
 
 uint64_t cpuIntsOn(void)
 {
-    /* no such luck */
+    uint64_t state = mIntsOffDepth;
 
-    return 0;
+    cpuIntsRestore(0);
+
+    return state;
 }
 
 void cpuIntsRestore(uint64_t state)
 {
-    /* no such luck */
+    if (state && !mIntsOffDepth)
+        pthread_mutex_lock(&mIntLock);
+    else if (!state && mIntsOffDepth)
+        pthread_mutex_unlock(&mIntLock);
+
+    mIntsOffDepth = state;
+}
+
+void cpuIrqRaise(void)
+{
+    uint64_t intSta = cpuIntsOff();
+
+    mIrqPending = true;
+    pthread_cond_signal(&mIrqCond);
+
+    cpuIntsRestore(intSta);
+}
+
+void cpuIrqWait(void)
+{
+    /* interrupts are off, so we hold mIntLock exactly once, however deep we are */
+    while (!mIrqPending)
+        pthread_cond_wait(&mIrqCond, &mIntLock);
 
+    mIrqPending = false;
 }
 
+/* only internal apps here: their vectors are plain function pointers (the image is linked below 4GB) */
+bool cpuInternalAppLoad(const struct AppHdr *appHdr, struct PlatAppInfo *platInfo)
+{
+    return true;
+}
+
+bool cpuAppLoad(const struct AppHdr *appHdr, struct PlatAppInfo *platInfo)
+{
+    /* external apps are relocatable ARM images; we cannot run those */
+    return false;
+}
+
+void cpuAppUnload(const struct AppHdr *appHdr, struct PlatAppInfo *platInfo)
+{
+}
+
+bool cpuAppInit(const struct AppHdr *app, struct PlatAppInfo *platInfo, uint32_t tid)
+{
+    return APP_FUNC(app, init, bool (*)(uint32_t))(tid);
+}
+
+void cpuAppEnd(const struct AppHdr *app, struct PlatAppInfo *platInfo)
+{
+    APP_FUNC(app, end, void (*)(void))();
+    osLog(LOG_INFO, "App ID %016" PRIX64 "; TID=%04" PRIX32 " terminated\n", app->hdr.appId, osGetCurrentTid());
+}
+
+void cpuAppHandle(const struct AppHdr *app, struct PlatAppInfo *platInfo, uint32_t evtType, const void* evtData)
+{
+    APP_FUNC(app, handle, void (*)(uint32_t, const void *))(evtType, evtData);
+}
+
+void cpuAppInvoke(const struct AppHdr *app, struct PlatAppInfo *platInfo,
+                  void (*method)(uintptr_t, uintptr_t), uintptr_t arg1, uintptr_t arg2)
+{
+    method(arg1, arg2);
+}
@@ -25,6 +25,7 @@ struct AtomicBitset {
     uint32_t words[];
 };
 
+#define ATOMIC_BITSET_NUM_WORDS(numbits) (((numbits) + 31) / 32)
 #define ATOMIC_BITSET_SZ(numbits)	(sizeof(struct AtomicBitset) + ((numbits) + 31) / 8)
 #define ATOMIC_BITSET_DECL(nam, numbits, extra_keyword)    extra_keyword uint8_t _##nam##_store [ATOMIC_BITSET_SZ(numbits)] __attribute__((aligned(4))); extra_keyword struct AtomicBitset *nam = (struct AtomicBitset*)_##nam##_store
 
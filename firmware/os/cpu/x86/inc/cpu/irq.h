@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _X86_IRQ_H_
+#define _X86_IRQ_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * On a host there are no interrupts; host threads stand in for them. Such a thread runs
+ * its "handler" between cpuIntsOff() and cpuIntsRestore(), so interrupts being off means
+ * holding one global lock, and handlers and critical sections on the OS thread exclude
+ * each other just like they would on the real thing.
+ */
+
+/* mark an interrupt pending and wake the OS thread if it is in cpuIrqWait() */
+void cpuIrqRaise(void);
+
+/* WFI: called with interrupts off; returns once an interrupt is pending (consuming it) */
+void cpuIrqWait(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
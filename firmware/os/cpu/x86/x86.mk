@@ -18,9 +18,10 @@ GCC = gcc
 OBJCOPY = objcopy
 
 FLAGS += -march=core2 -msse2 -DSYSCALL_VARARGS_PARAMS_PASSED_AS_PTRS
+FLAGS += -DCPU_NUM_PERSISTENT_RAM_BITS=32
 
 #cpu runtime
-SRCS += \
+SRCS_os += \
     os/cpu/$(CPU)/atomicBitset.c \
     os/cpu/$(CPU)/cpu.c \
     os/cpu/$(CPU)/atomic.c \
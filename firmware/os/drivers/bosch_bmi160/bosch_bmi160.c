@@ -797,13 +797,6 @@ static void minimize_sensortime_history(void) {
     time_sync_hold(&mTask.gSensorTime2RTC, 2);
 }
 
-static void dataEvtFree(void *ptr)
-{
-    TDECL();
-    struct TripleAxisDataEvent *ev = (struct TripleAxisDataEvent *)ptr;
-    slabAllocatorFree(T(mDataSlab), ev);
-}
-
 static void spiQueueWrite(uint8_t addr, uint8_t data, uint32_t delay)
 {
     TDECL();
@@ -1147,7 +1140,8 @@ static bool flushData(struct BMI160Sensor *sensor, uint32_t eventId)
     bool success = false;
 
     if (sensor->data_evt) {
-        success = osEnqueueEvtOrFree(eventId, sensor->data_evt, dataEvtFree);
+        // shared buffer: fusion, tilt, etc. may all keep the batch without copying it
+        success = osEnqueueEvtOrFree(eventId, sensor->data_evt, osEvtBufRelease);
         sensor->data_evt = NULL;
     }
 
@@ -1166,10 +1160,10 @@ static void flushAllData(void)
 static bool allocateDataEvt(struct BMI160Sensor *mSensor, uint64_t rtc_time)
 {
     TDECL();
-    mSensor->data_evt = slabAllocatorAlloc(T(mDataSlab));
+    mSensor->data_evt = osEvtBufSlabAlloc(T(mDataSlab));
     if (mSensor->data_evt == NULL) {
         // slab allocation failed
-        ERROR_PRINT("slabAllocatorAlloc() failed\n");
+        ERROR_PRINT("osEvtBufSlabAlloc() failed\n");
         return false;
     }
 
@@ -3920,9 +3914,9 @@ static bool startTask(uint32_t task_id)
     // the fifo size is 1K.
     // 20 slabs because some slabs may only hold 1-2 samples.
     // XXX: this consumes too much memeory, need to optimize
-    T(mDataSlab) = slabAllocatorNew(slabSize, 4, 20);
+    T(mDataSlab) = osEvtBufSlabNew(slabSize, 20);
     if (!T(mDataSlab)) {
-        INFO_PRINT("slabAllocatorNew() failed\n");
+        INFO_PRINT("osEvtBufSlabNew() failed\n");
         return false;
     }
     T(mWbufCnt) = 0;
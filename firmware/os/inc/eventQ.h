@@ -26,16 +26,53 @@
 #define EVENT_TYPE_BIT_DISCARDABLE_COMPAT    0x80000000 /* some external apps are using this one */
 #define EVENT_TYPE_BIT_DISCARDABLE               0x8000 /* set for events we can afford to lose */
 
+#define EVT_QUEUE_FL_LOCKLESS                0x00000001 /* lock-free enqueue; "atFront" events go to a separate urgent lane */
+#define EVT_QUEUE_FL_EVICT_OLDEST            0x00000002 /* when full, drop the oldest discardable event; default is the oldest one of the lowest priority class */
+#define EVT_QUEUE_FL_TIMESTAMP               0x00000004 /* stamp events with their enqueue time; see EvtQueueItem.enqTime */
+
+/*
+ * Priority classes; lower value is served first. A class may be given a quota with
+ * evtQueueSetPrioQuota(): after serving that many events in a row while lower classes
+ * wait, it yields one turn to the highest waiting lower class. "atFront" events
+ * are always served before any class. Order is kept within a class only: an event
+ * may overtake an earlier one of a lower class, even from the same sender.
+ */
+#define EVT_PRIO_HOST_IO                     0 /* host interface requests and replies */
+#define EVT_PRIO_TIMER                       1 /* timer callbacks */
+#define EVT_PRIO_SENSOR                      2 /* sensor data and everything not classified otherwise */
+#define EVT_PRIO_BACKGROUND                  3 /* logs and other deferrable work */
+#define EVT_PRIO_NUM                         4
+#define EVT_PRIO_DEFAULT                     EVT_PRIO_SENSOR
+
 struct EvtQueue;
 
+struct EvtQueueItem {
+    uint32_t evtType;
+    void *evtData;
+    TaggedPtr evtFreeData;
+    uint32_t enqTime; /* platGetTicks() >> 10 at enqueue (~us, wraps); 0 unless EVT_QUEUE_FL_TIMESTAMP */
+};
+
+struct EvtQueueDropStat {
+    uint32_t evtType; /* as enqueued, origin included */
+    uint32_t count;
+};
+
 typedef void (*EvtQueueForciblyDiscardEvtCbkF)(uint32_t evtType, void *evtData, TaggedPtr evtFreeData);
 
 //multi-producer, SINGLE consumer queue
 
 struct EvtQueue* evtQueueAlloc(uint32_t size, EvtQueueForciblyDiscardEvtCbkF forceDiscardCbk);
+struct EvtQueue* evtQueueAllocEx(uint32_t size, EvtQueueForciblyDiscardEvtCbkF forceDiscardCbk, uint32_t flags,
+                                 const uint16_t *prioSizes); /* lockless: cells per class lane, by EVT_PRIO_*; 0 or NULL means size */
 void evtQueueFree(struct EvtQueue* q);
+void evtQueueSetPrioQuota(struct EvtQueue* q, uint32_t prio, uint32_t quota); /* quota of 0 means strict priority (the default) */
 bool evtQueueEnqueue(struct EvtQueue* q, uint32_t evtType, void *evtData, TaggedPtr evtFreeData, bool atFront /* do not set this unless you know the repercussions. read: never set this in new code */);
+bool evtQueueEnqueueEx(struct EvtQueue* q, uint32_t evtType, void *evtData, TaggedPtr evtFreeData, uint32_t prio, bool atFront);
 bool evtQueueDequeue(struct EvtQueue* q, uint32_t *evtTypeP, void **evtDataP, TaggedPtr *evtFreeDataP, bool sleepIfNone);
+uint32_t evtQueueDequeueBatch(struct EvtQueue* q, struct EvtQueueItem *items, uint32_t maxItems, bool sleepIfNone); /* -> number of items taken; they are no longer in the queue */
+bool evtQueueSetTypeQuota(struct EvtQueue* q, uint32_t evtType, uint32_t maxQueued); /* limits queued discardable events of this event number, whatever the origin; set before use */
+uint32_t evtQueueGetDropStats(struct EvtQueue* q, struct EvtQueueDropStat *stats, uint32_t maxStats, uint32_t *totalP); /* -> number of stats filled in; total counts types that did not fit too */
 void evtQueueRemoveAllMatching(struct EvtQueue* q,  bool (*match)(uint32_t evtType, const void *data, void *context), void *context);
 
 #endif
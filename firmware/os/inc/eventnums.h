@@ -31,9 +31,11 @@
 #define EVT_RESET_REASON                 0x00000403    //reset reason to host.
 #define EVT_APP_TO_SENSOR_HAL_DATA       0x00000404    // sensor driver out of band data update to sensor hal
 #define EVT_DEBUG_LOG                    0x00007F01    // send message payload to Linux kernel log
+#define EVT_TRACE                        0x00007F02    // block of trace records for the host. Type is struct HostIntfDataBuffer
 #define EVT_MASK                         0x0000FFFF
 
 // host-side events are 32-bit
+#define EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT 0x00010200 //same as EVT_NO_FIRST_SENSOR_EVENT + SENSOR_TYPE_x, for blocks in the compressed format (see hostIntf.c)
 
 // DEBUG_LOG_EVT is normally undefined, or defined with a special value, recognized by nanohub driver: 0x3B474F4C
 // if defined with this value, the log message payload will appear in Linux kernel message log.
@@ -43,6 +45,13 @@
 #define HOST_EVT_DEBUG_LOG               DEBUG_LOG_EVT
 #endif
 
+// payload is an array of struct TraceRecord (see trace.h)
+#define HOST_EVT_TRACE                   0x45435254    // "TRCE"
+
+// from the nanohub driver: the events of a NANOHUB_REASON_READ_EVENTS run in one message, each
+// preceded by its length byte; at most 4 + NANOHUB_READ_EVENTS_MAX bytes in all
+#define HOST_EVT_BULK                    0x4B4C5542    // "BULK"
+
 #define HOST_HUB_RAW_PACKET_MAX_LEN      128
 
 SET_PACKED_STRUCT_MODE_ON
@@ -25,12 +25,27 @@ extern "C" {
 #include <stdbool.h>
 
 
-
+struct HeapStats {
+    uint32_t totalBytes;  /* chunk headers not included */
+    uint32_t freeBytes;
+    uint32_t largestFree; /* largest single allocation that can succeed */
+    uint32_t freeChunks;
+    uint32_t usedChunks;
+};
+
+struct HeapTaskStats {
+    uint32_t curBytes;
+    uint32_t peakBytes;
+    uint32_t allocs;
+    uint32_t failed;
+};
 
 bool heapInit(void);
 void* heapAlloc(uint32_t sz);
 void heapFree(void* ptr);
 int heapFreeAll(uint32_t tid);
+bool heapGetStats(struct HeapStats *stats); /* false if heap is busy */
+bool heapGetTaskStats(uint32_t tid, struct HeapTaskStats *stats); /* false if tid never used the heap */
 
 
 #ifdef __cplusplus
@@ -29,12 +29,21 @@
 #define HOSTINTF_MAX_INTERRUPTS     256
 #define HOSTINTF_SENSOR_DATA_MAX    240
 
+#ifndef HOSTINTF_READ_EVENTS_MAX
+// longest READ_EVENTS reply; replies are built in the tx buffer, which then grows to this size.
+// 0 leaves READ_EVENTS out and the tx buffer at one packet. Variants that want bulk reads set it
+// to at least one full packet plus the empty one that ends the run
+#define HOSTINTF_READ_EVENTS_MAX    0
+#endif
+
 enum HostIntfDataType
 {
     HOSTINTF_DATA_TYPE_LOG,
     HOSTINTF_DATA_TYPE_APP_TO_HOST,
     HOSTINTF_DATA_TYPE_RESET_REASON,
     HOSTINTF_DATA_TYPE_APP_TO_SENSOR_HAL,         // for config data upload
+    HOSTINTF_DATA_TYPE_TRACE,
+    HOSTINTF_DATA_TYPE_COMPRESSED_SENSOR,         // sensor buffer holding compressed samples (see hostIntf.c)
 };
 
 SET_PACKED_STRUCT_MODE_ON
@@ -69,6 +78,14 @@ struct HostIntfDataBuffer
 } ATTRIBUTE_PACKED;
 SET_PACKED_STRUCT_MODE_OFF
 
+struct HostIntfWakeupStats
+{
+    uint32_t apWakeups;         // times the AP wakeup line went up since boot
+    uint32_t apWakeupsLastHour; // the same, during the last whole hour
+    uint32_t batchWindows;      // batch windows opened by a due batching deadline
+    uint32_t batchFlushes;      // sensor flushes issued by those windows
+};
+
 void hostIntfCopyInterrupts(void *dst, uint32_t numBits);
 void hostIntfClearInterrupts();
 void hostIntfSetInterrupt(uint32_t bit);
@@ -81,6 +98,7 @@ void hostIntfPacketFree(void *ptr);
 bool hostIntfPacketDequeue(void *ptr, uint32_t *wakeup, uint32_t *nonwakeup);
 void hostIntfSetBusy(bool busy);
 void hostIntfRxPacket(bool wakeupActive);
-void hostIntfTxAck(void *buffer, uint8_t len);
+void hostIntfGetWakeupStats(struct HostIntfWakeupStats *stats);
+uint32_t hostIntfGetDroppedSamples(uint32_t sensorType); // since boot: pushed out of, or refused by, a full output queue
 
 #endif /* __HOSTINTF_H */
@@ -17,9 +17,9 @@
 #ifndef __NANOHUBCOMMAND_H
 #define __NANOHUBCOMMAND_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
-#define NANOHUB_FAST_DONT_ACK       0xFFFFFFFE
 #define NANOHUB_FAST_UNHANDLED_ACK  0xFFFFFFFF
 
 struct NanohubCommand {
@@ -28,6 +28,7 @@ struct NanohubCommand {
     uint32_t (*handler)(void *, uint8_t, void *, uint64_t);
     uint8_t minDataLen;
     uint8_t maxDataLen;
+    bool bulk; /* handler lays out a run of packets, not a payload; see NANOHUB_REASON_READ_EVENTS */
 };
 
 void nanohubInitCommand(void);
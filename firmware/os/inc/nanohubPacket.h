@@ -278,6 +278,23 @@ struct NanohubWriteEventResponse {
 } ATTRIBUTE_PACKED;
 SET_PACKED_STRUCT_MODE_OFF
 
+/*
+ * Bulk read. The reply is a run of packets sent back to back in one transfer, all with this
+ * reason and the request's seq; each carries what a READ_EVENT reply would, and an empty one
+ * ends the run. The run, empty packet included, is at most maxLength bytes long (but always
+ * has room for one event) and at most NANOHUB_READ_EVENTS_MAX. Hubs built without it (see
+ * HOSTINTF_READ_EVENTS_MAX) NAK it, and the AP falls back to READ_EVENT.
+ */
+#define NANOHUB_REASON_READ_EVENTS            0x00001092
+#define NANOHUB_READ_EVENTS_MAX               2048
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubReadEventsRequest {
+    __le64 apBootTime;
+    __le16 maxLength;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
 SET_PACKED_STRUCT_MODE_ON
 struct NanohubHalHdr {
     uint64_t appId;
@@ -325,6 +342,21 @@ struct NanohubHalMgmtTx {
 SET_PACKED_STRUCT_MODE_OFF
 
 #define NANOHUB_HAL_QUERY_MEMINFO   3
+
+#define NANOHUB_HAL_MEM_SZ_UNKNOWN  0xFFFFFFFFUL
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalQueryMemInfoTx {
+    struct NanohubHalHdr hdr;
+    //sizes
+    __le32 flashSz, blSz, osSz, sharedSz, eeSz;
+    __le32 ramSz;
+    //use
+    __le32 blUse, osUse, sharedUse, eeUse;
+    __le32 ramUse;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
 #define NANOHUB_HAL_QUERY_APPS      4
 
 SET_PACKED_STRUCT_MODE_ON
@@ -408,4 +440,116 @@ struct NanohubHalRebootTx {
 } ATTRIBUTE_PACKED;
 SET_PACKED_STRUCT_MODE_OFF
 
+#define NANOHUB_HAL_QUERY_HEAP      10
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalQueryHeapRx {
+    __le32 idx;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+// heap totals always; app part is missing when idx is past the last app
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalQueryHeapTx {
+    struct NanohubHalHdr hdr;
+    __le32 heapSz;
+    __le32 freeSz;
+    __le32 largestFree;
+    __le32 freeChunks;
+    __le64 appId;
+    __le32 curUse;
+    __le32 peakUse;
+    __le32 allocCnt;
+    __le32 failCnt;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+#define NANOHUB_HAL_QUERY_EVT_DROPS 11
+
+#define NANOHUB_HAL_EVT_DROPS_MAX   16
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalEvtDrop {
+    __le32 evtType;
+    __le32 count;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalQueryEvtDropsTx {
+    struct NanohubHalHdr hdr;
+    __le32 total;
+    struct NanohubHalEvtDrop drops[];
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+#define NANOHUB_HAL_QUERY_TASK_PROF 12
+
+#define NANOHUB_HAL_TASK_PROF_RESET 0x01
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalQueryTaskProfRx {
+    __le32 idx;
+    uint8_t flags; /* NANOHUB_HAL_TASK_PROF_*; reset happens after the reply is filled in */
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+// window always; task part is missing when idx is past the last task. times in ns
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalQueryTaskProfTx {
+    struct NanohubHalHdr hdr;
+    __le64 window;
+    __le64 appId;
+    __le32 tid;
+    __le32 evtCnt;
+    __le64 runTime;
+    __le32 maxRunTime;
+    __le32 waitCnt;
+    __le64 waitTime;
+    __le32 maxWaitTime;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+#define NANOHUB_HAL_TRACE           13
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalTraceRx {
+    uint8_t enable;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+// enabled is the state after the request; stays 0 on builds without OS_TRACE
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalTraceTx {
+    struct NanohubHalHdr hdr;
+    uint8_t enabled;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+#define NANOHUB_HAL_QUERY_WAKEUP_STATS 14
+
+// see struct HostIntfWakeupStats
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalQueryWakeupStatsTx {
+    struct NanohubHalHdr hdr;
+    __le32 apWakeups;
+    __le32 apWakeupsLastHour;
+    __le32 batchWindows;
+    __le32 batchFlushes;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+#define NANOHUB_HAL_QUERY_TIMER_STATS 15
+
+// see struct TimerStats
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalQueryTimerStatsTx {
+    struct NanohubHalHdr hdr;
+    __le32 wakes;
+    __le32 fired;
+    __le32 coalesced;
+    __le32 wakesPerSec;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
 #endif /* __NANOHUBPACKET_H */
@@ -45,6 +45,7 @@ uint32_t platFreeResources(uint32_t tid);
 void *platLogAllocUserData();
 void platLogFlush(void *userData);
 bool platLogPutcharF(void *userData, char ch);
+bool platLogPutbytesF(void *userData, const void *data, uint32_t len); /* binary; host log buffer only, all or nothing */
 void platEarlyLogFlush(void);
 
 /* fast timer */
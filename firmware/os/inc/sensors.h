@@ -276,6 +276,7 @@ bool sensorRelease(uint32_t clientTid, uint32_t sensorHandle);
 uint32_t sensorFreeAll(uint32_t clientTid);
 bool sensorTriggerOndemand(uint32_t clientTid, uint32_t sensorHandle);
 bool sensorFlush(uint32_t sensorHandle);
+bool sensorIsSoleClient(uint32_t clientTid, uint32_t sensorHandle); // no other task has it requested, so a flush reaches nobody else's batching
 bool sensorCalibrate(uint32_t sensorHandle);
 bool sensorSelfTest(uint32_t sensorHandle);
 bool sensorCfgData(uint32_t sensorHandle, void* cfgData);
@@ -30,6 +30,13 @@ struct Sensor {
     uint32_t initComplete:1; /* sensor finished initializing */
     uint32_t hasOnchange :1; /* sensor supports onchange and wants to be notified to send new clients current state */
     uint32_t hasOndemand :1; /* sensor supports ondemand and wants to get triggers */
+    struct SensorsClientRequest *reqs; /* this sensor's client requests */
+    uint64_t reqLatency;     /* smallest latency in reqs; SENSOR_LATENCY_INVALID if none */
+    uint32_t reqRate;        /* highest numeric (not onchange/ondemand) rate in reqs; 0 if none */
+    uint8_t numReqs;         /* entries in reqs */
+    uint8_t numOnchangeReqs; /* entries in reqs asking for SENSOR_RATE_ONCHANGE */
+    uint8_t nextByHandle;    /* chain in the handle hash; SENSOR_IDX_NONE ends it */
+    uint8_t nextByType;      /* chain in the sensor type hash, in slot order */
 };
 
 struct SensorsInternalEvent {
@@ -49,6 +56,7 @@ struct SensorsInternalEvent {
 };
 
 struct SensorsClientRequest {
+    struct SensorsClientRequest *next; /* next request for the same sensor */
     uint32_t handle;
     uint32_t clientTid;
     uint64_t latency;
@@ -57,6 +65,7 @@ struct SensorsClientRequest {
 
 #define MAX_INTERNAL_EVENTS       32 //also used for external app sensors' setRate() calls
 #define MAX_CLI_SENS_MATRIX_SZ    64 /* MAX(numClients * numSensors) */
+#define SENSOR_IDX_NONE           0xFF /* end of a struct Sensor hash chain */
 
 #define SENSOR_RATE_OFF           UINT32_C(0x00000000) /* used in sensor state machine */
 #define SENSOR_RATE_POWERING_ON   UINT32_C(0xFFFFFFF0) /* used in sensor state machine */
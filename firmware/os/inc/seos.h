@@ -46,6 +46,8 @@ extern "C" {
 
 typedef uint8_t TaskIndex;
 
+struct SlabAllocator;
+
 struct AppFuncs { /* do not rearrange */
     /* lifescycle */
     bool (*init)(uint32_t yourTid);   //simple init only - no ints on at this time
@@ -165,15 +167,31 @@ bool osEnqueuePrivateEvtNew(uint16_t evtType, void *evtData,
                                    uint32_t toTid);
 
 bool osEnqueueEvt(uint32_t evtType, void *evtData, EventFreeF evtFreeF);
+bool osEnqueueEvtEx(uint32_t evtType, void *evtData, EventFreeF evtFreeF, uint32_t prio); /* prio is one of EVT_PRIO_* */
 bool osEnqueueEvtOrFree(uint32_t evtType, void *evtData, EventFreeF evtFreeF);
 bool osEnqueueEvtAsApp(uint32_t evtType, void *evtData, bool freeData);
+uint32_t osGetEvtDropStats(struct EvtQueueDropStat *stats, uint32_t maxStats, uint32_t *totalP); /* events lost to a full queue; see evtQueueGetDropStats() */
 void osRemovePendingEvents(bool (*match)(uint32_t evtType, const void *evtData, void *context), void *context);
 
 bool osDefer(OsDeferCbkF callback, void *cookie, bool urgent);
 
+struct TaskProfile {
+    uint64_t appId;
+    uint32_t tid;
+    uint32_t evtCnt; /* handler invocations */
+    uint64_t runTime; /* ns spent in handler */
+    uint32_t maxRunTime; /* ns */
+    uint32_t waitCnt; /* events that were queued, out of evtCnt */
+    uint64_t waitTime; /* ns between enqueue and handler start; ~1us resolution */
+    uint32_t maxWaitTime; /* ns */
+    uint64_t window; /* ns since osResetTaskProfiles() */
+};
+
 bool osTidById(uint64_t *appId, uint32_t *tid);
 bool osAppInfoById(uint64_t appId, uint32_t *appIdx, uint32_t *appVer, uint32_t *appSize);
 bool osAppInfoByIndex(uint32_t appIdx, uint64_t *appId, uint32_t *appVer, uint32_t *appSize);
+bool osGetTaskProfile(uint32_t taskIdx, struct TaskProfile *prof); /* taskIdx as for osAppInfoByIndex(); false if none or not compiled in */
+void osResetTaskProfiles(void);
 uint32_t osGetCurrentTid();
 uint32_t osSetCurrentTid(uint32_t);
 
@@ -259,9 +277,17 @@ bool osWriteShared(void *dest, const void *src, uint32_t len);
 bool osEraseShared();
 
 //event retaining support
-bool osRetainCurrentEvent(TaggedPtr *evtFreeingInfoP); //called from any apps' event handling to retain current event. Only valid for first app that tries. evtFreeingInfoP filled by call and used to free evt later
+bool osRetainCurrentEvent(TaggedPtr *evtFreeingInfoP); //called from any apps' event handling to retain current event. Only valid for first app that tries, unless event is an osEvtBufAlloc() buffer. evtFreeingInfoP filled by call and used to free evt later
 void osFreeRetainedEvent(uint32_t evtType, void *evtData, TaggedPtr *evtFreeingInfoP);
 
+/* refcounted event buffers: enqueue with osEvtBufRelease as the EventFreeF and any number of subscribers
+ * may osRetainCurrentEvent() it at once; each of them later drops its ref via osFreeRetainedEvent() */
+void *osEvtBufAlloc(uint32_t size); /* returned buffer holds one ref */
+struct SlabAllocator *osEvtBufSlabNew(uint32_t size, uint32_t num); /* fixed pool of num buffers; slabAllocatorDestroy() it */
+void *osEvtBufSlabAlloc(struct SlabAllocator *slab); /* same as osEvtBufAlloc(), from a pool made by osEvtBufSlabNew() */
+void osEvtBufRetain(void *evtData);
+void osEvtBufRelease(void *evtData); /* frees buffer when last ref is dropped */
+
 uint32_t osExtAppStopApps(uint64_t appId);
 uint32_t osExtAppEraseApps(uint64_t appId);
 uint32_t osExtAppStartApps(uint64_t appId);
@@ -279,6 +305,75 @@ enum LogLevel {
 void osLogv(char clevel, uint32_t flags, const char *str, va_list vl);
 void osLog(enum LogLevel level, const char *str, ...) PRINTF_ATTRIBUTE(2, 3);
 
+/*
+ * Tokenized logging. With OS_LOG_TOKENIZED set for the OS image (OSFLAGS_os; the platform linker
+ * script must provide the .logstr section), osLog() does no formatting on the MCU: the format string
+ * is placed in .logstr, which is never loaded but is extracted by the build into the host-side log
+ * dictionary (os.logdict), and its offset there is sent in its place along with the raw arguments.
+ * The record goes out through the usual log path; its level byte has OS_LOG_TOKENIZED_FLAG set:
+ *   u8 level | OS_LOG_TOKENIZED_FLAG, varint token, varint argTypes, args[]
+ * argTypes holds the number of args in bits 0..3, then an OS_LOG_ARG_* type for each arg, 2 bits
+ * apiece. Ints are zigzag varints, doubles are 8 raw bytes, strings are a varint length and the chars.
+ * If the platform defines PLAT_LOG_CHARS (a debug UART, stderr), char outputs get the level, '#',
+ * the token in hex and the args as text instead (doubles as their bits in hex); otherwise no
+ * formatting is done at all.
+ * osLogv() and app logs are unaffected and keep sending text.
+ */
+#define OS_LOG_TOKENIZED_FLAG   0x80
+#define OS_LOG_ARG_INT          0
+#define OS_LOG_ARG_INT64        1
+#define OS_LOG_ARG_DOUBLE       2
+#define OS_LOG_ARG_STR          3
+#define OS_LOG_MAX_ARGS         12
+#define OS_LOG_MAX_STR          32 /* longer string args are truncated */
+
+void osLogTokenized(enum LogLevel level, uint32_t token, uint32_t argTypes, ...);
+
+#if defined(OS_LOG_TOKENIZED) && defined(_OS_BUILD_)
+
+#define OS_LOG_ARG_TYPE(x) _Generic((x),                                                \
+    float: OS_LOG_ARG_DOUBLE,                                                           \
+    double: OS_LOG_ARG_DOUBLE,                                                          \
+    char *: OS_LOG_ARG_STR,                                                             \
+    const char *: OS_LOG_ARG_STR,                                                       \
+    default: sizeof(1 ? (x) : (x)) > sizeof(uint32_t) ? OS_LOG_ARG_INT64 : OS_LOG_ARG_INT)
+
+#define OS_LOG_ARG_TYPES_0(...)     0
+#define OS_LOG_ARG_TYPES_1(a)       OS_LOG_ARG_TYPE(a)
+#define OS_LOG_ARG_TYPES_2(a, ...)  (OS_LOG_ARG_TYPE(a) | OS_LOG_ARG_TYPES_1(__VA_ARGS__) << 2)
+#define OS_LOG_ARG_TYPES_3(a, ...)  (OS_LOG_ARG_TYPE(a) | OS_LOG_ARG_TYPES_2(__VA_ARGS__) << 2)
+#define OS_LOG_ARG_TYPES_4(a, ...)  (OS_LOG_ARG_TYPE(a) | OS_LOG_ARG_TYPES_3(__VA_ARGS__) << 2)
+#define OS_LOG_ARG_TYPES_5(a, ...)  (OS_LOG_ARG_TYPE(a) | OS_LOG_ARG_TYPES_4(__VA_ARGS__) << 2)
+#define OS_LOG_ARG_TYPES_6(a, ...)  (OS_LOG_ARG_TYPE(a) | OS_LOG_ARG_TYPES_5(__VA_ARGS__) << 2)
+#define OS_LOG_ARG_TYPES_7(a, ...)  (OS_LOG_ARG_TYPE(a) | OS_LOG_ARG_TYPES_6(__VA_ARGS__) << 2)
+#define OS_LOG_ARG_TYPES_8(a, ...)  (OS_LOG_ARG_TYPE(a) | OS_LOG_ARG_TYPES_7(__VA_ARGS__) << 2)
+#define OS_LOG_ARG_TYPES_9(a, ...)  (OS_LOG_ARG_TYPE(a) | OS_LOG_ARG_TYPES_8(__VA_ARGS__) << 2)
+#define OS_LOG_ARG_TYPES_10(a, ...) (OS_LOG_ARG_TYPE(a) | OS_LOG_ARG_TYPES_9(__VA_ARGS__) << 2)
+#define OS_LOG_ARG_TYPES_11(a, ...) (OS_LOG_ARG_TYPE(a) | OS_LOG_ARG_TYPES_10(__VA_ARGS__) << 2)
+#define OS_LOG_ARG_TYPES_12(a, ...) (OS_LOG_ARG_TYPE(a) | OS_LOG_ARG_TYPES_11(__VA_ARGS__) << 2)
+
+#define OS_LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, n, ...) n
+#define OS_LOG_NARGS(...) OS_LOG_NARGS_(0, ##__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define OS_LOG_ARG_TYPES__(n, ...)  ((uint32_t)n | (uint32_t)OS_LOG_ARG_TYPES_##n(__VA_ARGS__) << 4)
+#define OS_LOG_ARG_TYPES_(n, ...)   OS_LOG_ARG_TYPES__(n, __VA_ARGS__)
+#define OS_LOG_ARG_TYPES(...)       OS_LOG_ARG_TYPES_(OS_LOG_NARGS(__VA_ARGS__), __VA_ARGS__)
+
+static inline void osLogCheckFormat(const char *str, ...) PRINTF_ATTRIBUTE(1, 2);
+static inline void osLogCheckFormat(const char *str, ...)
+{
+}
+
+#define osLog(level, str, ...)                                                          \
+    do {                                                                                \
+        static const char __attribute__((section(".logstr"))) _osLogStr[] = str;        \
+        if (0)                                                                          \
+            osLogCheckFormat(str, ##__VA_ARGS__);                                       \
+        osLogTokenized(level, (uint32_t)(uintptr_t)_osLogStr,                           \
+                       OS_LOG_ARG_TYPES(__VA_ARGS__), ##__VA_ARGS__);                   \
+    } while (0)
+
+#endif
+
 #ifndef INTERNAL_APP_INIT
 #define INTERNAL_APP_INIT(_id, _ver, _init, _end, _event)                               \
 SET_INTERNAL_LOCATION(location, ".internal_app_init")static const struct AppHdr         \
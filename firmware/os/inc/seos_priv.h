@@ -40,6 +40,12 @@
 
 #define MAX_EVT_SUB_CNT              6
 
+#ifndef OS_TASK_PROFILE
+// account handler run time and event wait time per task; see osGetTaskProfile()
+// costs two tick reads per handler call and a timestamp per event; variants may enable it
+#define OS_TASK_PROFILE              0
+#endif
+
 SET_PACKED_STRUCT_MODE_ON
 struct TaskList {
     TaskIndex prev;
@@ -47,6 +53,15 @@ struct TaskList {
 } ATTRIBUTE_PACKED;
 SET_PACKED_STRUCT_MODE_OFF
 
+struct TaskProf {
+    uint32_t evtCnt;
+    uint32_t maxRunTime; /* ns */
+    uint64_t runTime; /* ns */
+    uint32_t waitCnt;
+    uint32_t maxWaitTime; /* ns */
+    uint64_t waitTime; /* ns */
+};
+
 struct Task {
     /* App entry points */
     const struct AppHdr *app;
@@ -70,6 +85,10 @@ struct Task {
     uint8_t  flags;
     uint8_t  ioCount;
 
+#if OS_TASK_PROFILE
+    /* cleared when task is allocated, or by osResetTaskProfiles() */
+    struct TaskProf prof;
+#endif
 };
 
 struct I2cEventData {
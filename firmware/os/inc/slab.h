@@ -20,6 +20,7 @@
 #include <stdint.h>
 
 struct SlabAllocator;
+struct SlabCache;
 
 
 
@@ -34,5 +35,12 @@ void* slabAllocatorGetNth(struct SlabAllocator *allocator, uint32_t idx); // ->
 uint32_t slabAllocatorGetIndex(struct SlabAllocator *allocator, void *ptr); // -> index or -1 if invalid pointer
 uint32_t slabAllocatorGetNumItems(struct SlabAllocator *allocator); // simply say hwo many items it can hold max (numItems passed to constructor)
 
+//a set of slabs of different item sizes, same safety guarantees as above. itemSzs must be ascending
+//alloc hands out an item of the smallest size that fits and has space left
+struct SlabCache* slabCacheNew(const uint32_t *itemSzs, const uint32_t *numItems, uint32_t numClasses, uint32_t itemAlign);
+void slabCacheDestroy(struct SlabCache *cache);
+void* slabCacheAlloc(struct SlabCache *cache, uint32_t sz);
+void slabCacheFree(struct SlabCache *cache, void *ptr);
+
 #endif
 
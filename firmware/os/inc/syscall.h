@@ -56,6 +56,7 @@ extern "C" {
 #define SYSCALL_DOMAIN_CHRE       2 /* alternative API */
 
 typedef void (*SyscallFunc)(uintptr_t *retValP, va_list args); /* you better know what args you need */
+typedef void (*SyscallFastFunc)(uintptr_t *retValP, const uintptr_t *params); /* params[] are the register args of syscallDo[1-4]P */
 
 struct SyscallTable {
     uint32_t numEntries;
@@ -75,6 +76,12 @@ bool syscallAddTable(uint32_t path, uint32_t level, struct SyscallTable *table);
 bool syscallAddFunc(uint32_t path, SyscallFunc func);
 
 SyscallFunc syscallGetHandler(uint32_t path); // NULL if none
+SyscallFunc syscallGetHandlerUncached(uint32_t path); // the same by walking the tables, as before the cache; for benchmarks
+
+//optional va_list-free variant of an existing handler, used for register-passed calls; limited by cache space
+bool syscallAddFastFunc(uint32_t path, SyscallFastFunc func);
+
+SyscallFastFunc syscallGetFastHandler(uint32_t path); // NULL if none
 
 
 #ifdef __cplusplus
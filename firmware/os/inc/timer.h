@@ -33,6 +33,13 @@ struct TimerEvent {
 };
 
 
+struct TimerStats {
+    uint32_t wakes;       /* timer wakeups since boot */
+    uint32_t fired;       /* timer expirations since boot */
+    uint32_t coalesced;   /* expirations that shared a wakeup with an earlier one */
+    uint32_t wakesPerSec; /* wakeups during the last full stats window (1s) before the call */
+};
+
 typedef void (*TimTimerCbkF)(uint32_t timerId, void* data);
 
 
@@ -45,6 +52,7 @@ uint32_t timTimerSetNew(uint64_t length, const void* data, bool oneShot);
 bool timTimerCancel(uint32_t timerId);
 bool timTimerCancelEx(uint32_t timerId, bool cancelPending);
 int timTimerCancelAll(uint32_t tid);
+void timGetStats(struct TimerStats *stats);
 
 
 //called by interrupt routine. ->true if any timers were fired
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <variant/variant.h>
+#include "toolchain.h"
+
+/*
+ * Binary tracepoints. Each one is a fixed-size record in a RAM ring; the ring is
+ * drained to the host as HOSTINTF_DATA_TYPE_TRACE blocks (HOST_EVT_TRACE events)
+ * a block at a time, as soon as there is a block's worth, and when tracing is turned
+ * off. A burst of blocks would only overflow the host interface queue.
+ * Built only with OS_TRACE set; otherwise trace() compiles to nothing. While built
+ * in but not enabled, a tracepoint costs a call and a test.
+ */
+#ifndef OS_TRACE
+#define OS_TRACE                 0
+#endif
+
+#ifndef TRACE_RING_SZ
+#define TRACE_RING_SZ            256 /* records; power of 2 */
+#endif
+
+/* record ids; tid of the record is the current task unless stated otherwise */
+#define TRACE_TASK_BEGIN         1 /* tid: handling task. arg0: evtType, arg1: fromTid */
+#define TRACE_TASK_END           2 /* tid: handling task. arg0: evtType */
+#define TRACE_EVT_ENQUEUE        3 /* arg0: evtType, arg1: prio | (atFront << 31) */
+#define TRACE_TIMER_BEGIN        4 /* direct timer callbacks. tid: timer owner. arg0: timer id, arg1: callback data */
+#define TRACE_TIMER_END          5 /* tid: timer owner. arg0: timer id */
+#define TRACE_SPI_START          6 /* arg0: device, arg1: number of packets */
+#define TRACE_SPI_DONE           7 /* arg0: device, arg1: err */
+#define TRACE_I2C_START          8 /* arg0: busId << 8 | addr, arg1: txSize << 16 | rxSize */
+#define TRACE_I2C_DONE           9 /* arg0: tx << 16 | rx (bytes done), arg1: err */
+#define TRACE_HEAP_ALLOC         10 /* arg0: size, as the allocator rounded it up, arg1: block, 0 if it failed */
+#define TRACE_HEAP_FREE          11 /* arg0: block */
+#define TRACE_HEAP_FREE_ALL      12 /* arg0: tid whose blocks were all freed, arg1: how many */
+#define TRACE_LOST               0xFFFF /* arg0: records overwritten before they were drained, or dropped on the way out */
+
+SET_PACKED_STRUCT_MODE_ON
+struct TraceRecord {
+    uint32_t time; /* platGetTicks() >> 10, i.e. ~us; wraps */
+    uint16_t tid;
+    uint16_t id;
+    uint32_t arg0;
+    uint32_t arg1;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+#if OS_TRACE
+#define trace(_id, _arg0, _arg1) traceRecord((_id), (uint32_t)(uintptr_t)(_arg0), (uint32_t)(uintptr_t)(_arg1))
+#else
+#define trace(_id, _arg0, _arg1) do { } while (0)
+#endif
+
+void traceRecord(uint16_t id, uint32_t arg0, uint32_t arg1);
+bool traceEnable(bool on); /* -> false if tracing is not built in; turning it off drains the ring */
+bool traceIsEnabled(void);
+void traceDropped(const struct TraceRecord *recs, uint32_t num); /* a drained block never made it to the host */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
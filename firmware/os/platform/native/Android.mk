@@ -28,10 +28,19 @@ LOCAL_MODULE := libnanohub_os_native
 LOCAL_AUX_ARCH := native
 
 LOCAL_SRC_FILES := \
+    apInt.c \
+    bench.c \
+    benchHeapFirstFit.c \
+    benchHeapTlsf.c \
+    crc.c \
+    eeData.c \
+    gpio.c \
     hostIntf.c \
     i2c.c \
     platform.c \
     rtc.c \
+    sim.c \
     spi.c \
+    stress.c \
 
 include $(BUILD_NANOHUB_OS_STATIC_LIBRARY)
@@ -0,0 +1,634 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <plat/bench.h>
+#include <plat/taggedPtr.h>
+#include <atomicBitset.h>
+#include <eventQ.h>
+#include <eventnums.h>
+#include <heap.h>
+#include <seos.h>
+#include <simpleQ.h>
+#include <slab.h>
+#include <syscall.h>
+#include <timer.h>
+#include <util.h>
+
+#include <chreApi.h>
+
+/*
+ * Every case is run twice: once in a tight loop for throughput, once timing each op
+ * for the latency percentiles. Latencies have the clock read cost (reported as
+ * clock_ns) taken out. One line per case:
+ *
+ *   bench: name=<case> ops=<n> ops_per_s=<n> p50_ns=<n> p90_ns=<n> p99_ns=<n> max_ns=<n>
+ *
+ * The heap cases run on copies of both heap backends with heaps of their own (see
+ * benchHeap*.c), whatever the OS was built with. heap_trace_* replays the heap ops the
+ * sim recorded with "heaptrace" (see sim.c), given with -r. The heap cases also say how
+ * fragmented the heap was left by the timed pass, just before its timing line:
+ *
+ *   bench: name=<case> free_bytes=<n> largest_free=<n> free_chunks=<n> frag_pct=<n>
+ *
+ * frag_pct is the part of the free space that is not in the largest free block.
+ * Everything else runs from the init of an internal app, on the real OS state.
+ */
+
+#define BENCH_APP_ID            APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 31)
+#define BENCH_APP_VERSION       1
+
+#define BENCH_OPS               100000
+#define BENCH_HEAP_OPS          20000
+#define BENCH_EVT_TYPE          EVT_NO_FIRST_USER_EVENT
+#define BENCH_EVTQ_SIZE         64
+#define BENCH_BURST             16
+#define BENCH_SLAB_ITEMS        256
+#define BENCH_SLAB_ITEM_SZ      32
+#define BENCH_CACHE_BIG_SZ      256  /* slab cache: BENCH_SLAB_ITEMS small items, a quarter as many big ones */
+#define BENCH_HEAP_FRAG_BLOCKS  256
+#define BENCH_HEAP_SLOTS        1024 /* blocks a replayed trace may have live at once */
+#define BENCH_HEAP_FIRSTFIT     0
+#define BENCH_HEAP_TLSF         1
+#define BENCH_SQ_ENTRIES        64
+#define BENCH_SQ_ENTRY_SZ       16
+#define BENCH_BITSET_BITS       256
+
+struct BenchCase {
+    const char *name;
+    uint32_t ops;       /* 0: as many as the heap trace has */
+    uint32_t param;
+    bool (*setup)(uint32_t param);
+    void (*op)(uint32_t i);
+    void (*teardown)(void);
+    void (*report)(const struct BenchCase *c); /* after the timed pass, before teardown */
+};
+
+struct BenchHeapOp {
+    uint32_t size;      /* 0: a free */
+    uint32_t slot;      /* the block, in mBenchPtrs */
+};
+
+static const char *mBenchFilter;
+static uint32_t mBenchLat[BENCH_OPS];
+static uint64_t mBenchClockNs;
+static uint32_t mBenchSeed;
+
+static struct EvtQueue *mBenchEvtQ;
+static struct SlabAllocator *mBenchSlab;
+static struct SlabCache *mBenchCache;
+static void *mBenchPtrs[BENCH_HEAP_SLOTS];
+static const struct BenchHeap *mBenchHeap;
+static const char *mBenchTracePath;
+static struct BenchHeapOp mBenchTrace[BENCH_OPS];
+static uint32_t mBenchTraceLen;
+static struct SimpleQueue *mBenchSq;
+ATOMIC_BITSET_DECL(mBenchBitset, BENCH_BITSET_BITS, static);
+static uint32_t mBenchTimers[MAX_TIMERS];
+static uint32_t mBenchNumTimers;
+
+static const struct BenchHeap * const mBenchHeaps[] = {
+    [BENCH_HEAP_FIRSTFIT] = &gBenchHeapFirstFit,
+    [BENCH_HEAP_TLSF] = &gBenchHeapTlsf,
+};
+
+void benchRequest(const char *filter)
+{
+    mBenchFilter = filter;
+}
+
+void benchHeapTrace(const char *path)
+{
+    mBenchTracePath = path;
+}
+
+static inline uint64_t benchNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//same sequence every run
+static uint32_t benchRand(void)
+{
+    mBenchSeed = mBenchSeed * 1664525 + 1013904223;
+    return mBenchSeed >> 8;
+}
+
+static int benchCmpU32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* event queue */
+
+static void benchEvtDiscard(uint32_t evtType, void *evtData, TaggedPtr evtFreeData)
+{
+}
+
+//param: EVT_QUEUE_FL_* flags
+static bool benchEvtQSetup(uint32_t param)
+{
+    mBenchEvtQ = evtQueueAllocEx(BENCH_EVTQ_SIZE, benchEvtDiscard, param, NULL);
+    return mBenchEvtQ != NULL;
+}
+
+static void benchEvtQTeardown(void)
+{
+    evtQueueFree(mBenchEvtQ);
+}
+
+static void benchEvtQOp(uint32_t i)
+{
+    uint32_t evtType;
+    void *evtData;
+    TaggedPtr evtFreeData;
+
+    evtQueueEnqueue(mBenchEvtQ, BENCH_EVT_TYPE, NULL, taggedPtrMakeFromPtr(NULL), false);
+    evtQueueDequeue(mBenchEvtQ, &evtType, &evtData, &evtFreeData, false);
+}
+
+static void benchEvtQBurstOp(uint32_t i)
+{
+    uint32_t j, evtType;
+    void *evtData;
+    TaggedPtr evtFreeData;
+
+    for (j = 0; j < BENCH_BURST; j++)
+        evtQueueEnqueue(mBenchEvtQ, BENCH_EVT_TYPE, NULL, taggedPtrMakeFromPtr(NULL), false);
+    for (j = 0; j < BENCH_BURST; j++)
+        evtQueueDequeue(mBenchEvtQ, &evtType, &evtData, &evtFreeData, false);
+}
+
+static void benchEvtQBatchOp(uint32_t i)
+{
+    struct EvtQueueItem items[BENCH_BURST];
+    uint32_t j;
+
+    for (j = 0; j < BENCH_BURST; j++)
+        evtQueueEnqueue(mBenchEvtQ, BENCH_EVT_TYPE, NULL, taggedPtrMakeFromPtr(NULL), false);
+    evtQueueDequeueBatch(mBenchEvtQ, items, BENCH_BURST, false);
+}
+
+/* slab, at a given occupancy in percent */
+
+static bool benchSlabSetup(uint32_t param)
+{
+    uint32_t i, n;
+
+    mBenchSlab = slabAllocatorNew(BENCH_SLAB_ITEM_SZ, 4, BENCH_SLAB_ITEMS);
+    if (!mBenchSlab)
+        return false;
+
+    //fill it up, then free random items until we are down to the occupancy
+    for (i = 0; i < BENCH_SLAB_ITEMS; i++)
+        mBenchPtrs[i] = slabAllocatorAlloc(mBenchSlab);
+    for (n = BENCH_SLAB_ITEMS; n > BENCH_SLAB_ITEMS * param / 100; ) {
+        i = benchRand() % BENCH_SLAB_ITEMS;
+        if (mBenchPtrs[i]) {
+            slabAllocatorFree(mBenchSlab, mBenchPtrs[i]);
+            mBenchPtrs[i] = NULL;
+            n--;
+        }
+    }
+
+    return true;
+}
+
+static void benchSlabTeardown(void)
+{
+    slabAllocatorDestroy(mBenchSlab);
+}
+
+static void benchSlabOp(uint32_t i)
+{
+    slabAllocatorFree(mBenchSlab, slabAllocatorAlloc(mBenchSlab));
+}
+
+/* slab cache, both classes half full; three small items for every big one */
+
+static bool benchCacheSetup(uint32_t param)
+{
+    static const uint32_t itemSzs[] = { BENCH_SLAB_ITEM_SZ, BENCH_CACHE_BIG_SZ };
+    static const uint32_t numItems[] = { BENCH_SLAB_ITEMS, BENCH_SLAB_ITEMS / 4 };
+    uint32_t i;
+
+    mBenchCache = slabCacheNew(itemSzs, numItems, ARRAY_SIZE(itemSzs), 4);
+    if (!mBenchCache)
+        return false;
+
+    for (i = 0; i < BENCH_SLAB_ITEMS / 2; i++)
+        slabCacheAlloc(mBenchCache, BENCH_SLAB_ITEM_SZ);
+    for (i = 0; i < BENCH_SLAB_ITEMS / 8; i++)
+        slabCacheAlloc(mBenchCache, BENCH_CACHE_BIG_SZ);
+
+    return true;
+}
+
+static void benchCacheTeardown(void)
+{
+    slabCacheDestroy(mBenchCache);
+}
+
+static void benchCacheOp(uint32_t i)
+{
+    slabCacheFree(mBenchCache, slabCacheAlloc(mBenchCache, i & 3 ? BENCH_SLAB_ITEM_SZ - 8 : BENCH_CACHE_BIG_SZ));
+}
+
+/* heap */
+
+static uint32_t benchHeapSize(void)
+{
+    uint32_t r = benchRand() % 100;
+
+    //mostly event-sized, some buffers, the odd big one
+    if (r < 80)
+        return 16 + benchRand() % 80;
+    else if (r < 95)
+        return 128 + benchRand() % 384;
+    else
+        return 1024 + benchRand() % 1024;
+}
+
+static bool benchHeapSetup(uint32_t param)
+{
+    mBenchHeap = mBenchHeaps[param];
+    memset(mBenchPtrs, 0, sizeof(mBenchPtrs));
+
+    return mBenchHeap->init();
+}
+
+static bool benchHeapFragSetup(uint32_t param)
+{
+    uint32_t i;
+
+    if (!benchHeapSetup(param))
+        return false;
+
+    //every other block freed: lots of holes, none very big
+    for (i = 0; i < BENCH_HEAP_FRAG_BLOCKS; i++)
+        mBenchPtrs[i] = mBenchHeap->alloc(24 + (benchRand() % 8) * 32);
+    for (i = 0; i < BENCH_HEAP_FRAG_BLOCKS; i += 2) {
+        mBenchHeap->free(mBenchPtrs[i]);
+        mBenchPtrs[i] = NULL;
+    }
+
+    return true;
+}
+
+static bool benchHeapTraceSetup(uint32_t param)
+{
+    return mBenchTraceLen && benchHeapSetup(param);
+}
+
+static void benchHeapReport(const struct BenchCase *c)
+{
+    struct HeapStats stats;
+
+    if (!mBenchHeap->getStats(&stats))
+        return;
+
+    printf("bench: name=%s free_bytes=%" PRIu32 " largest_free=%" PRIu32 " free_chunks=%" PRIu32 " frag_pct=%" PRIu32 "\n",
+           c->name, stats.freeBytes, stats.largestFree, stats.freeChunks,
+           stats.freeBytes ? 100 - (uint32_t)((uint64_t)stats.largestFree * 100 / stats.freeBytes) : 0);
+}
+
+static void benchHeapFragOp(uint32_t i)
+{
+    mBenchHeap->free(mBenchHeap->alloc(benchHeapSize()));
+}
+
+static void benchHeapTraceOp(uint32_t i)
+{
+    const struct BenchHeapOp *op = &mBenchTrace[i];
+
+    if (op->size) {
+        mBenchPtrs[op->slot] = mBenchHeap->alloc(op->size);
+    } else {
+        mBenchHeap->free(mBenchPtrs[op->slot]);
+        mBenchPtrs[op->slot] = NULL;
+    }
+}
+
+static bool benchHeapTraceAdd(uint32_t size, uint32_t slot)
+{
+    if (mBenchTraceLen == BENCH_OPS)
+        return false;
+
+    mBenchTrace[mBenchTraceLen].size = size;
+    mBenchTrace[mBenchTraceLen++].slot = slot;
+
+    return true;
+}
+
+//the recorded blocks become slots; blocks allocated before the recording started are left out
+static bool benchHeapTraceLoad(const char *path)
+{
+    static uint32_t addrs[BENCH_HEAP_SLOTS], tids[BENCH_HEAP_SLOTS];
+    uint32_t addr, size, tid, slot, hole, numSlots = 0;
+    char line[64];
+    bool ok = true;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "bench: cannot open %s\n", path);
+        return false;
+    }
+
+    while (ok && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "a %" SCNx32 " %" SCNu32 " %" SCNu32, &addr, &size, &tid) == 3 && addr && size) {
+            //a block still live at the same address had its free lost; free it first
+            hole = numSlots;
+            for (slot = 0; slot < numSlots && addrs[slot] != addr; slot++)
+                if (!addrs[slot] && hole == numSlots)
+                    hole = slot;
+            if (slot < numSlots) {
+                ok = benchHeapTraceAdd(0, slot);
+            } else if ((slot = hole) == numSlots) {
+                if (numSlots == BENCH_HEAP_SLOTS)
+                    break;
+                numSlots++;
+            }
+            addrs[slot] = addr;
+            tids[slot] = tid;
+            ok = ok && benchHeapTraceAdd(size, slot);
+        } else if (sscanf(line, "f %" SCNx32, &addr) == 1 && addr) {
+            for (slot = 0; slot < numSlots && addrs[slot] != addr; slot++)
+                ;
+            if (slot < numSlots) {
+                addrs[slot] = 0;
+                ok = benchHeapTraceAdd(0, slot);
+            }
+        } else if (sscanf(line, "F %" SCNu32, &tid) == 1) {
+            for (slot = 0; ok && slot < numSlots; slot++) {
+                if (addrs[slot] && tids[slot] == tid) {
+                    addrs[slot] = 0;
+                    ok = benchHeapTraceAdd(0, slot);
+                }
+            }
+        }
+    }
+    fclose(f);
+
+    return mBenchTraceLen > 0;
+}
+
+/* timers */
+
+static void benchTimerCbk(uint32_t timerId, void *data)
+{
+}
+
+static bool benchTimerSetup(uint32_t param)
+{
+    uint32_t id;
+
+    //all the slots but one busy with far-off timers, at different times
+    for (mBenchNumTimers = 0; mBenchNumTimers < MAX_TIMERS; mBenchNumTimers++) {
+        id = timTimerSet(3600000000000ULL + benchRand(), 0, 50, benchTimerCbk, NULL, true);
+        if (!id)
+            break;
+        mBenchTimers[mBenchNumTimers] = id;
+    }
+    if (!mBenchNumTimers)
+        return false;
+    timTimerCancel(mBenchTimers[--mBenchNumTimers]);
+
+    return true;
+}
+
+static void benchTimerTeardown(void)
+{
+    while (mBenchNumTimers)
+        timTimerCancel(mBenchTimers[--mBenchNumTimers]);
+}
+
+static void benchTimerOp(uint32_t i)
+{
+    timTimerCancel(timTimerSet(1000000000ULL + (i & 0xFFFF) * 1000, 0, 50, benchTimerCbk, NULL, true));
+}
+
+/* simple queue */
+
+static bool benchSqDiscard(void *data, bool onDelete)
+{
+    return true;
+}
+
+static bool benchSqSetup(uint32_t param)
+{
+    mBenchSq = simpleQueueAlloc(BENCH_SQ_ENTRIES, BENCH_SQ_ENTRY_SZ, benchSqDiscard);
+    return mBenchSq != NULL;
+}
+
+static void benchSqTeardown(void)
+{
+    simpleQueueDestroy(mBenchSq);
+}
+
+static void benchSqOp(uint32_t i)
+{
+    uint8_t data[BENCH_SQ_ENTRY_SZ] = { 0 };
+
+    simpleQueueEnqueue(mBenchSq, data, sizeof(data), false);
+    simpleQueueDequeue(mBenchSq, data);
+}
+
+/* bitset, at a given occupancy in percent */
+
+static bool benchBitsetSetup(uint32_t param)
+{
+    uint32_t i, n;
+
+    atomicBitsetInit(mBenchBitset, BENCH_BITSET_BITS);
+    for (n = 0; n < BENCH_BITSET_BITS * param / 100; ) {
+        i = benchRand() % BENCH_BITSET_BITS;
+        if (!atomicBitsetGetBit(mBenchBitset, i)) {
+            atomicBitsetSetBit(mBenchBitset, i);
+            n++;
+        }
+    }
+
+    return true;
+}
+
+static void benchBitsetOp(uint32_t i)
+{
+    int32_t bit = atomicBitsetFindClearAndSet(mBenchBitset);
+
+    if (bit >= 0)
+        atomicBitsetClearBit(mBenchBitset, bit);
+}
+
+/* syscalls: an app's chreGetTime() as the SVC handler would dispatch it */
+
+#define BENCH_SYSCALL_GET_TIME  SYSCALL_NO(SYSCALL_DOMAIN_CHRE, SYSCALL_CHRE_MAIN, SYSCALL_CHRE_MAIN_API, SYSCALL_CHRE_MAIN_API_GET_TIME)
+
+static bool benchSyscallSetup(uint32_t param)
+{
+    return syscallGetHandler(BENCH_SYSCALL_GET_TIME) && syscallGetFastHandler(BENCH_SYSCALL_GET_TIME);
+}
+
+static uintptr_t benchSyscall(bool cached, uint32_t path, ...)
+{
+    SyscallFunc func = cached ? syscallGetHandler(path) : syscallGetHandlerUncached(path);
+    uintptr_t ret = 0;
+    va_list args;
+
+    va_start(args, path);
+    func(&ret, args);
+    va_end(args);
+
+    return ret;
+}
+
+static void benchSyscallOp(uint32_t i)
+{
+    uint64_t t;
+
+    benchSyscall(true, BENCH_SYSCALL_GET_TIME, &t);
+}
+
+static void benchSyscallWalkOp(uint32_t i)
+{
+    uint64_t t;
+
+    benchSyscall(false, BENCH_SYSCALL_GET_TIME, &t);
+}
+
+static void benchSyscallFastOp(uint32_t i)
+{
+    uintptr_t params[1], ret = 0;
+    uint64_t t;
+
+    params[0] = (uintptr_t)&t;
+    syscallGetFastHandler(BENCH_SYSCALL_GET_TIME)(&ret, params);
+}
+
+static const struct BenchCase mBenchCases[] = {
+    { "evtq_enq_deq",          BENCH_OPS,      0,                     benchEvtQSetup,      benchEvtQOp,        benchEvtQTeardown,  NULL },
+    { "evtq_burst16",          BENCH_OPS / 16, 0,                     benchEvtQSetup,      benchEvtQBurstOp,   benchEvtQTeardown,  NULL },
+    { "evtq_burst16_batch",    BENCH_OPS / 16, 0,                     benchEvtQSetup,      benchEvtQBatchOp,   benchEvtQTeardown,  NULL },
+    { "evtq_ll_burst16",       BENCH_OPS / 16, EVT_QUEUE_FL_LOCKLESS, benchEvtQSetup,      benchEvtQBurstOp,   benchEvtQTeardown,  NULL },
+    { "evtq_ll_burst16_batch", BENCH_OPS / 16, EVT_QUEUE_FL_LOCKLESS, benchEvtQSetup,      benchEvtQBatchOp,   benchEvtQTeardown,  NULL },
+    { "slab_occ10",            BENCH_OPS,      10,                    benchSlabSetup,      benchSlabOp,        benchSlabTeardown,  NULL },
+    { "slab_occ50",            BENCH_OPS,      50,                    benchSlabSetup,      benchSlabOp,        benchSlabTeardown,  NULL },
+    { "slab_occ95",            BENCH_OPS,      95,                    benchSlabSetup,      benchSlabOp,        benchSlabTeardown,  NULL },
+    { "slab_cache_mixed",      BENCH_OPS,      0,                     benchCacheSetup,     benchCacheOp,       benchCacheTeardown, NULL },
+    { "heap_frag_firstfit",    BENCH_HEAP_OPS, BENCH_HEAP_FIRSTFIT,   benchHeapFragSetup,  benchHeapFragOp,    NULL,               benchHeapReport },
+    { "heap_frag_tlsf",        BENCH_HEAP_OPS, BENCH_HEAP_TLSF,       benchHeapFragSetup,  benchHeapFragOp,    NULL,               benchHeapReport },
+    { "heap_trace_firstfit",   0,              BENCH_HEAP_FIRSTFIT,   benchHeapTraceSetup, benchHeapTraceOp,   NULL,               benchHeapReport },
+    { "heap_trace_tlsf",       0,              BENCH_HEAP_TLSF,       benchHeapTraceSetup, benchHeapTraceOp,   NULL,               benchHeapReport },
+    { "timer_set_cancel",      BENCH_OPS,      0,                     benchTimerSetup,     benchTimerOp,       benchTimerTeardown, NULL },
+    { "simpleq_enq_deq",       BENCH_OPS,      0,                     benchSqSetup,        benchSqOp,          benchSqTeardown,    NULL },
+    { "bitset_occ50",          BENCH_OPS,      50,                    benchBitsetSetup,    benchBitsetOp,      NULL,               NULL },
+    { "bitset_occ95",          BENCH_OPS,      95,                    benchBitsetSetup,    benchBitsetOp,      NULL,               NULL },
+    { "syscall_va_walk",       BENCH_OPS,      0,                     benchSyscallSetup,   benchSyscallWalkOp, NULL,               NULL },
+    { "syscall_va",            BENCH_OPS,      0,                     benchSyscallSetup,   benchSyscallOp,     NULL,               NULL },
+    { "syscall_fast",          BENCH_OPS,      0,                     benchSyscallSetup,   benchSyscallFastOp, NULL,               NULL },
+};
+
+static void benchRunCase(const struct BenchCase *c)
+{
+    uint32_t ops = c->ops ? c->ops : mBenchTraceLen;
+    uint64_t start, total, t, opsPerSec;
+    uint32_t i;
+
+    //both passes see the same random sequence
+    mBenchSeed = 1;
+    if (!c->setup(c->param)) {
+        printf("bench: name=%s error=setup\n", c->name);
+        return;
+    }
+    start = benchNow();
+    for (i = 0; i < ops; i++)
+        c->op(i);
+    total = benchNow() - start;
+    if (c->report)
+        c->report(c);
+    if (c->teardown)
+        c->teardown();
+
+    mBenchSeed = 1;
+    c->setup(c->param);
+    for (i = 0; i < ops; i++) {
+        start = benchNow();
+        c->op(i);
+        t = benchNow() - start;
+        mBenchLat[i] = t > mBenchClockNs ? t - mBenchClockNs : 0;
+    }
+    if (c->teardown)
+        c->teardown();
+
+    opsPerSec = total ? ops * 1000000000ULL / total : 0;
+    qsort(mBenchLat, ops, sizeof(*mBenchLat), benchCmpU32);
+    printf("bench: name=%s ops=%" PRIu32 " ops_per_s=%" PRIu64 " p50_ns=%" PRIu32 " p90_ns=%" PRIu32 " p99_ns=%" PRIu32 " max_ns=%" PRIu32 "\n",
+           c->name, ops, opsPerSec,
+           mBenchLat[ops / 2], mBenchLat[ops * 9 / 10], mBenchLat[ops * 99 / 100], mBenchLat[ops - 1]);
+}
+
+static bool benchStartTask(uint32_t taskId)
+{
+    const struct BenchCase *c;
+    uint64_t t;
+    uint32_t i;
+
+    if (!mBenchFilter)
+        return true;
+
+    //what reading the clock costs, to take out of the per-op times
+    for (i = 0; i < BENCH_OPS; i++) {
+        t = benchNow();
+        mBenchLat[i] = benchNow() - t;
+    }
+    qsort(mBenchLat, BENCH_OPS, sizeof(*mBenchLat), benchCmpU32);
+    mBenchClockNs = mBenchLat[BENCH_OPS / 2];
+
+    printf("bench: clock_ns=%" PRIu64 "\n", mBenchClockNs);
+    if (mBenchTracePath && !benchHeapTraceLoad(mBenchTracePath))
+        printf("bench: trace=%s error=load\n", mBenchTracePath);
+    for (i = 0; i < sizeof(mBenchCases) / sizeof(*mBenchCases); i++) {
+        c = &mBenchCases[i];
+        if (!strcmp(mBenchFilter, "all") || !strncmp(c->name, mBenchFilter, strlen(mBenchFilter)))
+            benchRunCase(c);
+    }
+    fflush(stdout);
+
+    exit(0);
+}
+
+static void benchEndTask(void)
+{
+}
+
+static void benchHandleEvent(uint32_t evtType, const void* evtData)
+{
+}
+
+INTERNAL_APP_INIT(BENCH_APP_ID, BENCH_APP_VERSION, benchStartTask, benchEndTask, benchHandleEvent);
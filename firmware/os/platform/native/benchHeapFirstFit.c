@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The first-fit heap, built a second time under other names and with a heap array
+ * of its own, so that bench.c can measure it whatever the OS was built with.
+ */
+
+#undef HEAP_TLSF
+
+#define heapInit            benchHeapFirstFitInit
+#define heapAlloc           benchHeapFirstFitAlloc
+#define heapFree            benchHeapFirstFitFree
+#define heapFreeAll         benchHeapFirstFitFreeAll
+#define heapGetStats        benchHeapFirstFitGetStats
+#define heapGetTaskStats    benchHeapFirstFitGetTaskStats
+
+#include "../../core/heap.c"
+
+#include <plat/bench.h>
+
+const struct BenchHeap gBenchHeapFirstFit = {
+    .name = "firstfit",
+    .init = heapInit,
+    .alloc = heapAlloc,
+    .free = heapFree,
+    .getStats = heapGetStats,
+};
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The TLSF heap, built a second time under other names and with a heap array
+ * of its own, so that bench.c can measure it whatever the OS was built with.
+ */
+
+#undef HEAP_TLSF
+#define HEAP_TLSF
+
+#define heapInit            benchHeapTlsfInit
+#define heapAlloc           benchHeapTlsfAlloc
+#define heapFree            benchHeapTlsfFree
+#define heapFreeAll         benchHeapTlsfFreeAll
+#define heapGetStats        benchHeapTlsfGetStats
+#define heapGetTaskStats    benchHeapTlsfGetTaskStats
+
+#include "../../core/heap.c"
+
+#include <plat/bench.h>
+
+const struct BenchHeap gBenchHeapTlsf = {
+    .name = "tlsf",
+    .init = heapInit,
+    .alloc = heapAlloc,
+    .free = heapFree,
+    .getStats = heapGetStats,
+};
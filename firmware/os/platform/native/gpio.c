@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stddef.h>
+#include <gpio.h>
+
+//a host has no GPIOs; requests fail, and the rest do nothing
+
+struct Gpio* gpioRequest(uint32_t gpioNum)
+{
+    return NULL;
+}
+
+void gpioRelease(struct Gpio* __restrict gpio)
+{
+}
+
+void gpioConfigInput(const struct Gpio* __restrict gpio, int32_t gpioSpeed, enum GpioPullMode pull)
+{
+}
+
+void gpioConfigOutput(const struct Gpio* __restrict gpio, int32_t gpioSpeed, enum GpioPullMode pull, enum GpioOpenDrainMode odrMode, bool value)
+{
+}
+
+void gpioConfigAlt(const struct Gpio* __restrict gpio, int32_t gpioSpeed, enum GpioPullMode pull, enum GpioOpenDrainMode odrMode, uint32_t altFunc)
+{
+}
+
+void gpioConfigAnalog(const struct Gpio* __restrict gpio)
+{
+}
+
+void gpioSet(const struct Gpio* __restrict gpio, bool value)
+{
+}
+
+bool gpioGet(const struct Gpio* __restrict gpio)
+{
+    return false;
+}
@@ -14,13 +14,319 @@
  * limitations under the License.
  */
 
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <plat/plat.h>
+#include <plat/sim.h>
+#include <cpu/irq.h>
+#include <cpu.h>
 #include <hostIntf.h>
 #include <hostIntf_priv.h>
+#include <nanohubPacket.h>
+
+/*
+ * The host interface is a byte stream carrying the same packets the AP sends over I2C/SPI:
+ * stdin/stdout, or one client at a time on a unix socket. Preamble bytes before the sync
+ * byte are skipped on the way in. An rx and a tx thread play the part of the bus driver;
+ * they call the completion callbacks with interrupts off, as a driver's ISR would.
+ * Lock order: cpu lock, then mCommLock.
+ */
+
+static const char *mSocketPath;
+static int mListenFd = -1;
+static int mInFd = -1, mOutFd = -1; /* current connection; -1 while there is none */
+static bool mStdioUsed;
+
+static pthread_t mRxThread, mTxThread;
+static pthread_mutex_t mCommLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mCommCond = PTHREAD_COND_INITIALIZER;
+
+static void *mRxBuf;
+static size_t mRxSize;
+static HostIntfCommCallbackF mRxCallback; /* set while a receive is armed */
+
+static const void *mTxBuf;
+static size_t mTxSize;
+static HostIntfCommCallbackF mTxCallback; /* set while a transmit is pending */
+
+void platHostIntfUseSocket(const char *path)
+{
+    mSocketPath = path;
+}
+
+static void hostIntfNativeDisconnect(void)
+{
+    pthread_mutex_lock(&mCommLock);
+    if (mSocketPath && mInFd >= 0)
+        close(mInFd);
+    mInFd = mOutFd = -1;
+    pthread_mutex_unlock(&mCommLock);
+}
+
+static bool hostIntfNativeConnect(void)
+{
+    int fd;
+
+    if (!mSocketPath) {
+        //stdin is only good once
+        if (!mStdioUsed) {
+            mStdioUsed = true;
+            pthread_mutex_lock(&mCommLock);
+            mInFd = STDIN_FILENO;
+            mOutFd = STDOUT_FILENO;
+            pthread_mutex_unlock(&mCommLock);
+            return true;
+        }
+        return false;
+    }
+
+    do {
+        fd = accept(mListenFd, NULL, NULL);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0)
+        return false;
+
+    pthread_mutex_lock(&mCommLock);
+    mInFd = mOutFd = fd;
+    pthread_mutex_unlock(&mCommLock);
+
+    return true;
+}
+
+static bool hostIntfNativeRead(int fd, uint8_t *buf, size_t len)
+{
+    ssize_t ret;
+
+    while (len) {
+        ret = read(fd, buf, len);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return false;
+        buf += ret;
+        len -= ret;
+    }
+
+    return true;
+}
+
+static bool hostIntfNativeWrite(int fd, const uint8_t *buf, size_t len)
+{
+    ssize_t ret;
+
+    while (len) {
+        ret = write(fd, buf, len);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return false;
+        buf += ret;
+        len -= ret;
+    }
+
+    return true;
+}
+
+//one packet, sync byte first; false if the connection went away
+static bool hostIntfNativeReadPacket(int fd, uint8_t *pkt, size_t *sizeP)
+{
+    struct NanohubPacket *hdr = (struct NanohubPacket *)pkt;
+
+    do {
+        if (!hostIntfNativeRead(fd, pkt, 1))
+            return false;
+    } while (pkt[0] != NANOHUB_SYNC_BYTE);
+
+    if (!hostIntfNativeRead(fd, pkt + 1, sizeof(*hdr) - 1))
+        return false;
+    if (!hostIntfNativeRead(fd, pkt + sizeof(*hdr), hdr->len + sizeof(struct NanohubPacketFooter)))
+        return false;
+
+    *sizeP = NANOHUB_PACKET_SIZE(hdr->len);
+
+    return true;
+}
+
+//pulse the AP's wakeup line to us; hostIntf restarts rx on the trailing edge
+static void hostIntfNativeWakeupPulse(void)
+{
+    uint64_t intSta = cpuIntsOff();
+
+    hostIntfRxPacket(true);
+    hostIntfRxPacket(false);
+    cpuIrqRaise();
+    cpuIntsRestore(intSta);
+}
+
+static void *hostIntfNativeRxThread(void *unused)
+{
+    static uint8_t pkt[NANOHUB_PACKET_SIZE_MAX];
+    HostIntfCommCallbackF callback;
+    size_t size;
+    uint64_t intSta;
+    bool armed;
+    int fd;
+
+    while (hostIntfNativeConnect()) {
+        pthread_mutex_lock(&mCommLock);
+        fd = mInFd;
+        pthread_mutex_unlock(&mCommLock);
+
+        while (hostIntfNativeReadPacket(fd, pkt, &size)) {
+            pthread_mutex_lock(&mCommLock);
+            armed = mRxCallback != NULL;
+            pthread_mutex_unlock(&mCommLock);
+
+            //not listening: do what the AP does, toggle the wakeup line
+            if (!armed)
+                hostIntfNativeWakeupPulse();
+
+            //wait for hostIntf to ask for the packet
+            pthread_mutex_lock(&mCommLock);
+            while (!mRxCallback)
+                pthread_cond_wait(&mCommCond, &mCommLock);
+            if (size > mRxSize)
+                size = mRxSize;
+            memcpy(mRxBuf, pkt, size);
+            callback = mRxCallback;
+            mRxCallback = NULL;
+            pthread_mutex_unlock(&mCommLock);
+
+            intSta = cpuIntsOff();
+            callback(size, 0);
+            cpuIrqRaise();
+            cpuIntsRestore(intSta);
+        }
+
+        hostIntfNativeDisconnect();
+    }
+
+    //nobody will ever talk to us again
+    exit(0);
+
+    return NULL;
+}
+
+static void *hostIntfNativeTxThread(void *unused)
+{
+    HostIntfCommCallbackF callback;
+    const void *buf;
+    size_t size;
+    uint64_t intSta;
+    int fd;
+
+    pthread_mutex_lock(&mCommLock);
+    while (true) {
+        while (!mTxCallback)
+            pthread_cond_wait(&mCommCond, &mCommLock);
+        buf = mTxBuf;
+        size = mTxSize;
+        callback = mTxCallback;
+        mTxCallback = NULL;
+        fd = mOutFd;
+        pthread_mutex_unlock(&mCommLock);
+
+        //with nobody connected, replies go nowhere; the AP would not have clocked them out either
+        if (fd >= 0)
+            hostIntfNativeWrite(fd, buf, size);
 
+        intSta = cpuIntsOff();
+        callback(size, 0);
+        cpuIrqRaise();
+        cpuIntsRestore(intSta);
+
+        pthread_mutex_lock(&mCommLock);
+    }
+
+    return NULL;
+}
 
-I2cBus platHostIntfI2cBus(void)
+static int hostIntfNativeRequest(void)
 {
-    return PLATFORM_HOST_INTF_I2C_BUS;
+    struct sockaddr_un addr;
+
+    if (mSocketPath) {
+        if (strlen(mSocketPath) >= sizeof(addr.sun_path))
+            return -ENAMETOOLONG;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, mSocketPath, sizeof(addr.sun_path) - 1);
+
+        mListenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (mListenFd < 0)
+            return -errno;
+        unlink(mSocketPath);
+        if (bind(mListenFd, (struct sockaddr *)&addr, sizeof(addr)) || listen(mListenFd, 1)) {
+            close(mListenFd);
+            mListenFd = -1;
+            return -errno;
+        }
+    }
+
+    if (pthread_create(&mTxThread, NULL, hostIntfNativeTxThread, NULL))
+        return -EAGAIN;
+    if (pthread_create(&mRxThread, NULL, hostIntfNativeRxThread, NULL))
+        return -EAGAIN;
+
+    return 0;
+}
+
+static int hostIntfNativeRxPacket(void *rxBuf, size_t rxSize, HostIntfCommCallbackF callback)
+{
+    pthread_mutex_lock(&mCommLock);
+    mRxBuf = rxBuf;
+    mRxSize = rxSize;
+    mRxCallback = callback;
+    pthread_cond_broadcast(&mCommCond);
+    pthread_mutex_unlock(&mCommLock);
+
+    return 0;
+}
+
+static int hostIntfNativeTxPacket(const void *txBuf, size_t txSize, HostIntfCommCallbackF callback)
+{
+    pthread_mutex_lock(&mCommLock);
+    mTxBuf = txBuf;
+    mTxSize = txSize;
+    mTxCallback = callback;
+    pthread_cond_broadcast(&mCommCond);
+    pthread_mutex_unlock(&mCommLock);
+
+    return 0;
+}
+
+static int hostIntfNativeRelease(void)
+{
+    pthread_mutex_lock(&mCommLock);
+    mRxCallback = NULL;
+    mTxCallback = NULL;
+    pthread_mutex_unlock(&mCommLock);
+
+    return 0;
+}
+
+static const struct HostIntfComm mNativeComm = {
+   .request = hostIntfNativeRequest,
+   .rxPacket = hostIntfNativeRxPacket,
+   .txPacket = hostIntfNativeTxPacket,
+   .release = hostIntfNativeRelease,
+};
+
+const struct HostIntfComm *platHostIntfInit()
+{
+    if (simActive())
+        return simHostIntfInit();
+
+    return &mNativeComm;
 }
 
 uint16_t platHwType(void)
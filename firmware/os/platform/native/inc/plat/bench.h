@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LINUX_BENCH_H_
+#define _LINUX_BENCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Core OS micro-benchmarks. When requested, they run once the OS is up, print
+ * "bench: key=value" lines on stdout and exit. The list is in bench.c.
+ */
+
+void benchRequest(const char *filter); //call before osMain(); "all" or a name prefix
+void benchHeapTrace(const char *path); //heap ops for heap_trace_*, as the sim's "heaptrace" writes them
+
+struct HeapStats;
+
+//a heap backend of its own for the heap cases, whichever one the OS uses
+struct BenchHeap {
+    const char *name;
+    bool (*init)(void);
+    void* (*alloc)(uint32_t sz);
+    void (*free)(void *ptr);
+    bool (*getStats)(struct HeapStats *stats);
+};
+
+extern const struct BenchHeap gBenchHeapFirstFit; //benchHeapFirstFit.c
+extern const struct BenchHeap gBenchHeapTlsf;     //benchHeapTlsf.c
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _PLAT_BL_H_
+#define _PLAT_BL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* there is no bootloader; platform.c provides the api table, backed by RAM instead of flash */
+
+#define BL_FLASH_KEY1       0x45670123
+#define BL_FLASH_KEY2       0xCDEF89AB
+
+struct BlVecTable {
+    uint32_t    unused;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _PLAT_BL_H_
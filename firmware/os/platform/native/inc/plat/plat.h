@@ -21,10 +21,31 @@
 extern "C" {
 #endif
 
-static inline void platWake(void)
+#include <stdint.h>
+#include <stdbool.h>
+#include <seos.h>
+
+static inline const struct AppHdr* platGetInternalAppList(uint32_t *numAppsP)
 {
+    extern const struct AppHdr __internal_app_start, __internal_app_end;
+
+    *numAppsP = &__internal_app_end - &__internal_app_start;
+    return &__internal_app_start;
 }
 
+//the shared area and eedata live in RAM; they do not survive a restart
+uint8_t* platGetSharedAreaInfo(uint32_t *areaSzP);
+uint32_t* platGetEeDataArea(uint32_t *areaSzP);
+
+//wakes the OS thread out of platSleep(); callable from any host thread
+void platWake(void);
+
+//platLogPutcharF() writes to stderr, so tokenized logs are mirrored there as text
+#define PLAT_LOG_CHARS
+
+//serve the host interface on a unix socket at this path instead of stdin/stdout; call before osMain()
+void platHostIntfUseSocket(const char *path);
+
 #ifdef __cplusplus
 }
 #endif
@@ -21,7 +21,12 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
 
+static inline uint32_t pwrResetReason(void)
+{
+    return 0;
+}
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LINUX_SIM_H_
+#define _LINUX_SIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Virtual-time simulation. With a scenario loaded, time stands still while the OS runs
+ * and jumps to the next timer alarm or simulated interrupt when it sleeps: no threads,
+ * no wall clock, and the same scenario always gives the same run. Scenario syntax is
+ * described in sim.c.
+ */
+
+struct HostIntfComm;
+
+bool simLoad(const char *path); //call before osMain(); false if the scenario is bad
+bool simActive(void);
+
+//platform hooks, only called when simActive()
+uint64_t simGetTime(void);
+void simSetAlarm(uint64_t wakeupTime);
+void simSleep(void);
+void simApInt(bool wakeup, bool on);
+const struct HostIntfComm *simHostIntfInit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
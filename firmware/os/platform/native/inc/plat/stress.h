@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LINUX_STRESS_H_
+#define _LINUX_STRESS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+/*
+ * Multi-threaded stress tests of the OS primitives that may be called from any
+ * context. When requested, they run once the OS is up, print one "stress: " line
+ * per case and exit non-zero if any case failed. The list is in stress.c.
+ */
+
+void stressRequest(const char *filter); //call before osMain(); "all" or a name prefix
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,7 +21,17 @@
 extern "C" {
 #endif
 
-void wdtInit(){}
+static inline void wdtInit(void)
+{
+}
+
+static inline void wdtEnableClk(void)
+{
+}
+
+static inline void wdtDisableClk(void)
+{
+}
 
 #ifdef __cplusplus
 }
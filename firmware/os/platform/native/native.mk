@@ -14,32 +14,63 @@
 # limitations under the License.
 #
 
-DELIVERABLES = $(APP).bin
+#no bootloader; the OS image is a host executable
+BL_FILE =
+OS_FILE = $(OUT)/os.checked.elf
+
+DELIVERABLES += $(OS_FILE)
 LKR = os/platform/$(PLATFORM)/lkr/native.extra.lkr
 
 FLAGS += -I. -fno-unwind-tables -fstack-reuse=all -ffunction-sections -fdata-sections -m32
-FLAGS += -Wl,-T $(LKR) -Wl,--gc-sections
-
+FLAGS += -Wl,--gc-sections
+#no extra alignment on big objects: .internal_app_init must stay a plain array of AppHdrs
+FLAGS += -malign-data=abi
+OSFLAGS_os += -Wl,-T $(LKR) -pthread -lrt
 
 #platform drivers
-SRCS += os/platform/$(PLATFORM)/platform.c \
+SRCS_os += os/platform/$(PLATFORM)/platform.c \
 	os/platform/$(PLATFORM)/i2c.c \
 	os/platform/$(PLATFORM)/spi.c \
 	os/platform/$(PLATFORM)/rtc.c \
-	os/platform/$(PLATFORM)/hostIntf.c
+	os/platform/$(PLATFORM)/hostIntf.c \
+	os/platform/$(PLATFORM)/eeData.c \
+	os/platform/$(PLATFORM)/crc.c \
+	os/platform/$(PLATFORM)/gpio.c \
+	os/platform/$(PLATFORM)/apInt.c \
+	os/platform/$(PLATFORM)/sim.c \
+	os/platform/$(PLATFORM)/bench.c \
+	os/platform/$(PLATFORM)/benchHeapFirstFit.c \
+	os/platform/$(PLATFORM)/benchHeapTlsf.c \
+	os/platform/$(PLATFORM)/stress.c
+
+#the bootloader api table is ours, so are the crypto bits it points to
+SRCS_os += ../lib/nanohub/sha2.c ../lib/nanohub/rsa.c ../lib/nanohub/aes.c
 
 #extra deps
 DEPS += $(wildcard os/platform/$(PLATFORM)/inc/plat/*.h)
 DEPS += $(LKR)
 
 #platform flags
-FLAGS += -DPLATFORM_HOST_INTF_I2C_BUS=0
-FLAGS += -DPLATFORM_HW_TYPE=0x8086 -DPLATFORM_HW_VER=0
-FLAGS += -DPLAT_HAS_NO_U_TYPES_H
+FLAGS += -DPLATFORM_HW_VER=0
+FLAGS += -DFORCE_HEAP_IN_DOT_DATA
+
+#core micro-benchmarks, "bench: key=value" lines on stdout; the heap trace is from scn/heaptrace.scn
+.PHONY: bench
+bench: $(OS_FILE)
+	$(OS_FILE) -b all -r os/platform/$(PLATFORM)/scn/heap.trace
 
-#platform-specific rules
+#the example scenarios, in virtual time; fails if any of them misses one of its "expect" lines
+SIM_SCNS = $(filter-out %/heaptrace.scn,$(wildcard os/platform/$(PLATFORM)/scn/*.scn))
+.PHONY: sim
+sim: $(OS_FILE)
+	@for s in $(SIM_SCNS); do \
+		out=`$(OS_FILE) -v $$s 2>/dev/null` || { echo "$$out" | grep "^sim: expect"; echo "sim: $$s FAILED"; exit 1; }; \
+		echo "sim: $$s ok"; \
+	done
 
-%.bin : %.elf
-	cp $< $@
+#multi-threaded stress tests, "stress: " lines on stdout; fails if any case does
+.PHONY: stress
+stress: $(OS_FILE)
+	$(OS_FILE) -t all
 
 $(info Included NATIVE platfrom)
@@ -15,49 +15,205 @@
  */
 
 #include <plat/rtc.h>
+#include <plat/plat.h>
+#include <plat/bench.h>
+#include <plat/sim.h>
+#include <plat/stress.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
 #include <unistd.h>
+#include <nanohub/sha2.h>
+#include <nanohub/rsa.h>
+#include <nanohub/aes.h>
+#include <cpu/irq.h>
 #include <platform.h>
 #include <seos.h>
 #include <timer.h>
-#include <usart.h>
-#include <gpio.h>
-#include <seos.h>
 #include <mpu.h>
 #include <cpu.h>
+#include <bl.h>
+
+#define SHARED_AREA_SZ      (256 * 1024)
+#define EEDATA_AREA_SZ      (32 * 1024)
+
+/*
+ * The OS runs on the main thread. "Interrupts" come from other host threads: the alarm
+ * thread below stands in for the wakeup timer, hostIntf.c has the rest. All of them take
+ * the cpu lock (cpuIntsOff()) before touching OS state. Lock order: cpu lock, then ours.
+ */
+static pthread_t mAlarmThread;
+static pthread_mutex_t mAlarmLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mAlarmCond;
+static uint64_t mAlarmTime; /* in platGetTicks() time; 0 = no alarm */
+static uint64_t mStartTime; /* CLOCK_MONOTONIC at boot, in ns */
+static char **mArgv;
+
+/* flash stand-ins; erased flash reads as all ones */
+static uint8_t mSharedArea[SHARED_AREA_SZ] __attribute__((aligned(4))) = { [0 ... SHARED_AREA_SZ - 1] = 0xFF };
+static uint32_t mEeData[EEDATA_AREA_SZ / sizeof(uint32_t)] = { [0 ... EEDATA_AREA_SZ / sizeof(uint32_t) - 1] = 0xFFFFFFFF };
+
+static uint64_t platMonotonicNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *platAlarmThread(void *unused)
+{
+    struct timespec ts;
+    uint64_t when, intSta;
+
+    pthread_mutex_lock(&mAlarmLock);
+    while (true) {
+        when = mAlarmTime;
+        if (!when) {
+            pthread_cond_wait(&mAlarmCond, &mAlarmLock);
+        } else if (platGetTicks() < when) {
+            when += mStartTime;
+            ts.tv_sec = when / 1000000000ULL;
+            ts.tv_nsec = when % 1000000000ULL;
+            pthread_cond_timedwait(&mAlarmCond, &mAlarmLock, &ts);
+        } else {
+            mAlarmTime = 0;
+            pthread_mutex_unlock(&mAlarmLock);
+
+            //the "timer interrupt"; it may well set up the next alarm
+            intSta = cpuIntsOff();
+            timIntHandler();
+            cpuIrqRaise();
+            cpuIntsRestore(intSta);
 
+            pthread_mutex_lock(&mAlarmLock);
+        }
+    }
+
+    return NULL;
+}
 
 void platUninitialize(void)
 {
-    //TODO
+}
+
+void platReset(void)
+{
+    //start over as a fresh process; RAM-backed "flash" does not survive this
+    fflush(stdout);
+    fflush(stderr);
+    if (mArgv)
+        execv("/proc/self/exe", mArgv);
+    exit(1);
 }
 
 void platSleep(void)
 {
-    //TODO
+    if (simActive())
+        simSleep();
+    else
+        cpuIrqWait();
+}
+
+void platWake(void)
+{
+    cpuIrqRaise();
 }
 
-void platLogPutchar(char ch)
+void *platLogAllocUserData()
+{
+    return NULL;
+}
+
+bool platLogPutcharF(void *userData, char ch)
+{
+    return fputc(ch, stderr) != EOF;
+}
+
+bool platLogPutbytesF(void *userData, const void *data, uint32_t len)
+{
+    //binary logs only make sense in the host log buffer, which we do not have
+    return false;
+}
+
+void platLogFlush(void *userData)
+{
+    fflush(stderr);
+}
+
+void platEarlyLogFlush(void)
 {
-     putchar(ch);
 }
 
 void platInitialize(void)
 {
+    pthread_condattr_t attr;
+
+    mStartTime = platMonotonicNs();
+
+    //simulated time needs no alarm thread: nothing happens while the OS runs
+    if (simActive()) {
+        rtcInit();
+        return;
+    }
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&mAlarmCond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&mAlarmThread, NULL, platAlarmThread, NULL)) {
+        fprintf(stderr, "failed to start the alarm thread\n");
+        exit(1);
+    }
+
     /* set up RTC */
     rtcInit();
-
-    //TODO
 }
 
 uint64_t platGetTicks(void)
 {
-    //TODO
+    if (simActive())
+        return simGetTime();
 
-    return 0;
+    return platMonotonicNs() - mStartTime;
+}
+
+bool platSleepClockRequest(uint64_t wakeupTime, uint32_t maxJitterPpm, uint32_t maxDriftPpm, uint32_t maxErrTotalPpm)
+{
+    if (wakeupTime && wakeupTime <= platGetTicks())
+        return false;
+
+    if (simActive()) {
+        simSetAlarm(wakeupTime);
+        return true;
+    }
+
+    pthread_mutex_lock(&mAlarmLock);
+    mAlarmTime = wakeupTime;
+    pthread_cond_signal(&mAlarmCond);
+    pthread_mutex_unlock(&mAlarmLock);
+
+    return true;
+}
+
+bool platRequestDevInSleepMode(uint32_t sleepDevID, uint32_t maxWakeupTime)
+{
+    return true;
+}
+
+bool platAdjustDevInSleepMode(uint32_t sleepDevID, uint32_t maxWakeupTime)
+{
+    return true;
+}
+
+bool platReleaseDevInSleepMode(uint32_t sleepDevID)
+{
+    return true;
 }
 
 uint32_t platFreeResources(uint32_t tid)
@@ -69,8 +225,189 @@ void platPeriodic()
 {
 }
 
+uint8_t* platGetSharedAreaInfo(uint32_t *areaSzP)
+{
+    *areaSzP = sizeof(mSharedArea);
+    return mSharedArea;
+}
+
+uint32_t* platGetEeDataArea(uint32_t *areaSzP)
+{
+    *areaSzP = sizeof(mEeData);
+    return mEeData;
+}
+
+/* no MPU on a host */
+void mpuStart(void)
+{
+}
+
+void mpuAllowRamExecution(bool allowSvcExecute)
+{
+}
+
+void mpuAllowRomWrite(bool allowSvcWrite)
+{
+}
+
+void mpuShow(void)
+{
+}
+
+/* bootloader api table: "flash" is RAM, and programming can only clear bits, like NOR flash */
+static uint32_t blNativeGetVersion(void)
+{
+    return BL_VERSION_CUR;
+}
+
+static void blNativeGetSnum(uint32_t *snum, uint32_t length)
+{
+    memset(snum, 0, length * sizeof(uint32_t));
+}
+
+static bool blNativeProgram(uint8_t *dst, const uint8_t *src, uint32_t length, uint32_t key1, uint32_t key2, uint8_t *start, uint32_t size)
+{
+    uint32_t i;
+
+    if (key1 != BL_FLASH_KEY1 || key2 != BL_FLASH_KEY2)
+        return false;
+    if (dst < start || length > size || dst - start > size - length)
+        return false;
+
+    for (i = 0; i < length; i++)
+        dst[i] &= src[i];
+
+    return true;
+}
+
+static bool blNativeProgramShared(uint8_t *dst, const uint8_t *src, uint32_t length, uint32_t key1, uint32_t key2)
+{
+    return blNativeProgram(dst, src, length, key1, key2, mSharedArea, sizeof(mSharedArea));
+}
+
+static bool blNativeEraseShared(uint32_t key1, uint32_t key2)
+{
+    if (key1 != BL_FLASH_KEY1 || key2 != BL_FLASH_KEY2)
+        return false;
+
+    memset(mSharedArea, 0xFF, sizeof(mSharedArea));
+
+    return true;
+}
+
+static bool blNativeProgramEe(uint8_t *dst, const uint8_t *src, uint32_t length, uint32_t key1, uint32_t key2)
+{
+    return blNativeProgram(dst, src, length, key1, key2, (uint8_t*)mEeData, sizeof(mEeData));
+}
+
+static const uint32_t* blNativeGetPubKeysInfo(uint32_t *numKeys)
+{
+    //no keys: nothing is signed for us
+    *numKeys = 0;
+    return NULL;
+}
+
+static const uint32_t* blNativeSigPaddingVerify(const uint32_t *rsaResult)
+{
+    uint32_t i;
+
+    //all but first and last word of padding MUST have no zero bytes
+    for (i = SHA2_HASH_WORDS + 1; i < RSA_WORDS - 1; i++) {
+        if (!(uint8_t)(rsaResult[i] >>  0))
+            return NULL;
+        if (!(uint8_t)(rsaResult[i] >>  8))
+            return NULL;
+        if (!(uint8_t)(rsaResult[i] >> 16))
+            return NULL;
+        if (!(uint8_t)(rsaResult[i] >> 24))
+            return NULL;
+    }
+
+    //first padding word must have all nonzero bytes except low byte
+    if ((rsaResult[SHA2_HASH_WORDS] & 0xff) || !(rsaResult[SHA2_HASH_WORDS] & 0xff00) || !(rsaResult[SHA2_HASH_WORDS] & 0xff0000) || !(rsaResult[SHA2_HASH_WORDS] & 0xff000000))
+        return NULL;
+
+    //last padding word must have 0x0002 in top 16 bits and nonzero random bytes in lower bytes
+    if ((rsaResult[RSA_WORDS - 1] >> 16) != 2)
+        return NULL;
+    if (!(rsaResult[RSA_WORDS - 1] & 0xff00) || !(rsaResult[RSA_WORDS - 1] & 0xff))
+        return NULL;
+
+    return rsaResult;
+}
+
+static uint32_t blNativeVerifyOsUpdate(void)
+{
+    //the OS is this executable; it cannot be updated in place
+    return OS_UPDT_HDR_CHECK_FAILED;
+}
+
+struct BlTable _BL = {
+    .api = {
+        .blGetVersion = blNativeGetVersion,
+        .blReboot = platReset,
+        .blGetSnum = blNativeGetSnum,
+        .blProgramShared = blNativeProgramShared,
+        .blEraseShared = blNativeEraseShared,
+        .blProgramEe = blNativeProgramEe,
+        .blGetPubKeysInfo = blNativeGetPubKeysInfo,
+        .blRsaPubOpIterative = rsaPubOpIterative,
+        .blSha2init = sha2init,
+        .blSha2processBytes = sha2processBytes,
+        .blSha2finish = sha2finish,
+        .blAesInitForEncr = aesInitForEncr,
+        .blAesInitForDecr = aesInitForDecr,
+        .blAesEncr = aesEncr,
+        .blAesDecr = aesDecr,
+        .blAesCbcInitForEncr = aesCbcInitForEncr,
+        .blAesCbcInitForDecr = aesCbcInitForDecr,
+        .blAesCbcEncr = aesCbcEncr,
+        .blAesCbcDecr = aesCbcDecr,
+        .blSigPaddingVerify = blNativeSigPaddingVerify,
+        .blVerifyOsUpdate = blNativeVerifyOsUpdate,
+    },
+};
+
+static void platUsage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-s <socket path>] [-v <scenario>] [-b all|<name prefix> [-r <heap trace>]] [-t all|<name prefix>]\n"
+                    "  host interface is on stdin/stdout unless a unix socket path is given\n"
+                    "  with a scenario, runs it in virtual time and prints the counters (see sim.c)\n"
+                    "  -b runs the core micro-benchmarks and prints the results (see bench.c)\n"
+                    "  -r gives them heap ops to replay, as the scenario command \"heaptrace\" records them\n"
+                    "  -t runs the multi-threaded stress tests, fails if any of them does (see stress.c)\n", name);
+}
+
 int main(int argc, char** argv)
 {
+    int opt;
+
+    mArgv = argv;
+
+    while ((opt = getopt(argc, argv, "s:v:b:r:t:")) != -1) {
+        switch (opt) {
+        case 's':
+            platHostIntfUseSocket(optarg);
+            break;
+        case 'v':
+            if (!simLoad(optarg))
+                return 1;
+            break;
+        case 'b':
+            benchRequest(optarg);
+            break;
+        case 'r':
+            benchHeapTrace(optarg);
+            break;
+        case 't':
+            stressRequest(optarg);
+            break;
+        default:
+            platUsage(argv[0]);
+            return 1;
+        }
+    }
+
     osMain();
 
     return 0;
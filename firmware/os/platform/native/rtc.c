@@ -37,5 +37,5 @@ int rtcSetWakeupTimer(uint64_t delay, int ppm)
 
 uint64_t rtcGetTime(void)
 {
-    return 0;
+    return platGetTicks();
 }
@@ -0,0 +1,1011 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <plat/sim.h>
+#include <eventnums.h>
+#include <hostIntf.h>
+#include <hostIntf_priv.h>
+#include <nanohubPacket.h>
+#include <nanohub/crc.h>
+#include <sensors.h>
+#include <seos.h>
+#include <slab.h>
+#include <timer.h>
+#include <trace.h>
+
+/*
+ * Scenario file: one command per line, '#' starts a comment, times are in ms of device time.
+ *
+ *   duration <ms>                                  how long to run; required
+ *   sensor <type> <odr-hz> [<axes> [<fifo> [wakeup] [dropflush]]]
+ *                                                  a sensor of that type doing odr/8 .. odr Hz, with
+ *                                                  1 or 3 axes (default 3) and a fifo of up to 64
+ *                                                  samples (default 1): its data-ready interrupt
+ *                                                  fires as often as the requested latency allows;
+ *                                                  "dropflush": its driver accepts the first flush
+ *                                                  it gets but never sends the marker for it
+ *   enable <at-ms> <type> <rate-hz> <latency-ms> [compress]
+ *                                                  the AP enables a sensor, optionally asking for
+ *                                                  compressed samples
+ *   disable <at-ms> <type>                         the AP disables it
+ *   flush <at-ms> <type>                           the AP flushes it
+ *   read <period-ms>                               the AP drains the hub this often
+ *   apwake <latency-us>                            the AP wakes up on the rising edge of the wakeup
+ *                                                  interrupt and drains the hub after this long
+ *   bus <ns-per-byte>                              host link speed; default 2500 (3.2 Mbit/s)
+ *   bulk <max-bytes>                               the AP drains with READ_EVENTS of up to this
+ *                                                  many bytes instead of READ_EVENT
+ *   expect <counter> <=|>=|== <n>                  the run fails, exit status 1, unless the counter
+ *                                                  printed at the end compares so
+ *   heaptrace <file>                               turn tracing on and write the heap records the
+ *                                                  AP gets to the file, one op per line, for
+ *                                                  "bench -r": "a <block> <size> <tid>",
+ *                                                  "f <block>" and "F <tid>" for heapFreeAll();
+ *                                                  trace records lost on the way are noted in it
+ *
+ * The AP model sends one request at a time, a new one when the last got its answer, NAK or
+ * timed out; "drains" means reads until one comes back with no events. The OS itself takes
+ * no time: what it does in response to an interrupt is done at the instant the interrupt came.
+ * Counters are printed on stdout as "sim: key=value" lines at the end, so two runs of the
+ * same scenario can be diffed; the wall clock time goes to stderr. A missed expectation
+ * adds a "sim: expect <counter> ... failed" line. The scenarios in scn/ are run by
+ * "make sim".
+ */
+
+#define SIM_APP_ID              APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 30)
+#define SIM_APP_VERSION         1
+
+#define SIM_MAX_SENSORS         8
+#define SIM_MAX_CMDS            256
+#define SIM_MAX_EXPECTS         32
+#define SIM_KEY_MAX             32
+#define SIM_MAX_FIFO            64
+#define SIM_NUM_RATES           4
+#define SIM_EVTS_PER_SENSOR     4
+#define SIM_LINE_MAX            256
+#define SIM_NS_PER_BYTE         2500
+#define SIM_HOST_RETRY          50000ULL    /* ns; AP retries a request the hub was not ready for */
+#define SIM_HOST_TIMEOUT        10000000ULL /* ns; AP gives up on a request */
+#define SIM_TIME_NONE           UINT64_MAX
+
+/* as in hostIntf.c */
+#define SIM_CONFIG_CMD_DISABLE   0
+#define SIM_CONFIG_CMD_ENABLE    1
+#define SIM_CONFIG_CMD_FLUSH     2
+#define SIM_CONFIG_FLAG_COMPRESS 0x0001
+
+SET_PACKED_STRUCT_MODE_ON
+struct SimConfigRequest {
+    uint32_t evtType;
+    //struct ConfigCmd in hostIntf.c
+    uint64_t latency;
+    uint32_t rate;
+    uint8_t sensType;
+    uint8_t cmd;
+    uint16_t flags;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+struct SimCmd {
+    uint64_t time;
+    uint64_t latency;
+    uint32_t rate;
+    uint8_t sensType;
+    uint8_t cmd;
+    uint16_t flags;
+};
+
+struct SimExpect {
+    char key[SIM_KEY_MAX];
+    char op;            /* '<': at most, '>': at least, '=': exactly */
+    uint64_t val;
+    bool seen;
+};
+
+struct SimSensor {
+    struct SensorInfo info;
+    uint32_t rates[SIM_NUM_RATES + 1];
+    struct SlabAllocator *evtSlab;
+    uint32_t handle;
+    uint32_t odr;
+    uint32_t fifo;
+    uint32_t watermark;
+    uint64_t period;    /* ns between samples at the current rate */
+    uint64_t nextIrq;   /* SIM_TIME_NONE while not sampling */
+    uint64_t sampleNum;
+    bool on;
+    bool dropFlush;
+
+    uint64_t irqs, samples, dropped; /* dropped: no event buffer; hostIntf adds its own at the end */
+    uint64_t flushes;                /* flush markers the AP got */
+};
+
+static bool mSimActive;
+static uint64_t mSimTime, mSimEnd, mSimAlarm = SIM_TIME_NONE;
+static uint64_t mSimWallStart;
+
+static struct SimSensor mSimSensors[SIM_MAX_SENSORS];
+static uint32_t mSimNumSensors;
+
+/* script; mCmds[mCmdSent .. mCmdDue - 1] are due but not yet sent by the AP */
+static struct SimCmd mSimCmds[SIM_MAX_CMDS];
+static uint32_t mSimNumCmds, mSimCmdDue, mSimCmdSent;
+
+static struct SimExpect mSimExpects[SIM_MAX_EXPECTS];
+static uint32_t mSimNumExpects, mSimFailed;
+
+/* AP */
+static uint32_t mHostNsPerByte = SIM_NS_PER_BYTE;
+static uint64_t mHostReadPeriod, mHostNextRead = SIM_TIME_NONE;
+static uint64_t mHostWakeLatency, mHostNextWake = SIM_TIME_NONE;
+static bool mHostWakeOnInt;
+static bool mHostDrain;
+static uint32_t mHostBulkMax; /* 0: READ_EVENT */
+static bool mHostIntWakeup, mHostIntNonWakeup;
+static uint8_t mHostPkt[NANOHUB_PACKET_SIZE_MAX];
+static uint32_t mHostPktSize;
+static uint32_t mHostSeq;
+static uint32_t mHostReason; /* of the request in flight, 0 when there is none */
+static uint64_t mHostDeliver = SIM_TIME_NONE, mHostDeadline = SIM_TIME_NONE;
+static FILE *mHostHeapTrace;
+
+/* hub end of the bus */
+static void *mRxBuf;
+static size_t mRxSize;
+static HostIntfCommCallbackF mRxCallback;
+static const uint8_t *mTxBuf;
+static size_t mTxSize;
+static HostIntfCommCallbackF mTxCallback;
+static uint64_t mTxDone = SIM_TIME_NONE;
+
+static struct SimStats {
+    uint64_t wakeups, alarms;
+    uint64_t reads, emptyReads, readBytes, events, configs, naks, timeouts, badPackets, apWakeups, polls;
+    uint64_t heapTraceRecords, traceLost;
+} mSimStats;
+
+static uint64_t simWallNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+bool simActive(void)
+{
+    return mSimActive;
+}
+
+uint64_t simGetTime(void)
+{
+    return mSimTime;
+}
+
+void simSetAlarm(uint64_t wakeupTime)
+{
+    mSimAlarm = wakeupTime ? wakeupTime : SIM_TIME_NONE;
+}
+
+static struct SimSensor *simSensorFind(uint32_t type)
+{
+    uint32_t i;
+
+    for (i = 0; i < mSimNumSensors; i++)
+        if (mSimSensors[i].info.sensorType == type)
+            return &mSimSensors[i];
+
+    return NULL;
+}
+
+/* sensors */
+
+//hand over the n oldest samples in the fifo; it holds watermark of them at nextIrq
+static void simSensorRead(struct SimSensor *s, uint32_t n)
+{
+    struct SingleAxisDataEvent *single;
+    struct TripleAxisDataEvent *triple;
+    struct SensorFirstSample *first;
+    uint64_t last = s->nextIrq - s->period * (s->watermark - n);
+    uint32_t i;
+    void *ev;
+
+    s->samples += n;
+    s->nextIrq += s->period * n;
+
+    ev = osEvtBufSlabAlloc(s->evtSlab);
+    if (!ev) {
+        s->dropped += n;
+        return;
+    }
+
+    //made-up but repeatable data
+    if (s->info.numAxis == NUM_AXIS_THREE) {
+        triple = ev;
+        triple->referenceTime = last - s->period * (n - 1);
+        for (i = 0; i < n; i++, s->sampleNum++) {
+            triple->samples[i].deltaTime = s->period;
+            triple->samples[i].x = (float)(s->sampleNum % 100) * 0.01f;
+            triple->samples[i].y = 0.0f;
+            triple->samples[i].z = 9.81f;
+        }
+        first = &triple->samples[0].firstSample;
+    } else {
+        single = ev;
+        single->referenceTime = last - s->period * (n - 1);
+        for (i = 0; i < n; i++, s->sampleNum++) {
+            single->samples[i].deltaTime = s->period;
+            single->samples[i].fdata = (float)(s->sampleNum % 100);
+        }
+        first = &single->samples[0].firstSample;
+    }
+    memset(first, 0x00, sizeof(struct SensorFirstSample));
+    first->numSamples = n;
+
+    //shared buffer, so that any number of subscribers may hold on to it
+    osEnqueueEvtOrFree(sensorGetMyEventType(s->info.sensorType), ev, osEvtBufRelease);
+}
+
+static void simSensorIrq(struct SimSensor *s)
+{
+    s->irqs++;
+    simSensorRead(s, s->watermark);
+}
+
+static bool simSensorPower(bool on, void *cookie)
+{
+    struct SimSensor *s = cookie;
+
+    s->on = on;
+    if (!on)
+        s->nextIrq = SIM_TIME_NONE;
+
+    return sensorSignalInternalEvt(s->handle, SENSOR_INTERNAL_EVT_POWER_STATE_CHG, on, 0);
+}
+
+static bool simSensorFirmwareUpload(void *cookie)
+{
+    struct SimSensor *s = cookie;
+
+    return sensorSignalInternalEvt(s->handle, SENSOR_INTERNAL_EVT_FW_STATE_CHG, 1, 0);
+}
+
+static bool simSensorSetRate(uint32_t rate, uint64_t latency, void *cookie)
+{
+    struct SimSensor *s = cookie;
+    uint64_t wm;
+
+    //rates come from our list, so they are real rates
+    s->period = 1024000000000ULL / rate;
+    wm = latency / s->period;
+    s->watermark = wm < 1 ? 1 : wm > s->fifo ? s->fifo : wm;
+    s->nextIrq = s->on ? mSimTime + s->period * s->watermark : SIM_TIME_NONE;
+
+    return sensorSignalInternalEvt(s->handle, SENSOR_INTERNAL_EVT_RATE_CHG, rate, latency);
+}
+
+static bool simSensorFlush(void *cookie)
+{
+    struct SimSensor *s = cookie;
+    uint64_t n;
+
+    //what the fifo holds goes out ahead of the marker
+    if (s->nextIrq != SIM_TIME_NONE) {
+        n = (mSimTime + s->period * s->watermark - s->nextIrq) / s->period;
+        if (n && n < s->watermark)
+            simSensorRead(s, n);
+    }
+
+    if (s->dropFlush) {
+        s->dropFlush = false;
+        return true;
+    }
+
+    return osEnqueueEvt(sensorGetMyEventType(s->info.sensorType), SENSOR_DATA_EVENT_FLUSH, NULL);
+}
+
+static const struct SensorOps mSimSensorOps = {
+    .sensorPower = simSensorPower,
+    .sensorFirmwareUpload = simSensorFirmwareUpload,
+    .sensorSetRate = simSensorSetRate,
+    .sensorFlush = simSensorFlush,
+};
+
+static void simHandleEvent(uint32_t evtType, const void* evtData)
+{
+}
+
+static bool simStartTask(uint32_t taskId)
+{
+    struct SimSensor *s;
+    uint32_t i, evtSize;
+
+    for (i = 0; i < mSimNumSensors; i++) {
+        s = &mSimSensors[i];
+        if (s->info.numAxis == NUM_AXIS_THREE)
+            evtSize = sizeof(struct TripleAxisDataEvent) + s->fifo * sizeof(struct TripleAxisDataPoint);
+        else
+            evtSize = sizeof(struct SingleAxisDataEvent) + s->fifo * sizeof(struct SingleAxisDataPoint);
+        s->evtSlab = osEvtBufSlabNew(evtSize, SIM_EVTS_PER_SENSOR);
+        if (!s->evtSlab) {
+            osLog(LOG_ERROR, "sim: no memory for sensor %d events\n", s->info.sensorType);
+            return false;
+        }
+        s->handle = sensorRegister(&s->info, &mSimSensorOps, s, true);
+    }
+
+    //allocations made before this are not in the trace; frees of them are left out too
+    if (mHostHeapTrace && !traceEnable(true)) {
+        osLog(LOG_ERROR, "sim: heaptrace needs a build with OS_TRACE\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void simEndTask(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < mSimNumSensors; i++) {
+        sensorUnregister(mSimSensors[i].handle);
+        slabAllocatorDestroy(mSimSensors[i].evtSlab);
+    }
+}
+
+INTERNAL_APP_INIT(SIM_APP_ID, SIM_APP_VERSION, simStartTask, simEndTask, simHandleEvent);
+
+/* AP */
+
+static void simHostSend(uint32_t reason, const void *data, uint8_t len)
+{
+    struct NanohubPacket *pkt = (struct NanohubPacket *)mHostPkt;
+    struct NanohubPacketFooter *footer;
+
+    pkt->sync = NANOHUB_SYNC_BYTE;
+    pkt->seq = htole32(++mHostSeq);
+    pkt->reason = htole32(reason);
+    pkt->len = len;
+    memcpy(pkt->data, data, len);
+    footer = nanohubGetPacketFooter(pkt);
+    footer->crc = htole32(crc32(pkt, sizeof(*pkt) + len, CRC_INIT));
+
+    mHostPktSize = NANOHUB_PACKET_SIZE(len);
+    mHostReason = reason;
+    mHostDeliver = mSimTime + (uint64_t)mHostPktSize * mHostNsPerByte;
+    mHostDeadline = mHostDeliver + SIM_HOST_TIMEOUT;
+}
+
+static void simHostDone(void)
+{
+    mHostReason = 0;
+    mHostDeliver = SIM_TIME_NONE;
+    mHostDeadline = SIM_TIME_NONE;
+}
+
+//start the next request if the AP has something to say and nothing in flight
+static void simHostKick(void)
+{
+    struct NanohubReadEventRequest read;
+    struct NanohubReadEventsRequest bulk;
+    struct SimConfigRequest cfg;
+    struct SimCmd *cmd;
+
+    if (mHostReason)
+        return;
+
+    if (mSimCmdSent < mSimCmdDue) {
+        cmd = &mSimCmds[mSimCmdSent++];
+        cfg.evtType = htole32(EVT_NO_SENSOR_CONFIG_EVENT);
+        cfg.latency = cmd->latency;
+        cfg.rate = cmd->rate;
+        cfg.sensType = cmd->sensType;
+        cfg.cmd = cmd->cmd;
+        cfg.flags = cmd->flags;
+        simHostSend(NANOHUB_REASON_WRITE_EVENT, &cfg, sizeof(cfg));
+    } else if (mHostDrain && mHostBulkMax) {
+        bulk.apBootTime = htole64(mSimTime);
+        bulk.maxLength = htole16(mHostBulkMax);
+        simHostSend(NANOHUB_REASON_READ_EVENTS, &bulk, sizeof(bulk));
+    } else if (mHostDrain) {
+        read.apBootTime = htole64(mSimTime);
+        simHostSend(NANOHUB_REASON_READ_EVENT, &read, sizeof(read));
+    }
+}
+
+//sensor blocks, back to back; the AP only counts their flush markers
+static void simHostRxSensorEvent(const uint8_t *data, uint32_t len)
+{
+    struct SensorFirstSample first;
+    struct SimSensor *s;
+    const uint8_t *p;
+    uint32_t evtType, period, size, i, j;
+    bool compressed;
+
+    while (len >= sizeof(evtType) + sizeof(uint64_t) + sizeof(first)) {
+        memcpy(&evtType, data, sizeof(evtType));
+        evtType = le32toh(evtType);
+        compressed = evtType > EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT;
+        s = simSensorFind(evtType - (compressed ? EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT : EVT_NO_FIRST_SENSOR_EVENT));
+        if (!s)
+            return;
+        memcpy(&first, data + sizeof(evtType) + sizeof(uint64_t), sizeof(first));
+        s->flushes += first.numFlushes;
+
+        //as hostIntf.c lays them out; a marker alone has just the first sample header
+        p = data + sizeof(evtType) + sizeof(uint64_t);
+        if (!first.numSamples) {
+            p += sizeof(first);
+        } else if (!compressed) {
+            p += first.numSamples * (s->info.numAxis == NUM_AXIS_THREE ? sizeof(struct TripleAxisDataPoint) : sizeof(struct SingleAxisDataPoint));
+        } else {
+            p += sizeof(first);
+            memcpy(&period, p, sizeof(period));
+            p += sizeof(period) + 3;
+            for (i = 0; i < first.numSamples; i++) {
+                for (j = period || !i ? 1 : 0; j < 4; j++) {
+                    while (p < data + len && (*p & 0x80))
+                        p++;
+                    p++;
+                }
+            }
+        }
+        size = p - data;
+        if (size > len)
+            return;
+        data += size;
+        len -= size;
+    }
+}
+
+//the AP only looks into sensor blocks, for their flush markers, and into trace blocks, for "heaptrace"
+static void simHostRxEvent(const uint8_t *data, uint32_t len)
+{
+    struct TraceRecord rec;
+    uint32_t evtType;
+
+    if (len < sizeof(evtType))
+        return;
+    memcpy(&evtType, data, sizeof(evtType));
+    evtType = le32toh(evtType);
+    if ((evtType > EVT_NO_FIRST_SENSOR_EVENT && evtType < EVT_NO_FIRST_SENSOR_EVENT + SENS_TYPE_FIRST_USER) ||
+        (evtType > EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT && evtType < EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT + SENS_TYPE_FIRST_USER)) {
+        simHostRxSensorEvent(data, len);
+        return;
+    }
+    if (!mHostHeapTrace || evtType != HOST_EVT_TRACE)
+        return;
+
+    for (data += sizeof(evtType), len -= sizeof(evtType); len >= sizeof(rec); data += sizeof(rec), len -= sizeof(rec)) {
+        memcpy(&rec, data, sizeof(rec));
+        switch (rec.id) {
+        case TRACE_HEAP_ALLOC:
+            if (rec.arg1)
+                fprintf(mHostHeapTrace, "a %" PRIx32 " %" PRIu32 " %" PRIu16 "\n", rec.arg1, rec.arg0, rec.tid);
+            mSimStats.heapTraceRecords++;
+            break;
+        case TRACE_HEAP_FREE:
+            fprintf(mHostHeapTrace, "f %" PRIx32 "\n", rec.arg0);
+            mSimStats.heapTraceRecords++;
+            break;
+        case TRACE_HEAP_FREE_ALL:
+            fprintf(mHostHeapTrace, "F %" PRIu32 "\n", rec.arg0);
+            mSimStats.heapTraceRecords++;
+            break;
+        case TRACE_LOST:
+            fprintf(mHostHeapTrace, "# lost %" PRIu32 " records\n", rec.arg0);
+            mSimStats.traceLost += rec.arg0;
+            break;
+        }
+    }
+}
+
+//a READ_EVENTS reply: packets back to back, up to an empty one
+static void simHostRxRun(const uint8_t *buf, size_t size)
+{
+    const struct NanohubPacket *pkt;
+    struct NanohubPacketFooter footer;
+    uint64_t events = 0;
+
+    mSimStats.reads++;
+    do {
+        pkt = (const struct NanohubPacket *)buf;
+        if (size < NANOHUB_PACKET_SIZE_MIN || size < NANOHUB_PACKET_SIZE(pkt->len)) {
+            mSimStats.badPackets++;
+            break;
+        }
+        memcpy(&footer, pkt->data + pkt->len, sizeof(footer));
+        if (le32toh(footer.crc) != crc32(pkt, sizeof(*pkt) + pkt->len, CRC_INIT)) {
+            mSimStats.badPackets++;
+            break;
+        }
+        if (pkt->len)
+            events++;
+        mSimStats.readBytes += pkt->len;
+        simHostRxEvent(pkt->data, pkt->len);
+        buf += NANOHUB_PACKET_SIZE(pkt->len);
+        size -= NANOHUB_PACKET_SIZE(pkt->len);
+    } while (pkt->len);
+
+    mSimStats.events += events;
+    if (!events) {
+        mSimStats.emptyReads++;
+        mHostDrain = false;
+    }
+}
+
+//the hub has clocked a packet out to us
+static void simHostRxPacket(const uint8_t *buf, size_t size)
+{
+    const struct NanohubPacket *pkt;
+    struct NanohubPacketFooter footer;
+    uint32_t reason;
+
+    while (size && *buf != NANOHUB_SYNC_BYTE) {
+        buf++;
+        size--;
+    }
+    pkt = (const struct NanohubPacket *)buf;
+    if (size < NANOHUB_PACKET_SIZE_MIN || size < NANOHUB_PACKET_SIZE(pkt->len)) {
+        mSimStats.badPackets++;
+        return;
+    }
+    memcpy(&footer, pkt->data + pkt->len, sizeof(footer));
+    if (le32toh(footer.crc) != crc32(pkt, sizeof(*pkt) + pkt->len, CRC_INIT)) {
+        mSimStats.badPackets++;
+        return;
+    }
+    if (!mHostReason || le32toh(pkt->seq) != mHostSeq)
+        return;
+
+    reason = le32toh(pkt->reason);
+    if (reason == NANOHUB_REASON_NAK || reason == NANOHUB_REASON_NAK_BUSY) {
+        mSimStats.naks++;
+        simHostDone();
+    } else if (reason == mHostReason) {
+        if (reason == NANOHUB_REASON_READ_EVENTS) {
+            simHostRxRun(buf, size);
+        } else if (reason == NANOHUB_REASON_READ_EVENT) {
+            mSimStats.reads++;
+            if (pkt->len) {
+                mSimStats.events++;
+                mSimStats.readBytes += pkt->len;
+                simHostRxEvent(pkt->data, pkt->len);
+            } else {
+                mSimStats.emptyReads++;
+                mHostDrain = false;
+            }
+        } else {
+            mSimStats.configs++;
+        }
+        simHostDone();
+    }
+    //anything else (an ACK) means the answer is still to come
+}
+
+//hand the request to the hub; false if it is not listening yet
+static bool simHostDeliver(void)
+{
+    HostIntfCommCallbackF callback;
+    size_t size = mHostPktSize;
+
+    //not listening: toggle the wakeup line, as the AP does
+    if (!mRxCallback) {
+        hostIntfRxPacket(true);
+        hostIntfRxPacket(false);
+    }
+    if (!mRxCallback)
+        return false;
+
+    if (size > mRxSize)
+        size = mRxSize;
+    memcpy(mRxBuf, mHostPkt, size);
+    callback = mRxCallback;
+    mRxCallback = NULL;
+    mHostDeliver = SIM_TIME_NONE;
+    callback(size, 0);
+
+    return true;
+}
+
+void simApInt(bool wakeup, bool on)
+{
+    if (!wakeup) {
+        mHostIntNonWakeup = on;
+        return;
+    }
+
+    //a sleeping AP only notices the wakeup interrupt, and only if it is listening for it
+    if (on && !mHostIntWakeup && mHostWakeOnInt && !mHostDrain && mHostNextWake == SIM_TIME_NONE)
+        mHostNextWake = mSimTime + mHostWakeLatency;
+    mHostIntWakeup = on;
+}
+
+/* hub end of the bus */
+
+static int simCommRequest(void)
+{
+    return 0;
+}
+
+static int simCommRxPacket(void *rxBuf, size_t rxSize, HostIntfCommCallbackF callback)
+{
+    mRxBuf = rxBuf;
+    mRxSize = rxSize;
+    mRxCallback = callback;
+
+    return 0;
+}
+
+static int simCommTxPacket(const void *txBuf, size_t txSize, HostIntfCommCallbackF callback)
+{
+    mTxBuf = txBuf;
+    mTxSize = txSize;
+    mTxCallback = callback;
+    mTxDone = mSimTime + (uint64_t)txSize * mHostNsPerByte;
+
+    return 0;
+}
+
+static int simCommRelease(void)
+{
+    mRxCallback = NULL;
+    mTxCallback = NULL;
+    mTxDone = SIM_TIME_NONE;
+
+    return 0;
+}
+
+static const struct HostIntfComm mSimComm = {
+   .request = simCommRequest,
+   .rxPacket = simCommRxPacket,
+   .txPacket = simCommTxPacket,
+   .release = simCommRelease,
+};
+
+const struct HostIntfComm *simHostIntfInit(void)
+{
+    return &mSimComm;
+}
+
+static void simTxDone(void)
+{
+    HostIntfCommCallbackF callback = mTxCallback;
+    size_t size = mTxSize;
+
+    mTxDone = SIM_TIME_NONE;
+    mTxCallback = NULL;
+    simHostRxPacket(mTxBuf, size);
+    if (callback)
+        callback(size, 0);
+}
+
+/* virtual time */
+
+static void simReport(const char *key, uint64_t val)
+{
+    struct SimExpect *e;
+    uint32_t i;
+    bool ok;
+
+    printf("sim: %s=%" PRIu64 "\n", key, val);
+
+    for (i = 0; i < mSimNumExpects; i++) {
+        e = &mSimExpects[i];
+        if (strcmp(e->key, key))
+            continue;
+        e->seen = true;
+        ok = e->op == '<' ? val <= e->val : e->op == '>' ? val >= e->val : val == e->val;
+        if (!ok) {
+            printf("sim: expect %s %s %" PRIu64 " failed\n", key, e->op == '<' ? "<=" : e->op == '>' ? ">=" : "==", e->val);
+            mSimFailed++;
+        }
+    }
+}
+
+static void simFinish(void)
+{
+    struct HostIntfWakeupStats wakeupStats;
+    struct TimerStats timerStats;
+    char key[SIM_KEY_MAX];
+    struct SimSensor *s;
+    uint32_t i;
+
+    hostIntfGetWakeupStats(&wakeupStats);
+    timGetStats(&timerStats);
+
+    simReport("time_ms", mSimTime / 1000000);
+    simReport("hub_wakeups", mSimStats.wakeups);
+    simReport("hub_alarms", mSimStats.alarms);
+    simReport("hub_timer_wakes", timerStats.wakes);
+    simReport("hub_timer_wakes_per_sec", timerStats.wakesPerSec);
+    simReport("hub_timers_coalesced", timerStats.coalesced);
+    simReport("hub_ap_wakeups", wakeupStats.apWakeups);
+    simReport("hub_batch_windows", wakeupStats.batchWindows);
+    simReport("hub_batch_flushes", wakeupStats.batchFlushes);
+    for (i = 0; i < mSimNumSensors; i++) {
+        s = &mSimSensors[i];
+        snprintf(key, sizeof(key), "sensor%d_irqs", s->info.sensorType);
+        simReport(key, s->irqs);
+        snprintf(key, sizeof(key), "sensor%d_samples", s->info.sensorType);
+        simReport(key, s->samples);
+        snprintf(key, sizeof(key), "sensor%d_dropped", s->info.sensorType);
+        simReport(key, s->dropped + hostIntfGetDroppedSamples(s->info.sensorType));
+        snprintf(key, sizeof(key), "sensor%d_flushes", s->info.sensorType);
+        simReport(key, s->flushes);
+    }
+    simReport("ap_wakeups", mSimStats.apWakeups);
+    simReport("ap_polls", mSimStats.polls);
+    simReport("ap_reads", mSimStats.reads);
+    simReport("ap_empty_reads", mSimStats.emptyReads);
+    simReport("ap_read_bytes", mSimStats.readBytes);
+    simReport("ap_events", mSimStats.events);
+    simReport("ap_configs", mSimStats.configs);
+    simReport("ap_naks", mSimStats.naks);
+    simReport("ap_timeouts", mSimStats.timeouts);
+    simReport("ap_bad_packets", mSimStats.badPackets);
+    if (mHostHeapTrace) {
+        //lost records mean a trace with holes in it; drain more often
+        simReport("heap_trace_records", mSimStats.heapTraceRecords);
+        simReport("trace_lost", mSimStats.traceLost);
+        fclose(mHostHeapTrace);
+    }
+    //a typo in a counter name must not pass for a met expectation
+    for (i = 0; i < mSimNumExpects; i++) {
+        if (!mSimExpects[i].seen) {
+            printf("sim: expect %s failed: no such counter\n", mSimExpects[i].key);
+            mSimFailed++;
+        }
+    }
+    fflush(stdout);
+    fprintf(stderr, "sim: wall_ms=%" PRIu64 "\n", (simWallNs() - mSimWallStart) / 1000000);
+
+    exit(mSimFailed ? 1 : 0);
+}
+
+static uint64_t simNextTime(void)
+{
+    uint64_t next = SIM_TIME_NONE;
+    uint32_t i;
+
+#define SIM_CONSIDER(t) do { if ((t) < next) next = (t); } while (0)
+    if (mSimAlarm > mSimTime)
+        SIM_CONSIDER(mSimAlarm);
+    for (i = 0; i < mSimNumSensors; i++)
+        SIM_CONSIDER(mSimSensors[i].nextIrq);
+    if (mSimCmdDue < mSimNumCmds)
+        SIM_CONSIDER(mSimCmds[mSimCmdDue].time);
+    SIM_CONSIDER(mHostNextRead);
+    SIM_CONSIDER(mHostNextWake);
+    SIM_CONSIDER(mTxDone);
+    SIM_CONSIDER(mHostDeliver);
+    SIM_CONSIDER(mHostDeadline);
+#undef SIM_CONSIDER
+
+    return next;
+}
+
+//the OS has nothing to do: jump to the next thing that will give it something
+void simSleep(void)
+{
+    uint64_t next = simNextTime();
+    uint32_t i;
+
+    if (next == SIM_TIME_NONE || next > mSimEnd) {
+        mSimTime = mSimEnd;
+        simFinish();
+    }
+
+    mSimTime = next;
+    mSimStats.wakeups++;
+
+    //fixed order, so that ties always go the same way
+    if (mSimAlarm == next)
+        mSimStats.alarms++; //eventQ checks timers when we return
+
+    for (i = 0; i < mSimNumSensors; i++)
+        if (mSimSensors[i].nextIrq == next)
+            simSensorIrq(&mSimSensors[i]);
+
+    while (mSimCmdDue < mSimNumCmds && mSimCmds[mSimCmdDue].time == next)
+        mSimCmdDue++;
+
+    if (mHostNextRead == next) {
+        mHostNextRead += mHostReadPeriod;
+        mHostDrain = true;
+        mSimStats.polls++;
+    }
+    if (mHostNextWake == next) {
+        mHostNextWake = SIM_TIME_NONE;
+        mHostDrain = true;
+        mSimStats.apWakeups++;
+    }
+
+    if (mTxDone == next)
+        simTxDone();
+    if (mHostDeliver == next && !simHostDeliver())
+        mHostDeliver = next + SIM_HOST_RETRY;
+    if (mHostDeadline == next) {
+        mSimStats.timeouts++;
+        simHostDone();
+    }
+
+    simHostKick();
+}
+
+/* scenario */
+
+static bool simParseNum(const char *tok, uint64_t *valP)
+{
+    char *end;
+
+    if (!tok)
+        return false;
+    *valP = strtoull(tok, &end, 0);
+
+    return end != tok && !*end;
+}
+
+static bool simParseLine(char *line)
+{
+    uint64_t v[4];
+    char *tok[8];
+    struct SimSensor *s;
+    struct SimCmd cmd;
+    uint32_t n = 0, i;
+    bool wakeup, dropFlush;
+
+    for (tok[n] = strtok(line, " \t\r\n"); tok[n] && n < 7; tok[n] = strtok(NULL, " \t\r\n"))
+        n++;
+    tok[n] = NULL;
+    if (!n)
+        return true;
+
+    if (!strcmp(tok[0], "duration") && n == 2 && simParseNum(tok[1], &v[0]) && v[0]) {
+        mSimEnd = v[0] * 1000000ULL;
+    } else if (!strcmp(tok[0], "sensor") && n >= 3 && n <= 7) {
+        if (mSimNumSensors == SIM_MAX_SENSORS || !simParseNum(tok[1], &v[0]) || !simParseNum(tok[2], &v[1]))
+            return false;
+        v[2] = 3;
+        v[3] = 1;
+        if ((n > 3 && !simParseNum(tok[3], &v[2])) || (n > 4 && !simParseNum(tok[4], &v[3])))
+            return false;
+        if (!v[0] || v[0] >= SENS_TYPE_FIRST_USER || simSensorFind(v[0]) || !v[1] || v[1] > 100000)
+            return false;
+        if ((v[2] != 1 && v[2] != 3) || !v[3] || v[3] > SIM_MAX_FIFO)
+            return false;
+        for (i = 5, wakeup = false, dropFlush = false; i < n; i++) {
+            if (!wakeup && !strcmp(tok[i], "wakeup"))
+                wakeup = true;
+            else if (!dropFlush && !strcmp(tok[i], "dropflush"))
+                dropFlush = true;
+            else
+                return false;
+        }
+
+        s = &mSimSensors[mSimNumSensors++];
+        s->odr = v[1];
+        s->fifo = v[3];
+        s->nextIrq = SIM_TIME_NONE;
+        for (i = 0; i < SIM_NUM_RATES; i++)
+            s->rates[i] = (s->odr * 1024) >> (SIM_NUM_RATES - 1 - i);
+        s->rates[SIM_NUM_RATES] = 0;
+        s->info.sensorName = "Simulated sensor";
+        s->info.supportedRates = s->rates;
+        s->info.sensorType = v[0];
+        s->info.numAxis = v[2] == 3 ? NUM_AXIS_THREE : NUM_AXIS_ONE;
+        s->info.interrupt = wakeup ? NANOHUB_INT_WAKEUP : NANOHUB_INT_NONWAKEUP;
+        s->dropFlush = dropFlush;
+        s->info.minSamples = s->fifo;
+    } else if (!strcmp(tok[0], "enable") || !strcmp(tok[0], "disable") || !strcmp(tok[0], "flush")) {
+        if (mSimNumCmds == SIM_MAX_CMDS || !simParseNum(tok[1], &v[0]) || !simParseNum(tok[2], &v[1]))
+            return false;
+        memset(&cmd, 0, sizeof(cmd));
+        if (!strcmp(tok[0], "enable")) {
+            if (n < 5 || n > 6 || !simParseNum(tok[3], &v[2]) || !simParseNum(tok[4], &v[3]) || !v[2])
+                return false;
+            if (n == 6 && strcmp(tok[5], "compress"))
+                return false;
+            cmd.cmd = SIM_CONFIG_CMD_ENABLE;
+            cmd.flags = n == 6 ? SIM_CONFIG_FLAG_COMPRESS : 0;
+            cmd.rate = v[2] * 1024;
+            cmd.latency = v[3] * 1000000ULL;
+        } else if (n != 3) {
+            return false;
+        } else {
+            cmd.cmd = !strcmp(tok[0], "flush") ? SIM_CONFIG_CMD_FLUSH : SIM_CONFIG_CMD_DISABLE;
+        }
+        cmd.time = v[0] * 1000000ULL;
+        cmd.sensType = v[1];
+
+        //keep the script sorted; equal times stay in file order
+        for (i = mSimNumCmds++; i && mSimCmds[i - 1].time > cmd.time; i--)
+            mSimCmds[i] = mSimCmds[i - 1];
+        mSimCmds[i] = cmd;
+    } else if (!strcmp(tok[0], "read") && n == 2 && simParseNum(tok[1], &v[0]) && v[0]) {
+        mHostReadPeriod = v[0] * 1000000ULL;
+        mHostNextRead = mHostReadPeriod;
+    } else if (!strcmp(tok[0], "apwake") && n == 2 && simParseNum(tok[1], &v[0])) {
+        mHostWakeLatency = v[0] * 1000ULL;
+        mHostWakeOnInt = true;
+    } else if (!strcmp(tok[0], "bus") && n == 2 && simParseNum(tok[1], &v[0]) && v[0] && v[0] <= 1000000) {
+        mHostNsPerByte = v[0];
+    } else if (!strcmp(tok[0], "bulk") && n == 2 && simParseNum(tok[1], &v[0]) && v[0] && v[0] <= UINT16_MAX) {
+        mHostBulkMax = v[0];
+    } else if (!strcmp(tok[0], "expect") && n == 4 && simParseNum(tok[3], &v[0])) {
+        if (mSimNumExpects == SIM_MAX_EXPECTS || strlen(tok[1]) >= SIM_KEY_MAX)
+            return false;
+        if (strcmp(tok[2], "<=") && strcmp(tok[2], ">=") && strcmp(tok[2], "=="))
+            return false;
+        memcpy(mSimExpects[mSimNumExpects].key, tok[1], strlen(tok[1]) + 1);
+        mSimExpects[mSimNumExpects].op = tok[2][0];
+        mSimExpects[mSimNumExpects++].val = v[0];
+    } else if (!strcmp(tok[0], "heaptrace") && n == 2 && !mHostHeapTrace) {
+        if (!(mHostHeapTrace = fopen(tok[1], "w"))) {
+            fprintf(stderr, "sim: cannot create %s\n", tok[1]);
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool simLoad(const char *path)
+{
+    char line[SIM_LINE_MAX], *comment;
+    uint32_t lineNo = 0;
+    bool ok = true;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "sim: cannot open %s\n", path);
+        return false;
+    }
+
+    while (ok && fgets(line, sizeof(line), f)) {
+        lineNo++;
+        comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+        ok = simParseLine(line);
+    }
+    fclose(f);
+
+    if (!ok) {
+        fprintf(stderr, "sim: %s:%" PRIu32 ": bad line\n", path, lineNo);
+        return false;
+    }
+    if (!mSimEnd) {
+        fprintf(stderr, "sim: %s: no duration\n", path);
+        return false;
+    }
+
+    mSimWallStart = simWallNs();
+    mSimActive = true;
+
+    return true;
+}
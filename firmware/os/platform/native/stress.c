@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <plat/stress.h>
+#include <plat/taggedPtr.h>
+#include <atomic.h>
+#include <eventQ.h>
+#include <eventnums.h>
+#include <seos.h>
+
+/*
+ * Host threads hammer the OS primitives that are meant to be called from any context,
+ * while the OS thread consumes, as it would from interrupts on a device. Producers do
+ * not take the cpu lock: whatever locking a primitive needs, it does itself. One line
+ * per case, and the exit status is 0 only if every case passed:
+ *
+ *   stress: name=<case> producers=<n> sent=<n> received=<n> dropped=<n> refused=<n> result=ok|fail
+ *
+ * Every event carries its producer and sequence number. Each one must come out exactly
+ * once, either from the queue or through the discard callback, and the events of one
+ * producer that share a lane must come out in the order they went in. The queue's own
+ * drop counters must account for every eviction and every refused enqueue.
+ */
+
+#define STRESS_APP_ID           APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 32)
+#define STRESS_APP_VERSION      1
+
+#define STRESS_PRODUCERS        4
+#define STRESS_EVTS             200000 /* per producer */
+#define STRESS_EVTQ_SIZE        64
+#define STRESS_BATCH            8
+#define STRESS_URGENT_EVERY     8      /* with atFront, this often an event asks to jump the queue */
+#define STRESS_EVT_TYPE         EVT_NO_FIRST_USER_EVENT
+#define STRESS_SEQ_BITS         24
+#define STRESS_SEQ_MASK         ((1UL << STRESS_SEQ_BITS) - 1)
+#define STRESS_NO_SEQ           0xFFFFFFFFUL
+
+struct StressCase {
+    const char *name;
+    uint32_t flags;     /* EVT_QUEUE_FL_* */
+    bool discardable;   /* a full queue makes room by evicting instead of refusing */
+    bool atFront;
+    uint32_t typeQuota; /* evtQueueSetTypeQuota() for the events, if not 0 */
+};
+
+struct StressProducer {
+    pthread_t thread;
+    uint32_t id;
+    uint32_t lastSeq;   /* last in-order event received; STRESS_NO_SEQ before the first */
+};
+
+static const char *mStressFilter;
+static const struct StressCase *mStressCase;
+static struct EvtQueue *mStressEvtQ;
+static struct StressProducer mStressProducers[STRESS_PRODUCERS];
+static volatile uint8_t mStressSeen[STRESS_PRODUCERS][STRESS_EVTS];
+static volatile uint32_t mStressDone, mStressDropped, mStressRefused, mStressErrors;
+static uint32_t mStressReceived;
+
+void stressRequest(const char *filter)
+{
+    mStressFilter = filter;
+}
+
+static void stressFail(const char *what, uint32_t producer, uint32_t seq)
+{
+    //only the first few; a broken queue tends to break everything after
+    if (atomicAdd32bits(&mStressErrors, 1) < 8)
+        printf("stress: name=%s error=%s producer=%" PRIu32 " seq=%" PRIu32 "\n", mStressCase->name, what, producer, seq);
+}
+
+//every event comes out once, through the queue or the discard callback; returns its seq
+static uint32_t stressSee(uint32_t evtType, void *evtData)
+{
+    uint32_t val = (uint32_t)(uintptr_t)evtData;
+    uint32_t producer = val >> STRESS_SEQ_BITS, seq = val & STRESS_SEQ_MASK;
+
+    if ((evtType & ~EVENT_TYPE_BIT_DISCARDABLE) != STRESS_EVT_TYPE || producer >= STRESS_PRODUCERS || seq >= STRESS_EVTS) {
+        stressFail("garbage", producer, seq);
+        return STRESS_NO_SEQ;
+    }
+    if (mStressSeen[producer][seq]++)
+        stressFail("duplicate", producer, seq);
+
+    return seq;
+}
+
+static void stressEvtDiscard(uint32_t evtType, void *evtData, TaggedPtr evtFreeData)
+{
+    stressSee(evtType, evtData);
+    atomicAdd32bits(&mStressDropped, 1);
+}
+
+static void *stressProducer(void *arg)
+{
+    struct StressProducer *p = arg;
+    uint32_t evtType = STRESS_EVT_TYPE | (mStressCase->discardable ? EVENT_TYPE_BIT_DISCARDABLE : 0);
+    uint32_t prio = (p->id / 2) % EVT_PRIO_NUM; //two producers per lane, or nothing contends for its tail
+    uint32_t seq;
+    bool atFront;
+
+    for (seq = 0; seq < STRESS_EVTS; seq++) {
+        atFront = mStressCase->atFront && !(seq % STRESS_URGENT_EVERY);
+        //a refused event was never queued, so trying again cannot duplicate it
+        while (!evtQueueEnqueueEx(mStressEvtQ, evtType, (void *)(uintptr_t)((p->id << STRESS_SEQ_BITS) | seq),
+                                  taggedPtrMakeFromPtr(NULL), prio, atFront)) {
+            atomicAdd32bits(&mStressRefused, 1);
+            sched_yield();
+        }
+    }
+    atomicAdd32bits(&mStressDone, 1);
+
+    return NULL;
+}
+
+static void stressConsume(const struct EvtQueueItem *item)
+{
+    uint32_t val = (uint32_t)(uintptr_t)item->evtData;
+    struct StressProducer *p;
+    uint32_t seq;
+
+    mStressReceived++;
+    if ((seq = stressSee(item->evtType, item->evtData)) == STRESS_NO_SEQ)
+        return;
+
+    //jumping the queue is the point of atFront; the rest of a producer's events share one lane
+    p = &mStressProducers[val >> STRESS_SEQ_BITS];
+    if (mStressCase->atFront && !(seq % STRESS_URGENT_EVERY))
+        return;
+    if (p->lastSeq != STRESS_NO_SEQ && seq <= p->lastSeq)
+        stressFail("order", p->id, seq);
+    if (!mStressCase->discardable && !mStressCase->atFront && seq != p->lastSeq + 1)
+        stressFail("lost", p->id, p->lastSeq + 1);
+    p->lastSeq = seq;
+}
+
+static bool stressRunCase(const struct StressCase *c)
+{
+    struct EvtQueueItem items[STRESS_BATCH];
+    struct EvtQueueDropStat stat;
+    uint32_t i, j, n, total;
+    bool done;
+
+    mStressCase = c;
+    mStressDone = mStressDropped = mStressRefused = mStressErrors = mStressReceived = 0;
+    memset((void *)mStressSeen, 0, sizeof(mStressSeen));
+
+    if (!(mStressEvtQ = evtQueueAllocEx(STRESS_EVTQ_SIZE, stressEvtDiscard, c->flags, NULL))) {
+        printf("stress: name=%s error=setup\n", c->name);
+        return false;
+    }
+    if (c->typeQuota)
+        evtQueueSetTypeQuota(mStressEvtQ, STRESS_EVT_TYPE, c->typeQuota);
+
+    for (i = 0; i < STRESS_PRODUCERS; i++) {
+        mStressProducers[i].id = i;
+        mStressProducers[i].lastSeq = STRESS_NO_SEQ;
+        if (pthread_create(&mStressProducers[i].thread, NULL, stressProducer, &mStressProducers[i])) {
+            printf("stress: name=%s error=thread\n", c->name);
+            exit(1);
+        }
+    }
+
+    //a producer that is done has published everything it enqueued
+    do {
+        done = atomicRead32bits(&mStressDone) == STRESS_PRODUCERS;
+        n = evtQueueDequeueBatch(mStressEvtQ, items, STRESS_BATCH, false);
+        for (i = 0; i < n; i++)
+            stressConsume(&items[i]);
+        if (!n)
+            sched_yield();
+    } while (n || !done);
+
+    for (i = 0; i < STRESS_PRODUCERS; i++) {
+        pthread_join(mStressProducers[i].thread, NULL);
+        for (j = 0; j < STRESS_EVTS; j++)
+            if (!mStressSeen[i][j])
+                stressFail("lost", i, j);
+    }
+
+    //evicted and refused events are both drops; all of ours share one counter
+    n = evtQueueGetDropStats(mStressEvtQ, &stat, 1, &total);
+    if (total != mStressDropped + mStressRefused || (n && stat.count != total))
+        stressFail("drop_stats", n ? stat.evtType : 0, total);
+    //a quota below the slab size keeps the slab from filling up, so nothing gets evicted
+    if (c->typeQuota && c->typeQuota < STRESS_EVTQ_SIZE && mStressDropped)
+        stressFail("type_quota", c->typeQuota, mStressDropped);
+    evtQueueFree(mStressEvtQ);
+
+    printf("stress: name=%s producers=%d sent=%d received=%" PRIu32 " dropped=%" PRIu32 " refused=%" PRIu32 " result=%s\n",
+           c->name, STRESS_PRODUCERS, STRESS_PRODUCERS * STRESS_EVTS, mStressReceived, mStressDropped, mStressRefused,
+           mStressErrors ? "fail" : "ok");
+
+    return !mStressErrors;
+}
+
+static const struct StressCase mStressCases[] = {
+    { "evtq_lockless",              EVT_QUEUE_FL_LOCKLESS,                              false,  false,  0  },
+    { "evtq_lockless_atfront",      EVT_QUEUE_FL_LOCKLESS,                              false,  true,   0  },
+    { "evtq_lockless_evict",        EVT_QUEUE_FL_LOCKLESS,                              true,   false,  0  },
+    { "evtq_lockless_evict_oldest", EVT_QUEUE_FL_LOCKLESS | EVT_QUEUE_FL_EVICT_OLDEST,  true,   true,   0  },
+    { "evtq_lockless_type_quota",   EVT_QUEUE_FL_LOCKLESS,                              true,   false,  16 },
+    { "evtq_locked",                0,                                                  false,  false,  0  },
+    { "evtq_locked_evict",          0,                                                  true,   false,  0  },
+};
+
+static bool stressStartTask(uint32_t taskId)
+{
+    const struct StressCase *c;
+    bool ok = true;
+    uint32_t i;
+
+    if (!mStressFilter)
+        return true;
+
+    for (i = 0; i < sizeof(mStressCases) / sizeof(*mStressCases); i++) {
+        c = &mStressCases[i];
+        if (!strcmp(mStressFilter, "all") || !strncmp(c->name, mStressFilter, strlen(mStressFilter)))
+            ok = stressRunCase(c) && ok;
+    }
+    fflush(stdout);
+
+    exit(ok ? 0 : 1);
+}
+
+static void stressEndTask(void)
+{
+}
+
+static void stressHandleEvent(uint32_t evtType, const void* evtData)
+{
+}
+
+INTERNAL_APP_INIT(STRESS_APP_ID, STRESS_APP_VERSION, stressStartTask, stressEndTask, stressHandleEvent);
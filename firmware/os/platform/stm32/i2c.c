@@ -21,6 +21,7 @@
 #include <gpio.h>
 #include <i2c.h>
 #include <seos.h>
+#include <trace.h>
 #include <util.h>
 #include <gpio.h>
 #include <atomicBitset.h>
@@ -355,6 +356,7 @@ static inline void stmI2cSlaveIdle(struct StmI2cDev *pdev)
 static inline void stmI2cInvokeRxCallback(struct I2cStmState *state, size_t tx, size_t rx, int err)
 {
     uint16_t oldTid = osSetCurrentTid(state->tid);
+    trace(TRACE_I2C_DONE, (tx << 16) | rx, err);
     state->rx.callback(state->rx.cookie, tx, rx, err);
     osSetCurrentTid(oldTid);
 }
@@ -362,6 +364,7 @@ static inline void stmI2cInvokeRxCallback(struct I2cStmState *state, size_t tx,
 static inline void stmI2cInvokeTxCallback(struct I2cStmState *state, size_t tx, size_t rx, int err)
 {
     uint16_t oldTid = osSetCurrentTid(state->tid);
+    trace(TRACE_I2C_DONE, (tx << 16) | rx, err);
     state->tx.callback(state->tx.cookie, tx, rx, err);
     osSetCurrentTid(oldTid);
 }
@@ -867,6 +870,8 @@ int i2cMasterTxRx(uint32_t busId, uint32_t addr,
     if (state->mode != STM_I2C_MASTER)
         return -EINVAL;
 
+    trace(TRACE_I2C_START, (busId << 8) | addr, (txSize << 16) | rxSize);
+
     struct StmI2cXfer *xfer = stmI2cGetXfer();
 
     if (xfer) {
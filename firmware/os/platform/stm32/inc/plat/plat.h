@@ -62,6 +62,11 @@ static inline uint8_t* platGetSharedAreaInfo(uint32_t *areaSzP)
 //used for dropbox
 void* platGetPersistentRamStore(uint32_t *bytes);
 
+//platLogPutcharF() has somewhere to put chars; without it, tokenized logs are not mirrored as text
+#if defined(DEBUG_UART_UNITNO) || (defined(DEBUG) && defined(DEBUG_UART_PIN))
+#define PLAT_LOG_CHARS
+#endif
+
 static inline void platWake(void)
 {
 }
@@ -229,6 +229,28 @@ bool platLogPutcharF(void *userData, char ch)
     return true;
 }
 
+bool platLogPutbytesF(void *userData, const void *data, uint32_t len)
+{
+#if defined(DEBUG_LOG_EVT)
+    struct HostIntfDataBuffer *buffer = userData;
+
+    if (!buffer || buffer->length + len > sizeof(buffer->buffer))
+        return false;
+
+    if (!mLateBoot) {
+        if (mEarlyLogBufferOffset + len > EARLY_LOG_BUF_SIZE)
+            return false;
+        mEarlyLogBufferOffset += len;
+    }
+
+    memcpy(buffer->buffer + buffer->length, data, len);
+    buffer->length += len;
+    return true;
+#else
+    return false;
+#endif
+}
+
 void platInitialize(void)
 {
     const uint32_t debugStateInSleepMode = DBG_SLEEP | DBG_STOP | DBG_STANDBY;
@@ -24,6 +24,7 @@ BL_FILE = $(OUT)/bl.unchecked.bin
 OS_FILE = $(OUT)/os.checked.bin
 
 DELIVERABLES += showsizes
+DELIVERABLES += $(OUT)/os.logdict
 FLAGS += -I. -fno-unwind-tables -fstack-reuse=all -ffunction-sections -fdata-sections
 FLAGS += -Wl,--gc-sections -nostartfiles
 FLAGS += -nostdlib
@@ -80,6 +81,10 @@ $(OUT)/bl.%.bin : $(OUT)/bl.%.elf
 $(OUT)/os.%.bin : $(OUT)/os.%.elf
 	$(OBJCOPY) -j .data -j .text $(OBJCOPY_PARAMS) $< $@
 
+#host-side dictionary for tokenized logs (empty unless built with OS_LOG_TOKENIZED)
+$(OUT)/os.logdict : $(OUT)/os.checked.elf
+	$(OBJCOPY) -j .logstr --set-section-flags .logstr=alloc,load,contents $(OBJCOPY_PARAMS) $< $@
+
 showsizes: $(OUT)/os.unchecked.elf
 	os/platform/$(PLATFORM)/misc/showsizes.sh $<
 
@@ -21,6 +21,7 @@
 extern "C" {
 #endif
 
+#define VARIANT_VER       0x00000000
 #define PLATFORM_HW_TYPE  0x8086
 
 #define PLAT_HAS_NO_U_TYPES_H
@@ -31,6 +32,15 @@ extern "C" {
 //i2c bus for comms (dummy)
 #define PLATFORM_HOST_INTF_I2C_BUS  12345
 
+//per-task run and wait time, for "nanotool -x top" against the native build
+#define OS_TASK_PROFILE             1
+
+//tracepoints, for "nanotool -x trace" and the "heaptrace" sim command
+#define OS_TRACE                    1
+
+//bulk reads, for the "bulk" sim command
+#define HOSTINTF_READ_EVENTS_MAX    NANOHUB_READ_EVENTS_MAX
+
 
 
 
@@ -17,7 +17,7 @@
 #variant makefile for generic linux
 
 
-ifneq ($(PLATFORM),linux)
+ifneq ($(PLATFORM),native)
         $(error "linux variant cannot be build on a platform that is not linux")
 endif
 
@@ -60,6 +60,7 @@
 #define NANOHUB_LOCK_FILE       NANOHUB_LOCK_DIR "/lock"
 #define MAG_BIAS_FILE_PATH      "/sys/class/power_supply/battery/compass_compensation"
 #define DOUBLE_TOUCH_FILE_PATH  "/sys/android_touch/synaptics_rmi4_dsx/wake_event"
+#define LOG_DICT_FILE_PATH      "/vendor/firmware/nanohub.logdict"
 
 #define NANOHUB_LOCK_DIR_PERMS  (S_IRUSR | S_IWUSR | S_IXUSR)
 
@@ -71,6 +72,11 @@
 
 #define OS_LOG_EVENT            0x474F4C41  // ascii: ALOG
 
+#define NANOHUB_READ_MAX        (sizeof(uint32_t) + 2048)  // HOST_EVT_BULK is the biggest message
+
+// ask the hub for compressed three-axis samples (see processCompressedSamples)
+const char COMPRESS_SAMPLES_PROPERTY[] = "sensor.hubconnection.compress";
+
 #ifdef LID_STATE_REPORTING_ENABLED
 const char LID_STATE_PROPERTY[] = "sensors.contexthub.lid_state";
 const char LID_STATE_UNKNOWN[]  = "unknown";
@@ -126,6 +132,7 @@ HubConnection::HubConnection()
     memset(&mGyroOtcData, 0, sizeof(mGyroOtcData));
 
     memset(&mSensorState, 0x00, sizeof(mSensorState));
+    mCompressSamples = property_get_bool(COMPRESS_SAMPLES_PROPERTY, false);
     mFd = open(NANOHUB_FILE_PATH, O_RDWR);
     mPollFds[0].fd = mFd;
     mPollFds[0].events = POLLIN;
@@ -137,6 +144,9 @@ HubConnection::HubConnection()
 
     initNanohubLock();
 
+    // only needed for firmware built with tokenized logging
+    mLogDict.load(LOG_DICT_FILE_PATH);
+
 #ifdef USB_MAG_BIAS_REPORTING_ENABLED
     mUsbMagBias = 0;
     mMagBiasPollIndex = -1;
@@ -941,19 +951,33 @@ void HubConnection::postOsLog(uint8_t *buf, ssize_t len)
     if (len < 6)
         return;
 
-    buf[len] = 0x00;
-    switch (buf[4]) {
+    std::string text;
+    char level;
+    // not NUL terminated: in a HOST_EVT_BULK message the next event follows right after
+    const char *msg = reinterpret_cast<const char *>(&buf[5]);
+    int msgLen = len - 5;
+
+    if (LogDictionary::isTokenized(&buf[4], len - 4)) {
+        if (!mLogDict.decode(&buf[4], len - 4, &level, &text))
+            return;
+        msg = text.c_str();
+        msgLen = text.size();
+    } else {
+        level = buf[4];
+    }
+
+    switch (level) {
     case 'E':
-        ALOGE("osLog: %s", &buf[5]);
+        ALOGE("osLog: %.*s", msgLen, msg);
         break;
     case 'W':
-        ALOGW("osLog: %s", &buf[5]);
+        ALOGW("osLog: %.*s", msgLen, msg);
         break;
     case 'I':
-        ALOGI("osLog: %s", &buf[5]);
+        ALOGI("osLog: %.*s", msgLen, msg);
         break;
     case 'D':
-        ALOGD("osLog: %s", &buf[5]);
+        ALOGD("osLog: %.*s", msgLen, msg);
         break;
     default:
         break;
@@ -986,22 +1010,91 @@ void HubConnection::processAppData(uint8_t *buf, ssize_t len) {
     }
 }
 
+static bool getVarint(const uint8_t *buf, size_t len, size_t *pos, uint32_t *val)
+{
+    uint32_t shift;
+    uint8_t byte;
+
+    *val = 0;
+    for (shift = 0; shift < 32 && *pos < len; shift += 7) {
+        byte = buf[(*pos)++];
+        *val |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+// Compressed three-axis block, from EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT; the format is
+// described in firmware/os/core/hostIntf.c. buf points at firstSample. Returns the number
+// of bytes used, or -1 if the block is malformed.
+ssize_t HubConnection::processCompressedSamples(uint64_t timestamp, uint32_t type, uint32_t sensor, const uint8_t *buf, size_t len)
+{
+    struct FirstSample firstSample;
+    struct ThreeAxisSample sample;
+    uint32_t period, deltaTime, zz;
+    int32_t q[3] = { 0, 0, 0 };
+    int8_t scaleExp[3];
+    float scale[3];
+    size_t pos;
+    int i, j;
+
+    if (len < sizeof(firstSample) + sizeof(period) + sizeof(scaleExp))
+        return -1;
+
+    memcpy(&firstSample, buf, sizeof(firstSample));
+    pos = sizeof(firstSample);
+    memcpy(&period, buf + pos, sizeof(period));
+    pos += sizeof(period);
+    for (j=0; j<3; j++) {
+        scaleExp[j] = buf[pos++];
+        scale[j] = ldexpf(1.0f, scaleExp[j]);
+    }
+
+    memset(&sample, 0x00, sizeof(sample));
+    for (i=0; i<firstSample.numSamples; i++) {
+        if (i > 0) {
+            deltaTime = period;
+            if (!period && !getVarint(buf, len, &pos, &deltaTime))
+                return -1;
+            timestamp += ((uint64_t)deltaTime) << delta_time_shift_table[deltaTime & delta_time_encoded];
+        }
+        for (j=0; j<3; j++) {
+            if (!getVarint(buf, len, &pos, &zz))
+                return -1;
+            q[j] += (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+        }
+        sample.x = q[0] * scale[0];
+        sample.y = q[1] * scale[1];
+        sample.z = q[2] * scale[2];
+        processSample(timestamp, type, sensor, &sample, firstSample.highAccuracy);
+    }
+
+    return pos;
+}
+
 ssize_t HubConnection::processBuf(uint8_t *buf, size_t len)
 {
     struct nAxisEvent *data = (struct nAxisEvent *)buf;
-    uint32_t type, sensor, bias, currSensor;
+    uint32_t type, sensor, bias, currSensor, evtType;
     int i, numSamples;
-    bool one, rawThree, three;
+    bool one, rawThree, three, compressed;
     sensors_event_t ev;
     uint64_t timestamp;
-    ssize_t ret = 0;
+    ssize_t ret = 0, used;
     uint32_t primary;
 
     if (len >= sizeof(data->evtType)) {
         ret = sizeof(data->evtType);
         one = three = rawThree = false;
         bias = 0;
-        switch (data->evtType) {
+        evtType = data->evtType;
+        compressed = evtType > EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT &&
+                     evtType <= EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT + SENS_TYPE_LAST_USER;
+        if (compressed)
+            evtType = SENS_TYPE_TO_EVENT(evtType - EVT_NO_FIRST_COMPRESSED_SENSOR_EVENT);
+        switch (evtType) {
         case OS_LOG_EVENT:
             postOsLog(buf, len);
             return 0;
@@ -1233,11 +1326,24 @@ ssize_t HubConnection::processBuf(uint8_t *buf, size_t len)
         return -1;
     }
 
+    if (compressed && !three) {
+        ALOGW("compressed samples for a sensor that does not have three axes: evtType=0x%08x\n", data->evtType);
+        return -1;
+    }
+
     if (len >= sizeof(data->evtType) + sizeof(data->referenceTime) + sizeof(data->firstSample)) {
         ret += sizeof(data->referenceTime);
         timestamp = data->referenceTime;
         numSamples = data->firstSample.numSamples;
-        for (i=0; i<numSamples; i++) {
+        if (compressed) {
+            used = processCompressedSamples(timestamp, type, sensor, buf + ret, len - ret);
+            if (used < 0) {
+                ALOGW("sensor %d (compressed): ret=%zd, numSamples=%d, len=%zu\n", sensor, ret, numSamples, len);
+                return -1;
+            }
+            ret += used;
+        }
+        for (i=0; !compressed && i<numSamples; i++) {
             if (data->firstSample.biasPresent && data->firstSample.biasSample == i)
                 currSensor = bias;
             else
@@ -1470,18 +1576,11 @@ bool HubConnection::threadLoop() {
 #endif // DOUBLE_TOUCH_ENABLED
 
         if (mPollFds[0].revents & POLLIN) {
-            uint8_t recv[256];
+            uint8_t recv[NANOHUB_READ_MAX];
             ssize_t len = ::read(mFd, recv, sizeof(recv));
 
             if (len >= 0) {
-                for (ssize_t offset = 0; offset < len;) {
-                    ret = processBuf(recv + offset, len - offset);
-
-                    if (ret > 0)
-                        offset += ret;
-                    else
-                        break;
-                }
+                processMessage(recv, len);
             } else {
                 ALOGW("read -1: errno=%d\n", errno);
             }
@@ -1491,6 +1590,45 @@ bool HubConnection::threadLoop() {
     return false;
 }
 
+// one event; sensor blocks of different sensors can share it
+void HubConnection::processEvent(uint8_t *buf, size_t len)
+{
+    ssize_t ret;
+
+    for (size_t offset = 0; offset < len;) {
+        ret = processBuf(buf + offset, len - offset);
+
+        if (ret > 0)
+            offset += ret;
+        else
+            break;
+    }
+}
+
+// one read from the driver: an event, or HOST_EVT_BULK with several
+void HubConnection::processMessage(uint8_t *buf, size_t len)
+{
+    uint32_t evtType;
+    size_t offset, evtLen;
+
+    if (len >= sizeof(evtType)) {
+        memcpy(&evtType, buf, sizeof(evtType));
+        if (evtType == HOST_EVT_BULK) {
+            for (offset = sizeof(evtType); offset < len; offset += 1 + evtLen) {
+                evtLen = buf[offset];
+                if (offset + 1 + evtLen > len) {
+                    ALOGW("bulk: event of %zu bytes at %zu overruns len=%zu\n", evtLen, offset, len);
+                    break;
+                }
+                processEvent(buf + offset + 1, evtLen);
+            }
+            return;
+        }
+    }
+
+    processEvent(buf, len);
+}
+
 ssize_t HubConnection::read(sensors_event_t *ev, size_t size) {
     return mRing.read(ev, size);
 }
@@ -1532,6 +1670,9 @@ void HubConnection::initConfigCmd(struct ConfigCmd *cmd, int handle)
 
     // will be a nop if direct report mode is not enabled
     mergeDirectReportRequest(cmd, handle);
+
+    if (cmd->cmd == CONFIG_CMD_ENABLE && mCompressSamples)
+        cmd->flags |= CONFIG_FLAG_COMPRESS;
 }
 
 void HubConnection::queueActivate(int handle, bool enable)
@@ -34,6 +34,7 @@
 #include "eventnums.h"
 #include "halIntf.h"
 #include "hubdefs.h"
+#include "logdict.h"
 #include "ring.h"
 
 #ifdef USE_SENSORSERVICE_TO_GET_FIFO
@@ -105,6 +106,7 @@ private:
     typedef uint32_t rate_q10_t;  // q10 means lower 10 bits are for fractions
 
     bool mWakelockHeld;
+    bool mCompressSamples;
     int32_t mWakeEventCount;
 
     void protectIfWakeEvent(int32_t sensor);
@@ -133,6 +135,11 @@ private:
         CONFIG_CMD_CALIBRATE    = 4,
     };
 
+    enum
+    {
+        CONFIG_FLAG_COMPRESS    = 0x0001,
+    };
+
     struct ConfigCmd
     {
         uint32_t evtType;
@@ -250,6 +257,8 @@ private:
     struct pollfd mPollFds[4];
     int mNumPollFds;
 
+    LogDictionary mLogDict;
+
     sensors_event_t *initEv(sensors_event_t *ev, uint64_t timestamp, uint32_t type, uint32_t sensor);
     uint8_t magAccuracyUpdate(sensors_vec_t *sv);
     void processSample(uint64_t timestamp, uint32_t type, uint32_t sensor, struct OneAxisSample *sample, bool highAccuracy);
@@ -257,7 +266,10 @@ private:
     void processSample(uint64_t timestamp, uint32_t type, uint32_t sensor, struct ThreeAxisSample *sample, bool highAccuracy);
     void postOsLog(uint8_t *buf, ssize_t len);
     void processAppData(uint8_t *buf, ssize_t len);
+    ssize_t processCompressedSamples(uint64_t timestamp, uint32_t type, uint32_t sensor, const uint8_t *buf, size_t len);
     ssize_t processBuf(uint8_t *buf, size_t len);
+    void processEvent(uint8_t *buf, size_t len);
+    void processMessage(uint8_t *buf, size_t len);
 
     inline bool isValidHandle(int handle) {
         return handle >= 0
@@ -29,6 +29,7 @@ LOCAL_C_INCLUDES += \
 LOCAL_SRC_FILES := \
     file.cpp \
     JSONObject.cpp \
+    logdict.cpp \
     ring.cpp
 
 LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_C_INCLUDES)
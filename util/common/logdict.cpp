@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "logdict.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace android {
+
+// From seos.h
+#define OS_LOG_TOKENIZED_FLAG   0x80
+#define OS_LOG_ARG_INT          0
+#define OS_LOG_ARG_INT64        1
+#define OS_LOG_ARG_DOUBLE       2
+#define OS_LOG_ARG_STR          3
+
+namespace {
+
+struct LogArg {
+    int type;
+    uint64_t val;   // zigzag decoded; for OS_LOG_ARG_INT, sign extended from 32 bits
+    double dval;
+    std::string str;
+};
+
+bool getVarint(const uint8_t **p, const uint8_t *end, uint64_t *val) {
+    *val = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        uint8_t b = *(*p)++;
+        *val |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t unzigzag(uint64_t val) {
+    return (val >> 1) ^ -(val & 1);
+}
+
+void appendf(std::string *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void appendf(std::string *out, const char *fmt, ...) {
+    char buf[128];
+    va_list vl;
+
+    va_start(vl, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, vl);
+    va_end(vl);
+    out->append(buf);
+}
+
+void appendArg(std::string *out, std::string spec, char conv, const LogArg *arg) {
+    if (!arg) {
+        out->append("<?>");
+        return;
+    }
+
+    switch (conv) {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+    case 'c':
+        if (arg->type == OS_LOG_ARG_INT || arg->type == OS_LOG_ARG_INT64) {
+            uint64_t val = arg->val;
+            if (arg->type == OS_LOG_ARG_INT && conv != 'd' && conv != 'i') {
+                val &= UINT32_MAX;
+            }
+            if (conv == 'c') {
+                appendf(out, (spec + 'c').c_str(), (int)val);
+            } else {
+                appendf(out, (spec + "ll" + conv).c_str(), (long long)val);
+            }
+            return;
+        }
+        break;
+    case 'p':
+        if (arg->type == OS_LOG_ARG_INT || arg->type == OS_LOG_ARG_INT64) {
+            appendf(out, "0x%08" PRIx64,
+                    arg->type == OS_LOG_ARG_INT ? arg->val & UINT32_MAX : arg->val);
+            return;
+        }
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        if (arg->type == OS_LOG_ARG_DOUBLE) {
+            spec += conv;
+            appendf(out, spec.c_str(), arg->dval);
+            return;
+        }
+        break;
+    case 's':
+        if (arg->type == OS_LOG_ARG_STR) {
+            spec += 's';
+            appendf(out, spec.c_str(), arg->str.c_str());
+            return;
+        }
+        break;
+    }
+
+    // conversion does not match what the firmware sent; show the raw value
+    if (arg->type == OS_LOG_ARG_STR) {
+        appendf(out, "<%s>", arg->str.c_str());
+    } else if (arg->type == OS_LOG_ARG_DOUBLE) {
+        appendf(out, "<%g>", arg->dval);
+    } else {
+        appendf(out, "<0x%" PRIx64 ">", arg->val);
+    }
+}
+
+}  // namespace
+
+LogDictionary::LogDictionary()
+    : mLoaded(false) {
+}
+
+bool LogDictionary::load(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+
+    char buf[4096];
+    size_t len;
+    mStrings.clear();
+    while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
+        mStrings.insert(mStrings.end(), buf, buf + len);
+    }
+    mLoaded = !ferror(f);
+    fclose(f);
+
+    // make sure the last string is terminated
+    mStrings.push_back('\0');
+    return mLoaded;
+}
+
+bool LogDictionary::isLoaded() const {
+    return mLoaded;
+}
+
+bool LogDictionary::isTokenized(const uint8_t *record, size_t len) {
+    return len > 0 && (record[0] & OS_LOG_TOKENIZED_FLAG);
+}
+
+bool LogDictionary::decode(const uint8_t *record, size_t len, char *level,
+                           std::string *text) const {
+    const uint8_t *p = record + 1;
+    const uint8_t *end = record + len;
+    uint64_t token, argTypes;
+    std::vector<LogArg> args;
+
+    if (!isTokenized(record, len) || !getVarint(&p, end, &token)
+            || !getVarint(&p, end, &argTypes)) {
+        return false;
+    }
+    *level = record[0] & ~OS_LOG_TOKENIZED_FLAG;
+
+    for (unsigned i = 0; i < (argTypes & 0x0F) && p < end; i++) {
+        LogArg arg;
+        uint64_t val;
+
+        arg.type = (argTypes >> (4 + 2 * i)) & 0x03;
+        arg.val = 0;
+        arg.dval = 0.0;
+        if (arg.type == OS_LOG_ARG_DOUBLE) {
+            if (end - p < (ptrdiff_t)sizeof(double)) {
+                break;
+            }
+            memcpy(&arg.dval, p, sizeof(double));
+            p += sizeof(double);
+        } else if (!getVarint(&p, end, &val)) {
+            break;
+        } else if (arg.type == OS_LOG_ARG_STR) {
+            if ((uint64_t)(end - p) < val) {
+                break;
+            }
+            arg.str.assign(reinterpret_cast<const char *>(p), val);
+            p += val;
+        } else if (arg.type == OS_LOG_ARG_INT) {
+            arg.val = (uint64_t)(int64_t)(int32_t)(uint32_t)unzigzag(val);
+        } else {
+            arg.val = unzigzag(val);
+        }
+        args.push_back(arg);
+    }
+
+    text->clear();
+    if (token >= mStrings.size()) {
+        appendf(text, "[log token 0x%08" PRIx64 "]", token);
+        for (const LogArg &arg : args) {
+            text->push_back(' ');
+            appendArg(text, "", 0, &arg);
+        }
+        text->push_back('\n');
+        return true;
+    }
+
+    size_t argIdx = 0;
+    for (const char *fmt = &mStrings[token]; *fmt; fmt++) {
+        if (*fmt != '%') {
+            text->push_back(*fmt);
+            continue;
+        } else if (fmt[1] == '%') {
+            text->push_back(*++fmt);
+            continue;
+        }
+
+        // rebuild the conversion without its length modifier; the value is
+        // passed as long long or double whatever the firmware type was
+        std::string spec("%");
+        for (fmt++; *fmt && strchr("-+ #0123456789.*hlLqjzt", *fmt); fmt++) {
+            if (*fmt == '*') {
+                const LogArg *arg = argIdx < args.size() ? &args[argIdx++] : nullptr;
+                spec += std::to_string(arg ? (int)arg->val : 0);
+            } else if (!strchr("hlLqjzt", *fmt)) {
+                spec += *fmt;
+            }
+        }
+        if (!*fmt) {
+            break;
+        }
+        appendArg(text, spec, *fmt, argIdx < args.size() ? &args[argIdx++] : nullptr);
+    }
+
+    return true;
+}
+
+}  // namespace android
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_DICT_H_
+
+#define LOG_DICT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+
+// Decodes tokenized OS log records (see OS_LOG_TOKENIZED in firmware/os/inc/seos.h)
+// using the dictionary extracted from the OS image at build time (os.logdict).
+struct LogDictionary {
+    LogDictionary();
+
+    // Loads the dictionary; returns false if it can't be read.
+    bool load(const char *path);
+    bool isLoaded() const;
+
+    // record points to the level byte of a log message
+    static bool isTokenized(const uint8_t *record, size_t len);
+
+    // Formats a tokenized record; level receives the log level char. Returns
+    // false if the record is malformed. Args missing from a truncated record
+    // are shown as "<?>"; without a matching dictionary entry, the token and
+    // raw args are shown instead of the message.
+    bool decode(const uint8_t *record, size_t len, char *level,
+                std::string *text) const;
+
+private:
+    std::vector<char> mStrings;
+    bool mLoaded;
+
+    LogDictionary(const LogDictionary &) = delete;
+    LogDictionary &operator=(const LogDictionary &) = delete;
+};
+
+}  // namespace android
+
+#endif  // LOG_DICT_H_
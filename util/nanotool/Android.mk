@@ -30,13 +30,15 @@ LOCAL_SRC_FILES := \
     nanomessage.cpp \
     nanotool.cpp \
     resetreasonevent.cpp \
-    sensorevent.cpp
+    sensorevent.cpp \
+    traceevent.cpp
 
 # JSON file handling from chinook
 COMMON_UTILS_DIR := ../common
 LOCAL_SRC_FILES += \
     $(COMMON_UTILS_DIR)/file.cpp \
-    $(COMMON_UTILS_DIR)/JSONObject.cpp
+    $(COMMON_UTILS_DIR)/JSONObject.cpp \
+    $(COMMON_UTILS_DIR)/logdict.cpp
 
 LOCAL_C_INCLUDES := \
     $(LOCAL_PATH)/$(COMMON_UTILS_DIR)
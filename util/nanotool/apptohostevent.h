@@ -52,6 +52,74 @@ struct BrVersionInfoRsp {
     uint32_t bridgeVer;
 } __attribute__((packed));
 
+// From nanohubPacket.h; messages to/from the OS itself
+#define NANOHUB_HAL_QUERY_EVT_DROPS (11)
+
+struct HalEvtDrop {
+    uint32_t evtType; // event number, low 16 bits; origin tid, high 16 bits
+    uint32_t count;
+} __attribute__((packed));
+
+struct HalEvtDropsRsp {
+    uint8_t msg;
+    uint32_t total;
+    HalEvtDrop drops[];
+} __attribute__((packed));
+
+#define NANOHUB_HAL_QUERY_TASK_PROF (12)
+#define NANOHUB_HAL_TASK_PROF_RESET (0x01)
+
+struct HalTaskProfRx {
+    uint8_t msg;
+    uint32_t idx;
+    uint8_t flags;
+} __attribute__((packed));
+
+struct HalTaskProfRsp {
+    uint8_t msg;
+    uint64_t window;
+    uint64_t appId;
+    uint32_t tid;
+    uint32_t evtCnt;
+    uint64_t runTime;
+    uint32_t maxRunTime;
+    uint32_t waitCnt;
+    uint64_t waitTime;
+    uint32_t maxWaitTime;
+} __attribute__((packed));
+
+#define NANOHUB_HAL_TRACE (13)
+
+struct HalTraceRx {
+    uint8_t msg;
+    uint8_t enable;
+} __attribute__((packed));
+
+struct HalTraceRsp {
+    uint8_t msg;
+    uint8_t enabled;
+} __attribute__((packed));
+
+#define NANOHUB_HAL_QUERY_WAKEUP_STATS (14)
+
+struct HalWakeupStatsRsp {
+    uint8_t msg;
+    uint32_t apWakeups;
+    uint32_t apWakeupsLastHour;
+    uint32_t batchWindows;
+    uint32_t batchFlushes;
+} __attribute__((packed));
+
+#define NANOHUB_HAL_QUERY_TIMER_STATS (15)
+
+struct HalTimerStatsRsp {
+    uint8_t msg;
+    uint32_t wakes;
+    uint32_t fired;
+    uint32_t coalesced;
+    uint32_t wakesPerSec;
+} __attribute__((packed));
+
 // The u64 appId used in nanohub is 40 bits vendor ID + 24 bits app ID (see seos.h)
 constexpr uint64_t MakeAppId(uint64_t vendorId, uint32_t appId) {
     return (vendorId << 24) | (appId & 0x00FFFFFF);
@@ -70,6 +138,7 @@ constexpr uint64_t kAppIdSTMicroLps22hb    = MakeAppId(kAppIdVendorSTMicro, 1);
 constexpr uint64_t kAppIdSTMicroMag40      = MakeAppId(kAppIdVendorSTMicro, 3);
 
 constexpr uint64_t kAppIdBridge = MakeAppId(kAppIdVendorGoogle, 50);
+constexpr uint64_t kAppIdNanohubOs = MakeAppId(kAppIdVendorGoogle, 0);
 
 /*
  * These classes represent events sent with event type EVT_APP_TO_HOST. This is
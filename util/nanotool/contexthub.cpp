@@ -16,14 +16,21 @@
 
 #include "contexthub.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <cstring>
 #include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
 #include <vector>
 
 #include "apptohostevent.h"
 #include "log.h"
+#include "logdict.h"
+#include "logevent.h"
 #include "resetreasonevent.h"
 #include "sensorevent.h"
+#include "traceevent.h"
 #include "util.h"
 
 namespace android {
@@ -33,6 +40,9 @@ namespace android {
 constexpr int kCalibrationTimeoutMs(10000);
 constexpr int kTestTimeoutMs(10000);
 constexpr int kBridgeVersionTimeoutMs(500);
+constexpr int kTaskProfileTimeoutMs(500);
+constexpr int kTraceDrainTimeoutMs(1000);
+constexpr int kOsQueryTimeoutMs(500);
 
 struct SensorTypeNames {
     SensorType sensor_type;
@@ -326,6 +336,301 @@ bool ContextHub::PrintBridgeVersion() {
     return success;
 }
 
+bool ContextHub::QueryTaskProfile(uint32_t index, bool reset,
+        HalTaskProfRsp *rsp, bool *have) {
+    TaskProfileRequest request(index, reset);
+    TransportResult result = WriteEvent(request);
+    if (result != TransportResult::Success) {
+        LOGE("Failed to send task profile request: %d",
+             static_cast<int>(result));
+        return false;
+    }
+
+    bool success = false;
+    auto event_handler = [&](const AppToHostEvent &event) -> bool {
+        const uint8_t *data = event.GetDataPtr();
+        size_t min_len = offsetof(HalTaskProfRsp, appId);
+
+        if (event.GetAppId() != kAppIdNanohubOs || event.GetDataLen() < 1
+                || data[0] != NANOHUB_HAL_QUERY_TASK_PROF) {
+            LOGD("Ignored unexpected app to host event");
+            return true;
+        } else if (event.GetDataLen() < min_len) {
+            LOGE("Got short task profile response: length %u, expected at "
+                 "least %zu", event.GetDataLen(), min_len);
+            return false;
+        }
+
+        *have = event.GetDataLen() >= sizeof(HalTaskProfRsp);
+        memset(rsp, 0, sizeof(*rsp));
+        memcpy(rsp, data, *have ? sizeof(HalTaskProfRsp) : min_len);
+        success = true;
+        return false;
+    };
+
+    result = ReadAppEvents(event_handler, kTaskProfileTimeoutMs);
+    if (result != TransportResult::Success) {
+        LOGE("Error reading task profile response %d", static_cast<int>(result));
+        return false;
+    }
+
+    return success;
+}
+
+bool ContextHub::PrintTaskProfile(unsigned int interval_sec) {
+    std::vector<HalTaskProfRsp> tasks;
+    HalTaskProfRsp rsp;
+    bool have = true;
+
+    // The first query only serves to start a fresh measurement window
+    if (!QueryTaskProfile(0, true, &rsp, &have)) {
+        return false;
+    }
+    sleep(interval_sec);
+
+    for (uint32_t i = 0; have; i++) {
+        if (!QueryTaskProfile(i, false, &rsp, &have)) {
+            return false;
+        } else if (have) {
+            tasks.push_back(rsp);
+        }
+    }
+
+    std::sort(tasks.begin(), tasks.end(),
+        [](const HalTaskProfRsp& a, const HalTaskProfRsp& b) {
+            return a.runTime > b.runTime;
+        });
+
+    uint64_t window = tasks.size() ? tasks[0].window : 0;
+    printf("Task profile over %.3f s\n", window / 1e9);
+    printf("%-18s %5s %6s %8s %9s %9s %9s %9s\n", "APP ID", "TID", "CPU%",
+           "EVENTS", "AVG(us)", "MAX(us)", "WAIT(us)", "WMAX(us)");
+    for (const HalTaskProfRsp& task : tasks) {
+        printf("0x%016" PRIx64 " %5" PRIu32 " %6.2f %8" PRIu32 " %9.1f %9.1f %9.1f"
+               " %9.1f\n", task.appId, task.tid,
+               window ? 100.0 * task.runTime / window : 0.0, task.evtCnt,
+               task.evtCnt ? task.runTime / 1e3 / task.evtCnt : 0.0,
+               task.maxRunTime / 1e3,
+               task.waitCnt ? task.waitTime / 1e3 / task.waitCnt : 0.0,
+               task.maxWaitTime / 1e3);
+    }
+
+    return true;
+}
+
+bool ContextHub::QueryOs(uint8_t msg, size_t min_len,
+        std::vector<uint8_t> *rsp) {
+    TransportResult result = WriteEvent(OsQueryRequest(msg));
+    if (result != TransportResult::Success) {
+        LOGE("Failed to send OS query %u: %d", msg, static_cast<int>(result));
+        return false;
+    }
+
+    bool success = false;
+    auto event_handler = [&](const AppToHostEvent &event) -> bool {
+        const uint8_t *data = event.GetDataPtr();
+
+        if (event.GetAppId() != kAppIdNanohubOs || event.GetDataLen() < 1
+                || data[0] != msg) {
+            LOGD("Ignored unexpected app to host event");
+            return true;
+        } else if (event.GetDataLen() < min_len) {
+            LOGE("Got short response to OS query %u: length %u, expected at "
+                 "least %zu", msg, event.GetDataLen(), min_len);
+            return false;
+        }
+
+        rsp->assign(data, data + event.GetDataLen());
+        success = true;
+        return false;
+    };
+
+    result = ReadAppEvents(event_handler, kOsQueryTimeoutMs);
+    if (result != TransportResult::Success) {
+        LOGE("Error reading response to OS query %u: %d", msg,
+             static_cast<int>(result));
+        return false;
+    }
+
+    return success;
+}
+
+bool ContextHub::PrintStats() {
+    std::vector<uint8_t> rsp;
+
+    if (!QueryOs(NANOHUB_HAL_QUERY_WAKEUP_STATS, sizeof(HalWakeupStatsRsp),
+            &rsp)) {
+        return false;
+    }
+
+    auto wakeups = reinterpret_cast<const HalWakeupStatsRsp *>(rsp.data());
+    printf("AP wakeups:\n"
+           "  Since boot:      %" PRIu32 "\n"
+           "  Last hour:       %" PRIu32 "\n"
+           "  Batch windows:   %" PRIu32 "\n"
+           "  Batch flushes:   %" PRIu32 "\n",
+           wakeups->apWakeups, wakeups->apWakeupsLastHour,
+           wakeups->batchWindows, wakeups->batchFlushes);
+
+    if (!QueryOs(NANOHUB_HAL_QUERY_TIMER_STATS, sizeof(HalTimerStatsRsp),
+            &rsp)) {
+        return false;
+    }
+
+    auto timers = reinterpret_cast<const HalTimerStatsRsp *>(rsp.data());
+    printf("Timer wakeups:\n"
+           "  Since boot:      %" PRIu32 "\n"
+           "  Last second:     %" PRIu32 "\n"
+           "  Timers fired:    %" PRIu32 "\n"
+           "  Coalesced:       %" PRIu32 "\n",
+           timers->wakes, timers->wakesPerSec, timers->fired,
+           timers->coalesced);
+
+    if (!QueryOs(NANOHUB_HAL_QUERY_EVT_DROPS, sizeof(HalEvtDropsRsp), &rsp)) {
+        return false;
+    }
+
+    auto drops = reinterpret_cast<const HalEvtDropsRsp *>(rsp.data());
+    size_t count = (rsp.size() - sizeof(HalEvtDropsRsp)) / sizeof(HalEvtDrop);
+    printf("Events dropped:    %" PRIu32 "\n", drops->total);
+    for (size_t i = 0; i < count; i++) {
+        printf("  Event 0x%04" PRIx32 " from tid %-4" PRIu32 " %" PRIu32 "\n",
+               drops->drops[i].evtType & 0x7FFF, drops->drops[i].evtType >> 16,
+               drops->drops[i].count);
+    }
+
+    return true;
+}
+
+ContextHub::TransportResult ContextHub::CollectTrace(
+        std::vector<TraceRecord>& records, int duration_ms, int *enabled) {
+    using Milliseconds = std::chrono::milliseconds;
+
+    SteadyClock end_time = std::chrono::steady_clock::now()
+        + Milliseconds(duration_ms);
+
+    while (true) {
+        int timeout_ms = std::chrono::duration_cast<Milliseconds>(
+            end_time - std::chrono::steady_clock::now()).count();
+        if (timeout_ms <= 0) {
+            return TransportResult::Success;
+        }
+
+        std::unique_ptr<ReadEventResponse> event;
+        TransportResult result = ReadEvent(&event, timeout_ms);
+        if (result == TransportResult::Timeout) {
+            return TransportResult::Success;
+        } else if (result == TransportResult::ParseFailure) {
+            LOGE("Error %d while reading", static_cast<int>(result));
+            continue;
+        } else if (result != TransportResult::Success) {
+            LOGE("Error %d while reading", static_cast<int>(result));
+            return result;
+        }
+
+        if (event->IsTraceEvent()) {
+            reinterpret_cast<TraceEvent *>(event.get())->GetRecords(records);
+        } else if (event->IsAppToHostEvent()) {
+            auto app_event = reinterpret_cast<AppToHostEvent *>(event.get());
+            const uint8_t *data = app_event->GetDataPtr();
+
+            if (app_event->GetAppId() == kAppIdNanohubOs
+                    && app_event->GetDataLen() >= sizeof(HalTraceRsp)
+                    && data[0] == NANOHUB_HAL_TRACE) {
+                *enabled = reinterpret_cast<const HalTraceRsp *>(data)->enabled;
+            }
+        } else {
+            LOGD("Ignoring non-trace event");
+        }
+    }
+}
+
+bool ContextHub::RecordTrace(unsigned int duration_sec,
+        const std::string& filename) {
+    std::vector<TraceRecord> records;
+    int enabled = -1;
+
+    TransportResult result = WriteEvent(TraceRequest(true));
+    if (result != TransportResult::Success) {
+        LOGE("Failed to send trace enable request: %d",
+             static_cast<int>(result));
+        return false;
+    }
+
+    printf("Tracing for %u seconds...\n", duration_sec);
+    result = CollectTrace(records, duration_sec * 1000, &enabled);
+    if (enabled == 0) {
+        LOGE("Tracing is not supported by this firmware (built without "
+             "OS_TRACE)");
+        return false;
+    } else if (enabled < 0) {
+        LOGW("No reply to trace enable request");
+    }
+
+    // Turning the trace off drains the rest of the ring; keep reading until
+    // the hub goes quiet
+    if (WriteEvent(TraceRequest(false)) != TransportResult::Success) {
+        LOGE("Failed to send trace disable request");
+    } else if (result == TransportResult::Success) {
+        result = CollectTrace(records, kTraceDrainTimeoutMs, &enabled);
+    }
+
+    if (records.empty()) {
+        LOGE("No trace records received");
+        return false;
+    }
+
+    FILE *out = fopen(filename.c_str(), "w");
+    if (!out) {
+        LOGE("Couldn't open %s for writing: %s", filename.c_str(),
+             strerror(errno));
+        return false;
+    }
+
+    bool success = TraceEvent::WriteChromeJson(out, records);
+    if (fclose(out) || !success) {
+        LOGE("Error writing %s", filename.c_str());
+        return false;
+    }
+
+    printf("Wrote %zu trace records to %s\n", records.size(),
+           filename.c_str());
+    return true;
+}
+
+bool ContextHub::PrintLogEvents(const std::string& dict_filename,
+        unsigned int limit) {
+    LogDictionary dict;
+    bool continuous = (limit == 0);
+
+    if (!dict_filename.empty() && !dict.load(dict_filename.c_str())) {
+        LOGE("Couldn't load log dictionary %s", dict_filename.c_str());
+        return false;
+    }
+
+    while (continuous || limit > 0) {
+        std::unique_ptr<ReadEventResponse> event;
+        TransportResult result = ReadEvent(&event);
+        if (result == TransportResult::Success && event->IsLogEvent()) {
+            std::string message = reinterpret_cast<LogEvent *>(
+                event.get())->GetMessage(dict_filename.empty() ? nullptr : &dict);
+            if (!message.empty()) {
+                printf("%s", message.c_str());
+                limit--;
+            }
+        } else if (result != TransportResult::Success) {
+            LOGE("Error %d while reading", static_cast<int>(result));
+            if (result != TransportResult::ParseFailure) {
+                return false;
+            }
+        } else {
+            LOGD("Ignoring non-log event");
+        }
+    }
+
+    return true;
+}
+
 void ContextHub::PrintSensorEvents(SensorType type, int limit) {
     bool continuous = (limit == 0);
     auto event_printer = [type, &limit, continuous](const SensorEvent& event) -> bool {
@@ -28,6 +28,8 @@ namespace android {
 
 class AppToHostEvent;
 class SensorEvent;
+struct HalTaskProfRsp;
+struct TraceRecord;
 
 // Array length helper macro
 #define ARRAY_LEN(arr) (sizeof(arr) / sizeof(arr[0]))
@@ -181,6 +183,30 @@ class ContextHub : public NonCopyable {
      */
     bool PrintBridgeVersion();
 
+    /*
+     * Resets the per-task profiles kept by the OS, waits interval_sec seconds,
+     * then prints CPU time and event latency of each task, busiest first
+     */
+    bool PrintTaskProfile(unsigned int interval_sec);
+
+    /*
+     * Turns on the OS binary trace for duration_sec seconds, then writes what
+     * was collected to filename as Chrome trace event JSON
+     */
+    bool RecordTrace(unsigned int duration_sec, const std::string& filename);
+
+    /*
+     * Prints the counters the OS keeps on how often it wakes up the AP
+     */
+    bool PrintStats();
+
+    /*
+     * Prints up to <limit> log messages from the OS, or continues indefinitely
+     * if limit is 0. Tokenized messages are decoded with the log dictionary in
+     * dict_filename, if given.
+     */
+    bool PrintLogEvents(const std::string& dict_filename, unsigned int limit);
+
     /*
      * Prints up to <sample_limit> incoming sensor samples corresponding to the
      * given SensorType, ignoring other events. If sample_limit is 0, then
@@ -226,6 +252,27 @@ class ContextHub : public NonCopyable {
     bool HandleTestResult(const SensorSpec& sensor,
         const AppToHostEvent &event);
 
+    /*
+     * Fetches the profile of the task at the given index from the OS; have is
+     * set to false when index is past the last task
+     */
+    bool QueryTaskProfile(uint32_t index, bool reset, HalTaskProfRsp *rsp,
+        bool *have);
+
+    /*
+     * Sends the OS a query that takes no arguments, and returns its reply
+     * (starting with msg) in rsp. Fails on replies shorter than min_len.
+     */
+    bool QueryOs(uint8_t msg, size_t min_len, std::vector<uint8_t> *rsp);
+
+    /*
+     * Reads events for duration_ms, appending the records of any TraceEvents
+     * to records. If the OS answers a trace request in that time, enabled is
+     * set to its reply (0 or 1); otherwise it is left alone.
+     */
+    TransportResult CollectTrace(std::vector<TraceRecord>& records,
+        int duration_ms, int *enabled);
+
     /*
      * Same as ReadSensorEvents, but filters on AppToHostEvent instead of
      * SensorEvent.
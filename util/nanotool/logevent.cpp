@@ -15,6 +15,7 @@
  */
 
 #include "log.h"
+#include "logdict.h"
 #include "logevent.h"
 
 namespace android {
@@ -29,7 +30,7 @@ std::unique_ptr<LogEvent> LogEvent::FromBytes(
     return event;
 }
 
-std::string LogEvent::GetMessage() const {
+std::string LogEvent::GetMessage(const LogDictionary *dict) const {
     constexpr size_t kHeaderSize = sizeof(uint32_t) // Message type.
         + sizeof(char) // Log level.
         + sizeof(char); // Beginning of log message.
@@ -37,6 +38,18 @@ std::string LogEvent::GetMessage() const {
     if (event_data.size() < kHeaderSize) {
         LOGW("Invalid/short LogEvent event of size %zu", event_data.size());
         return std::string();
+    } else if (LogDictionary::isTokenized(event_data.data() + sizeof(uint32_t),
+                                          event_data.size() - sizeof(uint32_t))) {
+        std::string text;
+        char level;
+
+        if (!dict || !dict->decode(event_data.data() + sizeof(uint32_t),
+                                   event_data.size() - sizeof(uint32_t),
+                                   &level, &text)) {
+            LOGW("Can't decode tokenized LogEvent (no log dictionary?)");
+            return std::string();
+        }
+        return level + text;
     } else {
         const char *message = reinterpret_cast<const char *>(
             event_data.data() + sizeof(uint32_t));
@@ -21,6 +21,8 @@
 
 namespace android {
 
+struct LogDictionary;
+
 class LogEvent : public ReadEventResponse {
   public:
     /*
@@ -32,8 +34,10 @@ class LogEvent : public ReadEventResponse {
     static std::unique_ptr<LogEvent> FromBytes(
         const std::vector<uint8_t>& buffer);
 
-    // Returns a string containing the contents of the log message.
-    std::string GetMessage() const;
+    // Returns a string containing the contents of the log message, prefixed
+    // by its level character. Tokenized messages are decoded using dict; the
+    // result is empty if that is not possible.
+    std::string GetMessage(const LogDictionary *dict = nullptr) const;
 };
 
 }  // namespace android
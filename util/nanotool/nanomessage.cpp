@@ -24,6 +24,7 @@
 #include "logevent.h"
 #include "resetreasonevent.h"
 #include "sensorevent.h"
+#include "traceevent.h"
 
 namespace android {
 
@@ -122,6 +123,8 @@ std::unique_ptr<ReadEventResponse> ReadEventResponse::FromBytes(
         return ResetReasonEvent::FromBytes(buffer);
     } else if (ReadEventResponse::IsLogEvent(event_type)) {
         return LogEvent::FromBytes(buffer);
+    } else if (ReadEventResponse::IsTraceEvent(event_type)) {
+        return TraceEvent::FromBytes(buffer);
     } else {
         LOGW("Received unexpected/unsupported event type %u", event_type);
         return nullptr;
@@ -154,6 +157,10 @@ bool ReadEventResponse::IsLogEvent() const {
     return ReadEventResponse::IsLogEvent(GetEventType());
 }
 
+bool ReadEventResponse::IsTraceEvent() const {
+    return ReadEventResponse::IsTraceEvent(GetEventType());
+}
+
 uint32_t ReadEventResponse::GetEventType() const {
     return ReadEventResponse::EventTypeFromBuffer(event_data);
 }
@@ -175,6 +182,10 @@ bool ReadEventResponse::IsLogEvent(uint32_t event_type) {
     return (event_type == static_cast<uint32_t>(EventType::LogEvent));
 }
 
+bool ReadEventResponse::IsTraceEvent(uint32_t event_type) {
+    return (event_type == static_cast<uint32_t>(EventType::TraceEvent));
+}
+
 uint32_t ReadEventResponse::EventTypeFromBuffer(const std::vector<uint8_t>& buffer) {
     if (buffer.size() < sizeof(uint32_t)) {
         LOGW("Invalid/short event of size %zu", buffer.size());
@@ -262,4 +273,97 @@ std::string BridgeVersionInfoRequest::ToString() const {
     return std::string("Bridge version info request\n");
 }
 
+/* TaskProfileRequest *********************************************************/
+
+std::vector<uint8_t> TaskProfileRequest::GetBytes() const {
+    struct TaskProfileRequestEvent : public Event {
+        struct HostHubRawPacket hdr;
+        struct HalTaskProfRx req;
+    } __attribute__((packed));
+
+    std::vector<uint8_t> buffer(sizeof(TaskProfileRequestEvent));
+
+    std::fill(buffer.begin(), buffer.end(), 0);
+    auto event = reinterpret_cast<TaskProfileRequestEvent *>(buffer.data());
+    event->event_type = static_cast<uint32_t>(EventType::AppFromHostEvent);
+    event->hdr.appId = kAppIdNanohubOs;
+    event->hdr.dataLen = sizeof(HalTaskProfRx);
+    event->req.msg = NANOHUB_HAL_QUERY_TASK_PROF;
+    event->req.idx = index_;
+    event->req.flags = reset_ ? NANOHUB_HAL_TASK_PROF_RESET : 0;
+
+    return buffer;
+}
+
+EventType TaskProfileRequest::GetEventType() const {
+    return EventType::AppFromHostEvent;
+}
+
+std::string TaskProfileRequest::ToString() const {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "Task profile request: index %" PRIu32
+             "%s\n", index_, reset_ ? ", reset" : "");
+    return std::string(buffer);
+}
+
+/* TraceRequest ***************************************************************/
+
+std::vector<uint8_t> TraceRequest::GetBytes() const {
+    struct TraceRequestEvent : public Event {
+        struct HostHubRawPacket hdr;
+        struct HalTraceRx req;
+    } __attribute__((packed));
+
+    std::vector<uint8_t> buffer(sizeof(TraceRequestEvent));
+
+    std::fill(buffer.begin(), buffer.end(), 0);
+    auto event = reinterpret_cast<TraceRequestEvent *>(buffer.data());
+    event->event_type = static_cast<uint32_t>(EventType::AppFromHostEvent);
+    event->hdr.appId = kAppIdNanohubOs;
+    event->hdr.dataLen = sizeof(HalTraceRx);
+    event->req.msg = NANOHUB_HAL_TRACE;
+    event->req.enable = enable_ ? 1 : 0;
+
+    return buffer;
+}
+
+EventType TraceRequest::GetEventType() const {
+    return EventType::AppFromHostEvent;
+}
+
+std::string TraceRequest::ToString() const {
+    return std::string(enable_ ? "Trace enable request\n" :
+                       "Trace disable request\n");
+}
+
+/* OsQueryRequest *************************************************************/
+
+std::vector<uint8_t> OsQueryRequest::GetBytes() const {
+    struct OsQueryRequestEvent : public Event {
+        struct HostHubRawPacket hdr;
+        uint8_t msg;
+    } __attribute__((packed));
+
+    std::vector<uint8_t> buffer(sizeof(OsQueryRequestEvent));
+
+    std::fill(buffer.begin(), buffer.end(), 0);
+    auto event = reinterpret_cast<OsQueryRequestEvent *>(buffer.data());
+    event->event_type = static_cast<uint32_t>(EventType::AppFromHostEvent);
+    event->hdr.appId = kAppIdNanohubOs;
+    event->hdr.dataLen = sizeof(event->msg);
+    event->msg = msg_;
+
+    return buffer;
+}
+
+EventType OsQueryRequest::GetEventType() const {
+    return EventType::AppFromHostEvent;
+}
+
+std::string OsQueryRequest::ToString() const {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "OS query %" PRIu8 "\n", msg_);
+    return std::string(buffer);
+}
+
 }  // namespace android
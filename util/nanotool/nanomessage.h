@@ -37,6 +37,7 @@ enum class EventType {
     AppToHostEvent   = 0x00000401,
     ResetReasonEvent = 0x00000403,
     LogEvent         = 0x474F4C41,
+    TraceEvent       = 0x45435254,
 };
 
 /*
@@ -142,6 +143,7 @@ class ReadEventResponse : public NanoResponse {
     bool IsSensorEvent() const;
     bool IsResetReasonEvent() const;
     bool IsLogEvent() const;
+    bool IsTraceEvent() const;
     uint32_t GetEventType() const;
 
     // Event data associated with this response.
@@ -153,6 +155,7 @@ class ReadEventResponse : public NanoResponse {
     static bool IsSensorEvent(uint32_t event_type);
     static bool IsResetReasonEvent(uint32_t event_type);
     static bool IsLogEvent(uint32_t event_type);
+    static bool IsTraceEvent(uint32_t event_type);
 };
 
 /*
@@ -202,6 +205,53 @@ class BridgeVersionInfoRequest : public WriteEventRequest {
     std::string ToString() const override;
 };
 
+/*
+ * Fetches per-task profiling data for one task from the OS, optionally
+ * resetting all task profiles afterwards.
+ */
+class TaskProfileRequest : public WriteEventRequest {
+  public:
+    TaskProfileRequest(uint32_t index, bool reset) :
+        index_(index), reset_(reset) {};
+    std::vector<uint8_t> GetBytes() const override;
+    EventType GetEventType() const override;
+    std::string ToString() const override;
+
+  private:
+    uint32_t index_;
+    bool reset_;
+};
+
+/*
+ * Turns the OS binary trace on or off. Records are streamed back as
+ * TraceEvents while it is on; turning it off drains what is left.
+ */
+class TraceRequest : public WriteEventRequest {
+  public:
+    TraceRequest(bool enable) : enable_(enable) {};
+    std::vector<uint8_t> GetBytes() const override;
+    EventType GetEventType() const override;
+    std::string ToString() const override;
+
+  private:
+    bool enable_;
+};
+
+/*
+ * A query to the OS that takes no arguments, such as
+ * NANOHUB_HAL_QUERY_WAKEUP_STATS
+ */
+class OsQueryRequest : public WriteEventRequest {
+  public:
+    OsQueryRequest(uint8_t msg) : msg_(msg) {};
+    std::vector<uint8_t> GetBytes() const override;
+    EventType GetEventType() const override;
+    std::string ToString() const override;
+
+  private:
+    uint8_t msg_;
+};
+
 }  // namespace android
 
 #endif  // NANOMESSAGE_H_
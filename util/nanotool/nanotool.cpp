@@ -49,6 +49,10 @@ enum class NanotoolCommand {
     LoadCalibration,
     Flash,
     GetBridgeVer,
+    TaskProfile,
+    Trace,
+    Log,
+    Stats,
 };
 
 struct ParsedArgs {
@@ -72,6 +76,10 @@ static NanotoolCommand StrToCommand(const char *command_name) {
         std::make_tuple("load_cal",    NanotoolCommand::LoadCalibration),
         std::make_tuple("flash",       NanotoolCommand::Flash),
         std::make_tuple("bridge_ver",  NanotoolCommand::GetBridgeVer),
+        std::make_tuple("top",         NanotoolCommand::TaskProfile),
+        std::make_tuple("trace",       NanotoolCommand::Trace),
+        std::make_tuple("log",         NanotoolCommand::Log),
+        std::make_tuple("stats",       NanotoolCommand::Stats),
     };
 
     if (!command_name) {
@@ -106,10 +114,18 @@ static void PrintUsage(const char *name) {
         "                        flash: load a new firmware image to the hub\n"
 #endif
         "                        load_cal: send data from calibration file to hub\n"
+        "                        log: print OS log messages, decoding tokenized ones\n"
+        "                           with the log dictionary (os.logdict) given by -f\n"
         "                        poll (default): enable the sensor, output received\n"
         "                           events, then disable the sensor before exiting\n"
         "                        read: output events for the given sensor, or all events\n"
         "                           if no sensor specified\n"
+        "                        stats: show how often the hub wakes up the AP and\n"
+        "                           itself, and which events it had to drop\n"
+        "                        top: show CPU time and event latency of each task,\n"
+        "                           measured over -c seconds (default 1)\n"
+        "                        trace: record an OS trace for -c seconds (default 5)\n"
+        "                           and write it to -f as Chrome/Perfetto JSON\n"
         "\n"
         "  -s, --sensor       Specify sensor type, and parameters for the command.\n"
         "                     Format is sensor_type[:rate[:latency_ms]][=cal_ref].\n"
@@ -128,7 +144,7 @@ static void PrintUsage(const char *name) {
         "                     read indefinitely (the default behavior)\n"
         "\n"
         "  -f, --file\n"
-        "                     Specifies the file to be used with flash.\n"
+        "                     Specifies the file to be used with flash, trace or log.\n"
         "\n"
         "  -l, --log          Outputs logs from the sensor hub as they become available.\n"
         "                     The logs will be printed inline with sensor samples.\n"
@@ -171,7 +187,8 @@ static bool ValidateArgs(std::unique_ptr<ParsedArgs>& args, const char *name) {
         return false;
     }
 
-    if (args->command == NanotoolCommand::Flash
+    if ((args->command == NanotoolCommand::Flash
+            || args->command == NanotoolCommand::Trace)
             && args->filename.empty()) {
         fprintf(stderr, "%s: A filename must be specified for this command "
                         "(use -f)\n",
@@ -488,6 +505,23 @@ int main(int argc, char **argv) {
         success = hub->PrintBridgeVersion();
         break;
       }
+      case NanotoolCommand::TaskProfile: {
+        success = hub->PrintTaskProfile(args->count ? args->count : 1);
+        break;
+      }
+      case NanotoolCommand::Log: {
+        success = hub->PrintLogEvents(args->filename, args->count);
+        break;
+      }
+      case NanotoolCommand::Trace: {
+        success = hub->RecordTrace(args->count ? args->count : 5,
+                                   args->filename);
+        break;
+      }
+      case NanotoolCommand::Stats: {
+        success = hub->PrintStats();
+        break;
+      }
       default:
         LOGE("Command not implemented");
         return 1;
@@ -497,7 +531,8 @@ int main(int argc, char **argv) {
         LOGE("Command failed");
         return -1;
     } else if (args->command != NanotoolCommand::Read
-                   && args->command != NanotoolCommand::Poll) {
+                   && args->command != NanotoolCommand::Poll
+                   && args->command != NanotoolCommand::Log) {
         printf("Operation completed successfully\n");
     }
 
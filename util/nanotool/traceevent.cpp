@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "traceevent.h"
+
+#include <inttypes.h>
+#include <cstring>
+
+#include "log.h"
+
+namespace android {
+
+/* TraceEvent *****************************************************************/
+
+std::unique_ptr<TraceEvent> TraceEvent::FromBytes(
+        const std::vector<uint8_t>& buffer) {
+    auto event = std::unique_ptr<TraceEvent>(new TraceEvent());
+    event->Populate(buffer);
+
+    return event;
+}
+
+void TraceEvent::GetRecords(std::vector<TraceRecord>& records) const {
+    size_t len = event_data.size() - sizeof(uint32_t);
+
+    if (len % sizeof(TraceRecord)) {
+        LOGW("TraceEvent of size %zu has a partial record", event_data.size());
+    }
+
+    for (size_t offset = 0; offset + sizeof(TraceRecord) <= len;
+            offset += sizeof(TraceRecord)) {
+        TraceRecord rec;
+        memcpy(&rec, event_data.data() + sizeof(uint32_t) + offset,
+               sizeof(rec));
+        records.push_back(rec);
+    }
+}
+
+bool TraceEvent::WriteChromeJson(FILE *out,
+        const std::vector<TraceRecord>& records) {
+    int64_t ticks = 0;
+    uint32_t prev = records.size() ? records[0].time : 0;
+    const char *sep = "";
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (const TraceRecord& rec : records) {
+        char name[32];
+        char args[96];
+        char phase = 'i';
+
+        // Records are in order, except that a Lost marker carries the time
+        // it was noticed; a signed delta copes with both that and the wrap
+        ticks += static_cast<int32_t>(rec.time - prev);
+        prev = rec.time;
+
+        switch (static_cast<TraceRecordId>(rec.id)) {
+          case TraceRecordId::TaskBegin:
+            phase = 'B';
+            snprintf(name, sizeof(name), "evt 0x%08" PRIx32, rec.arg0);
+            snprintf(args, sizeof(args), "\"evtType\":%" PRIu32 ",\"from\":%"
+                     PRIu32, rec.arg0, rec.arg1);
+            break;
+          case TraceRecordId::TaskEnd:
+            phase = 'E';
+            snprintf(name, sizeof(name), "evt 0x%08" PRIx32, rec.arg0);
+            args[0] = '\0';
+            break;
+          case TraceRecordId::EvtEnqueue:
+            snprintf(name, sizeof(name), "enqueue 0x%08" PRIx32, rec.arg0);
+            snprintf(args, sizeof(args), "\"prio\":%" PRIu32 ",\"atFront\":%d",
+                     rec.arg1 & 0x7FFFFFFF, rec.arg1 >> 31);
+            break;
+          case TraceRecordId::TimerBegin:
+            phase = 'B';
+            snprintf(name, sizeof(name), "timer %" PRIu32, rec.arg0);
+            snprintf(args, sizeof(args), "\"data\":\"0x%08" PRIx32 "\"",
+                     rec.arg1);
+            break;
+          case TraceRecordId::TimerEnd:
+            phase = 'E';
+            snprintf(name, sizeof(name), "timer %" PRIu32, rec.arg0);
+            args[0] = '\0';
+            break;
+          case TraceRecordId::SpiStart:
+            snprintf(name, sizeof(name), "spi start");
+            snprintf(args, sizeof(args), "\"dev\":\"0x%08" PRIx32 "\","
+                     "\"packets\":%" PRIu32, rec.arg0, rec.arg1);
+            break;
+          case TraceRecordId::SpiDone:
+            snprintf(name, sizeof(name), "spi done");
+            snprintf(args, sizeof(args), "\"dev\":\"0x%08" PRIx32 "\","
+                     "\"err\":%" PRId32, rec.arg0,
+                     static_cast<int32_t>(rec.arg1));
+            break;
+          case TraceRecordId::I2cStart:
+            snprintf(name, sizeof(name), "i2c start");
+            snprintf(args, sizeof(args), "\"bus\":%" PRIu32 ",\"addr\":\"0x%02"
+                     PRIx32 "\",\"tx\":%" PRIu32 ",\"rx\":%" PRIu32,
+                     rec.arg0 >> 8, rec.arg0 & 0xFF, rec.arg1 >> 16,
+                     rec.arg1 & 0xFFFF);
+            break;
+          case TraceRecordId::I2cDone:
+            snprintf(name, sizeof(name), "i2c done");
+            snprintf(args, sizeof(args), "\"tx\":%" PRIu32 ",\"rx\":%" PRIu32
+                     ",\"err\":%" PRId32, rec.arg0 >> 16, rec.arg0 & 0xFFFF,
+                     static_cast<int32_t>(rec.arg1));
+            break;
+          case TraceRecordId::HeapAlloc:
+            snprintf(name, sizeof(name), "heap alloc");
+            snprintf(args, sizeof(args), "\"size\":%" PRIu32 ",\"block\":\"0x%08"
+                     PRIx32 "\"", rec.arg0, rec.arg1);
+            break;
+          case TraceRecordId::HeapFree:
+            snprintf(name, sizeof(name), "heap free");
+            snprintf(args, sizeof(args), "\"block\":\"0x%08" PRIx32 "\"",
+                     rec.arg0);
+            break;
+          case TraceRecordId::HeapFreeAll:
+            snprintf(name, sizeof(name), "heap free all");
+            snprintf(args, sizeof(args), "\"tid\":%" PRIu32 ",\"blocks\":%"
+                     PRIu32, rec.arg0, rec.arg1);
+            break;
+          case TraceRecordId::Lost:
+            snprintf(name, sizeof(name), "lost");
+            snprintf(args, sizeof(args), "\"records\":%" PRIu32, rec.arg0);
+            break;
+          default:
+            snprintf(name, sizeof(name), "id %" PRIu16, rec.id);
+            snprintf(args, sizeof(args), "\"arg0\":%" PRIu32 ",\"arg1\":%"
+                     PRIu32, rec.arg0, rec.arg1);
+            break;
+        }
+
+        // 1 tick = 1024 ns; ts is in us
+        fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":0,"
+                "\"tid\":%" PRIu16 "%s\"args\":{%s}}", sep, name, phase,
+                ticks * 1.024, rec.tid, phase == 'i' ? ",\"s\":\"t\"," : ",",
+                args);
+        sep = ",\n";
+    }
+    fprintf(out, "\n]}\n");
+
+    return !ferror(out);
+}
+
+}  // namespace android
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACE_EVENT_H_
+#define TRACE_EVENT_H_
+
+#include <cstdio>
+
+#include "nanomessage.h"
+
+namespace android {
+
+// From trace.h
+enum class TraceRecordId : uint16_t {
+    TaskBegin   = 1,
+    TaskEnd     = 2,
+    EvtEnqueue  = 3,
+    TimerBegin  = 4,
+    TimerEnd    = 5,
+    SpiStart    = 6,
+    SpiDone     = 7,
+    I2cStart    = 8,
+    I2cDone     = 9,
+    HeapAlloc   = 10,
+    HeapFree    = 11,
+    HeapFreeAll = 12,
+    Lost        = 0xFFFF,
+};
+
+struct TraceRecord {
+    uint32_t time; // platGetTicks() >> 10 (1.024 us units), wraps
+    uint16_t tid;
+    uint16_t id;
+    uint32_t arg0;
+    uint32_t arg1;
+} __attribute__((packed));
+
+/*
+ * A block of binary trace records drained from the OS trace ring.
+ */
+class TraceEvent : public ReadEventResponse {
+  public:
+    /*
+     * Constructs and populates a TraceEvent instance. Returns nullptr if
+     * the packet is malformed. The rest of the methods in this class are not
+     * guaranteed to be safe unless the object is constructed from this
+     * function.
+     */
+    static std::unique_ptr<TraceEvent> FromBytes(
+        const std::vector<uint8_t>& buffer);
+
+    // Appends the records carried by this event to records
+    void GetRecords(std::vector<TraceRecord>& records) const;
+
+    /*
+     * Writes records as a Chrome trace event JSON file (loadable in
+     * chrome://tracing and Perfetto). Returns false on a write error.
+     */
+    static bool WriteChromeJson(FILE *out,
+        const std::vector<TraceRecord>& records);
+};
+
+}  // namespace android
+
+#endif  // TRACE_EVENT_H_